@@ -0,0 +1,416 @@
+#include "BPlusTree.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SUCCESS (1)
+#define FAILURE (0)
+
+/**
+ * constructs a new empty B+ tree.
+ * @param compFunc: a function two compare two variables.
+ * @return: the new tree, NULL on failure.
+ */
+BPlusTree *newBPlusTree(CompareFunc compFunc)
+{
+    if (compFunc == NULL)
+    {
+        return NULL;
+    }
+    BPlusTree *tree = calloc(1, sizeof(BPlusTree));
+    if (tree == NULL)
+    {
+        return NULL;
+    }
+    tree->compFunc = compFunc;
+    return tree;
+}
+
+/**
+ * makes sure there are enough spare nodes for the worst case insert: one leaf split, a split of every inner level
+ * and a new root.
+ * @param tree
+ * @return 1 if success 0 else
+ */
+static int reserveSpareNodes(BPlusTree *tree)
+{
+    if (tree->spareLeaf == NULL)
+    {
+        tree->spareLeaf = malloc(sizeof(BPlusLeaf));
+        if (tree->spareLeaf == NULL)
+        {
+            return FAILURE;
+        }
+    }
+    if (tree->height + 1 > BPLUS_MAX_HEIGHT)
+    {
+        return FAILURE;
+    }
+    while (tree->spareInnerCount < tree->height + 1)
+    {
+        BPlusInner *inner = malloc(sizeof(BPlusInner));
+        if (inner == NULL)
+        {
+            return FAILURE;
+        }
+        tree->spareInner[tree->spareInnerCount++] = inner;
+    }
+    return SUCCESS;
+}
+
+/**
+ * @param tree
+ * @return a reserved leaf
+ */
+static BPlusLeaf *takeLeaf(BPlusTree *tree)
+{
+    BPlusLeaf *leaf = tree->spareLeaf;
+    tree->spareLeaf = NULL;
+    leaf->base.leaf = 1;
+    leaf->base.count = 0;
+    leaf->next = NULL;
+    return leaf;
+}
+
+/**
+ * @param tree
+ * @return a reserved inner node
+ */
+static BPlusInner *takeInner(BPlusTree *tree)
+{
+    BPlusInner *inner = tree->spareInner[--tree->spareInnerCount];
+    inner->base.leaf = 0;
+    inner->base.count = 0;
+    return inner;
+}
+
+/**
+ * @param tree
+ * @param node
+ * @param data
+ * @return the number of items in the node that are lower than or equal to data (the child to descend to).
+ */
+static int upperBoundIndex(const BPlusTree *tree, const BPlusNode *node, const void *data)
+{
+    int lo = 0, hi = node->count;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (tree->compFunc(node->keys[mid], data) <= 0)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+ * @param tree
+ * @param node
+ * @param data
+ * @param found set to 1 if the item at the returned index is equal to data
+ * @return the index of the first item in the node that is not lower than data.
+ */
+static int lowerBoundIndex(const BPlusTree *tree, const BPlusNode *node, const void *data, int *found)
+{
+    int lo = 0, hi = node->count;
+    *found = 0;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        int comp = tree->compFunc(node->keys[mid], data);
+        if (comp == 0)
+        {
+            *found = 1;
+            return mid;
+        }
+        else if (comp < 0)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+ * inserts an item into a leaf, splitting it if it is full.
+ * @param tree
+ * @param leaf
+ * @param pos the index to insert at
+ * @param data
+ * @param splitKey set to the smallest item of the new right sibling, if there was a split
+ * @param splitNode set to the new right sibling, NULL if there was no split
+ */
+static void insertIntoLeaf(BPlusTree *tree, BPlusLeaf *leaf, int pos, void *data, void **splitKey,
+                           BPlusNode **splitNode)
+{
+    BPlusNode *node = &leaf->base;
+    if (node->count < BPLUS_FANOUT)
+    {
+        memmove(&node->keys[pos + 1], &node->keys[pos], sizeof(void *) * (node->count - pos));
+        node->keys[pos] = data;
+        node->count++;
+        return;
+    }
+
+    void *all[BPLUS_FANOUT + 1];
+    memcpy(all, node->keys, sizeof(void *) * pos);
+    all[pos] = data;
+    memcpy(&all[pos + 1], &node->keys[pos], sizeof(void *) * (BPLUS_FANOUT - pos));
+
+    BPlusLeaf *right = takeLeaf(tree);
+    int leftCount = (BPLUS_FANOUT + 1) / 2;
+    memcpy(node->keys, all, sizeof(void *) * leftCount);
+    node->count = leftCount;
+    memcpy(right->base.keys, &all[leftCount], sizeof(void *) * (BPLUS_FANOUT + 1 - leftCount));
+    right->base.count = BPLUS_FANOUT + 1 - leftCount;
+    right->next = leaf->next;
+    leaf->next = right;
+
+    *splitKey = right->base.keys[0];
+    *splitNode = &right->base;
+}
+
+/**
+ * inserts a separator and the child to its right into an inner node, splitting it if it is full.
+ * @param tree
+ * @param inner
+ * @param pos the index of the separator
+ * @param key the separator
+ * @param child the new child, placed at pos + 1
+ * @param splitKey set to the separator pushed up to the parent, if there was a split
+ * @param splitNode set to the new right sibling, NULL if there was no split
+ */
+static void insertIntoInner(BPlusTree *tree, BPlusInner *inner, int pos, void *key, BPlusNode *child,
+                            void **splitKey, BPlusNode **splitNode)
+{
+    BPlusNode *node = &inner->base;
+    if (node->count < BPLUS_FANOUT)
+    {
+        memmove(&node->keys[pos + 1], &node->keys[pos], sizeof(void *) * (node->count - pos));
+        memmove(&inner->children[pos + 2], &inner->children[pos + 1], sizeof(BPlusNode *) * (node->count - pos));
+        node->keys[pos] = key;
+        inner->children[pos + 1] = child;
+        node->count++;
+        return;
+    }
+
+    void *keys[BPLUS_FANOUT + 1];
+    BPlusNode *children[BPLUS_FANOUT + 2];
+    memcpy(keys, node->keys, sizeof(void *) * pos);
+    keys[pos] = key;
+    memcpy(&keys[pos + 1], &node->keys[pos], sizeof(void *) * (BPLUS_FANOUT - pos));
+    memcpy(children, inner->children, sizeof(BPlusNode *) * (pos + 1));
+    children[pos + 1] = child;
+    memcpy(&children[pos + 2], &inner->children[pos + 1], sizeof(BPlusNode *) * (BPLUS_FANOUT - pos));
+
+    BPlusInner *right = takeInner(tree);
+    int mid = (BPLUS_FANOUT + 1) / 2;
+    memcpy(node->keys, keys, sizeof(void *) * mid);
+    memcpy(inner->children, children, sizeof(BPlusNode *) * (mid + 1));
+    node->count = mid;
+    right->base.count = BPLUS_FANOUT - mid;
+    memcpy(right->base.keys, &keys[mid + 1], sizeof(void *) * right->base.count);
+    memcpy(right->children, &children[mid + 1], sizeof(BPlusNode *) * (right->base.count + 1));
+
+    *splitKey = keys[mid];
+    *splitNode = &right->base;
+}
+
+/**
+ * inserts an item into the subtree of node.
+ * @param tree
+ * @param node
+ * @param data
+ * @param splitKey set to the separator of a split of node
+ * @param splitNode set to the new right sibling of node, NULL if node wasn't split
+ * @return 1 if success 0 else (the item is already in the tree)
+ */
+static int insertRecursive(BPlusTree *tree, BPlusNode *node, void *data, void **splitKey, BPlusNode **splitNode)
+{
+    *splitNode = NULL;
+    if (node->leaf)
+    {
+        int found;
+        int pos = lowerBoundIndex(tree, node, data, &found);
+        if (found)
+        {
+            return FAILURE;
+        }
+        insertIntoLeaf(tree, (BPlusLeaf *) node, pos, data, splitKey, splitNode);
+        return SUCCESS;
+    }
+
+    BPlusInner *inner = (BPlusInner *) node;
+    int index = upperBoundIndex(tree, node, data);
+    void *childKey;
+    BPlusNode *childSplit;
+    if (!insertRecursive(tree, inner->children[index], data, &childKey, &childSplit))
+    {
+        return FAILURE;
+    }
+    if (childSplit != NULL)
+    {
+        insertIntoInner(tree, inner, index, childKey, childSplit, splitKey, splitNode);
+    }
+    return SUCCESS;
+}
+
+/**
+ * add an item to the tree.
+ * @param tree: the tree to add an item to.
+ * @param data: item to add to the tree.
+ * @return: 0 on failure, other on success. (if the item is already in the tree - failure).
+ */
+int addToBPlusTree(BPlusTree *tree, void *data)
+{
+    if (tree == NULL || data == NULL)
+    {
+        return FAILURE;
+    }
+    if (!reserveSpareNodes(tree))
+    {
+        return FAILURE;
+    }
+    if (tree->root == NULL)
+    {
+        BPlusLeaf *leaf = takeLeaf(tree);
+        leaf->base.keys[0] = data;
+        leaf->base.count = 1;
+        tree->root = &leaf->base;
+        tree->first = leaf;
+        return SUCCESS;
+    }
+
+    void *splitKey;
+    BPlusNode *splitNode;
+    if (!insertRecursive(tree, tree->root, data, &splitKey, &splitNode))
+    {
+        return FAILURE;
+    }
+    if (splitNode != NULL)
+    {
+        BPlusInner *root = takeInner(tree);
+        root->base.count = 1;
+        root->base.keys[0] = splitKey;
+        root->children[0] = tree->root;
+        root->children[1] = splitNode;
+        tree->root = &root->base;
+        tree->height++;
+    }
+    return SUCCESS;
+}
+
+/**
+ * check whether the tree contains this item.
+ * @param tree: the tree to search.
+ * @param data: item to check.
+ * @return: 0 if the item is not in the tree, other if it is.
+ */
+int containsBPlusTree(const BPlusTree *tree, const void *data)
+{
+    return findBPlusTree(tree, data) != NULL ? SUCCESS : FAILURE;
+}
+
+/**
+ * @param tree: the tree to search.
+ * @param data: item to compare to.
+ * @return: the item in the tree that is equal to data, NULL if there is none.
+ */
+void *findBPlusTree(const BPlusTree *tree, const void *data)
+{
+    if (tree == NULL || tree->root == NULL || data == NULL)
+    {
+        return NULL;
+    }
+    const BPlusNode *node = tree->root;
+    while (!node->leaf)
+    {
+        node = ((const BPlusInner *) node)->children[upperBoundIndex(tree, node, data)];
+    }
+    int found;
+    int pos = lowerBoundIndex(tree, node, data, &found);
+    return found ? node->keys[pos] : NULL;
+}
+
+/**
+ * Activate a function on each item of the tree, in an ascending order. if one of the activations of the function
+ * returns 0, the process stops.
+ * @param tree: the tree with all the items.
+ * @param func: the function to activate on all items.
+ * @param args: more optional arguments to the function.
+ * @return: 0 on failure, other on success.
+ */
+int forEachBPlusTree(const BPlusTree *tree, forEachFunc func, void *args)
+{
+    if (tree == NULL || tree->root == NULL || func == NULL)
+    {
+        return FAILURE;
+    }
+    for (const BPlusLeaf *leaf = tree->first; leaf != NULL; leaf = leaf->next)
+    {
+        for (int i = 0; i < leaf->base.count; ++i)
+        {
+            if (func(leaf->base.keys[i], args) == 0)
+            {
+                return FAILURE;
+            }
+        }
+    }
+    return SUCCESS;
+}
+
+/**
+ * frees the nodes of a subtree and its items.
+ * @param node
+ * @param freeFunc
+ */
+static void freeNodeRecursive(BPlusNode *node, FreeFunc freeFunc)
+{
+    if (node->leaf)
+    {
+        for (int i = 0; i < node->count; ++i)
+        {
+            freeFunc(node->keys[i]);
+        }
+    }
+    else
+    {
+        BPlusInner *inner = (BPlusInner *) node;
+        for (int i = 0; i <= node->count; ++i)
+        {
+            freeNodeRecursive(inner->children[i], freeFunc);
+        }
+    }
+    free(node);
+}
+
+/**
+ * free all memory of the tree, and the items with freeFunc.
+ * @param tree: the tree to free.
+ * @param freeFunc: a function to free a data item.
+ */
+void freeBPlusTree(BPlusTree *tree, FreeFunc freeFunc)
+{
+    if (tree == NULL)
+    {
+        return;
+    }
+    if (tree->root != NULL)
+    {
+        freeNodeRecursive(tree->root, freeFunc);
+    }
+    free(tree->spareLeaf);
+    while (tree->spareInnerCount > 0)
+    {
+        free(tree->spareInner[--tree->spareInnerCount]);
+    }
+    free(tree);
+}
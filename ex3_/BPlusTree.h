@@ -0,0 +1,114 @@
+#ifndef RBTREE_BPLUSTREE_H
+#define RBTREE_BPLUSTREE_H
+
+#include "RBTree.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * maximal number of items in a node. 16 pointers make the items of a node exactly two 64 byte cache lines.
+ */
+#define BPLUS_FANOUT (16)
+
+/**
+ * maximal number of inner levels. with at least 8 children per inner node, that's far beyond any addressable size.
+ */
+#define BPLUS_MAX_HEIGHT (40)
+
+/*
+ * the common part of leaves and inner nodes.
+ */
+typedef struct BPlusNode
+{
+	int leaf;
+	int count; // number of items (keys) in the node
+	void *keys[BPLUS_FANOUT];
+} BPlusNode;
+
+/*
+ * a leaf holds the items themselves, and is linked to the next leaf for in order traversal.
+ */
+typedef struct BPlusLeaf
+{
+	BPlusNode base;
+	struct BPlusLeaf *next;
+} BPlusLeaf;
+
+/*
+ * an inner node. keys[i] is the smallest item in the subtree of children[i + 1].
+ */
+typedef struct BPlusInner
+{
+	BPlusNode base;
+	BPlusNode *children[BPLUS_FANOUT + 1];
+} BPlusInner;
+
+/**
+ * a B+ tree of items, with cache line sized nodes.
+ */
+typedef struct BPlusTree
+{
+	BPlusNode *root;
+	BPlusLeaf *first; // the leftmost leaf
+	CompareFunc compFunc;
+	int height; // number of inner levels
+	// nodes allocated ahead of an insert, so a split never fails half way through.
+	BPlusLeaf *spareLeaf;
+	BPlusInner *spareInner[BPLUS_MAX_HEIGHT];
+	int spareInnerCount;
+} BPlusTree;
+
+/**
+ * constructs a new empty B+ tree.
+ * @param compFunc: a function two compare two variables.
+ * @return: the new tree, NULL on failure.
+ */
+BPlusTree *newBPlusTree(CompareFunc compFunc);
+
+/**
+ * add an item to the tree.
+ * @param tree: the tree to add an item to.
+ * @param data: item to add to the tree.
+ * @return: 0 on failure, other on success. (if the item is already in the tree - failure).
+ */
+int addToBPlusTree(BPlusTree *tree, void *data);
+
+/**
+ * check whether the tree contains this item.
+ * @param tree: the tree to search.
+ * @param data: item to check.
+ * @return: 0 if the item is not in the tree, other if it is.
+ */
+int containsBPlusTree(const BPlusTree *tree, const void *data);
+
+/**
+ * @param tree: the tree to search.
+ * @param data: item to compare to.
+ * @return: the item in the tree that is equal to data, NULL if there is none.
+ */
+void *findBPlusTree(const BPlusTree *tree, const void *data);
+
+/**
+ * Activate a function on each item of the tree, in an ascending order. if one of the activations of the function
+ * returns 0, the process stops.
+ * @param tree: the tree with all the items.
+ * @param func: the function to activate on all items.
+ * @param args: more optional arguments to the function.
+ * @return: 0 on failure, other on success.
+ */
+int forEachBPlusTree(const BPlusTree *tree, forEachFunc func, void *args);
+
+/**
+ * free all memory of the tree, and the items with freeFunc.
+ * @param tree: the tree to free.
+ * @param freeFunc: a function to free a data item.
+ */
+void freeBPlusTree(BPlusTree *tree, FreeFunc freeFunc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //RBTREE_BPLUSTREE_H
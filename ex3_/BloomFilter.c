@@ -0,0 +1,126 @@
+#include "BloomFilter.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SUCCESS (1)
+#define FAILURE (0)
+#define BLOOM_ALIGNMENT (64)
+
+/*
+ * odd multipliers that pick the bit of an item in each word of its block (the ones of the Parquet split block filter).
+ */
+static const uint32_t BLOOM_SALTS[BLOOM_BLOCK_WORDS] = {0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+                                                        0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+
+/**
+ * spreads the bits of a hash, so weak hashes (like the value of an int) still fill the whole filter.
+ * @param hash
+ * @return the mixed hash (the finalizer of MurmurHash3)
+ */
+static uint64_t mixHash(uint64_t hash)
+{
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+/**
+ * @param filter
+ * @param hash a mixed hash
+ * @return the block of the item: the high half of the hash, scaled to the number of blocks
+ */
+static uint32_t *blockOf(const BloomFilter *filter, uint64_t hash)
+{
+    size_t block = (size_t) (((hash >> 32) * (uint64_t) filter->numBlocks) >> 32);
+    return filter->blocks + block * BLOOM_BLOCK_WORDS;
+}
+
+/**
+ * constructs an empty filter.
+ * @param capacity: the expected number of items.
+ * @return: the new filter, NULL on failure.
+ */
+BloomFilter *newBloomFilter(int capacity)
+{
+    BloomFilter *filter = malloc(sizeof(BloomFilter));
+    if (filter == NULL)
+    {
+        return NULL;
+    }
+    capacity = capacity > 0 ? capacity : 1;
+    size_t blockBits = BLOOM_BLOCK_WORDS * 32;
+    filter->numBlocks = ((size_t) capacity * BLOOM_BITS_PER_ITEM + blockBits - 1) / blockBits;
+    size_t bytes = filter->numBlocks * BLOOM_BLOCK_WORDS * sizeof(uint32_t);
+    filter->allocation = malloc(bytes + BLOOM_ALIGNMENT - 1);
+    if (filter->allocation == NULL)
+    {
+        free(filter);
+        return NULL;
+    }
+    filter->blocks = (uint32_t *) (((uintptr_t) filter->allocation + BLOOM_ALIGNMENT - 1) &
+                                   ~((uintptr_t) BLOOM_ALIGNMENT - 1));
+    memset(filter->blocks, 0, bytes);
+    filter->capacity = capacity;
+    filter->items = 0;
+    return filter;
+}
+
+/**
+ * @param filter: the filter.
+ * @return: the size of the filter in bits.
+ */
+long bloomFilterBits(const BloomFilter *filter)
+{
+    return filter != NULL ? (long) filter->numBlocks * BLOOM_BLOCK_WORDS * 32 : 0;
+}
+
+/**
+ * add an item to the filter.
+ * @param filter: the filter.
+ * @param hash: the hash of the item.
+ */
+void addToBloomFilter(BloomFilter *filter, uint64_t hash)
+{
+    hash = mixHash(hash);
+    uint32_t *block = blockOf(filter, hash);
+    for (int i = 0; i < BLOOM_BLOCK_WORDS; ++i)
+    {
+        block[i] |= 1U << (((uint32_t) hash * BLOOM_SALTS[i]) >> 27);
+    }
+    filter->items++;
+}
+
+/**
+ * @param filter: the filter.
+ * @param hash: the hash of an item.
+ * @return: 0 if the item was never added to the filter, other if it may have been.
+ */
+int mayContainBloomFilter(const BloomFilter *filter, uint64_t hash)
+{
+    hash = mixHash(hash);
+    const uint32_t *block = blockOf(filter, hash);
+    // no early exit: the 8 words are in one cache line, and a branch free loop vectorizes.
+    uint32_t missing = 0;
+    for (int i = 0; i < BLOOM_BLOCK_WORDS; ++i)
+    {
+        missing |= ~block[i] & (1U << (((uint32_t) hash * BLOOM_SALTS[i]) >> 27));
+    }
+    return missing == 0 ? SUCCESS : FAILURE;
+}
+
+/**
+ * free all memory of the filter.
+ * @param filter: the filter to free.
+ */
+void freeBloomFilter(BloomFilter *filter)
+{
+    if (filter == NULL)
+    {
+        return;
+    }
+    free(filter->allocation);
+    free(filter);
+}
@@ -0,0 +1,70 @@
+#ifndef RBTREE_BLOOMFILTER_H
+#define RBTREE_BLOOMFILTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * number of 32 bit words in a block. an item sets one bit in each word of a single block.
+ */
+#define BLOOM_BLOCK_WORDS (8)
+
+/**
+ * bits of filter per expected item. with 8 bits set per item this gives about 0.5% false positives.
+ */
+#define BLOOM_BITS_PER_ITEM (12)
+
+/**
+ * a blocked Bloom filter: the bits of an item are all in one 32 byte block, so a query reads one cache line.
+ */
+typedef struct BloomFilter
+{
+	uint32_t *blocks; // numBlocks * BLOOM_BLOCK_WORDS words, aligned to a cache line
+	void *allocation; // the allocation that blocks points into
+	size_t numBlocks;
+	int capacity; // the number of items the filter was sized for
+	int items; // items added to the filter
+} BloomFilter;
+
+/**
+ * constructs an empty filter.
+ * @param capacity: the expected number of items.
+ * @return: the new filter, NULL on failure.
+ */
+BloomFilter *newBloomFilter(int capacity);
+
+/**
+ * @param filter: the filter.
+ * @return: the size of the filter in bits.
+ */
+long bloomFilterBits(const BloomFilter *filter);
+
+/**
+ * add an item to the filter.
+ * @param filter: the filter.
+ * @param hash: the hash of the item.
+ */
+void addToBloomFilter(BloomFilter *filter, uint64_t hash);
+
+/**
+ * @param filter: the filter.
+ * @param hash: the hash of an item.
+ * @return: 0 if the item was never added to the filter, other if it may have been.
+ */
+int mayContainBloomFilter(const BloomFilter *filter, uint64_t hash);
+
+/**
+ * free all memory of the filter.
+ * @param filter: the filter to free.
+ */
+void freeBloomFilter(BloomFilter *filter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //RBTREE_BLOOMFILTER_H
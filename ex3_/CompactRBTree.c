@@ -0,0 +1,363 @@
+#include "CompactRBTree.h"
+#include <stdlib.h>
+
+#define SUCCESS (1)
+#define FAILURE (0)
+#define INITIAL_CAPACITY (64)
+
+/**
+ * @param tree
+ * @param i
+ * @return the index of the parent of node i
+ */
+static uint32_t parentOf(const CompactRBTree *tree, uint32_t i)
+{
+    return tree->nodes[i].parentAndColor >> 1;
+}
+
+/**
+ * @param tree
+ * @param i may be COMPACT_NIL
+ * @return the color of node i (NIL leaves are black)
+ */
+static Color colorOf(const CompactRBTree *tree, uint32_t i)
+{
+    return i == COMPACT_NIL ? BLACK : (Color) (tree->nodes[i].parentAndColor & 1);
+}
+
+/**
+ * @param tree
+ * @param i
+ * @param parent
+ */
+static void setParent(CompactRBTree *tree, uint32_t i, uint32_t parent)
+{
+    tree->nodes[i].parentAndColor = (parent << 1) | (tree->nodes[i].parentAndColor & 1);
+}
+
+/**
+ * @param tree
+ * @param i
+ * @param color
+ */
+static void setColor(CompactRBTree *tree, uint32_t i, Color color)
+{
+    tree->nodes[i].parentAndColor = (tree->nodes[i].parentAndColor & ~(uint32_t) 1) | (uint32_t) color;
+}
+
+/**
+ * constructs a new empty compact tree.
+ * @param compFunc: a function two compare two variables.
+ * @return: the new tree, NULL on failure.
+ */
+CompactRBTree *newCompactRBTree(CompareFunc compFunc)
+{
+    if (compFunc == NULL)
+    {
+        return NULL;
+    }
+    CompactRBTree *tree = malloc(sizeof(CompactRBTree));
+    if (tree == NULL)
+    {
+        return NULL;
+    }
+    tree->nodes = NULL;
+    tree->capacity = 0;
+    tree->root = COMPACT_NIL;
+    tree->size = 0;
+    tree->compFunc = compFunc;
+    return tree;
+}
+
+/**
+ * puts p in the place of its parent g in the tree (the common part of both rotations).
+ * @param tree
+ * @param g
+ * @param p
+ */
+static void replaceChild(CompactRBTree *tree, uint32_t g, uint32_t p)
+{
+    uint32_t parent = parentOf(tree, g);
+    setParent(tree, p, parent);
+    if (parent == COMPACT_NIL)
+    {
+        tree->root = p;
+    }
+    else if (tree->nodes[parent].left == g)
+    {
+        tree->nodes[parent].left = p;
+    }
+    else
+    {
+        tree->nodes[parent].right = p;
+    }
+}
+
+/**
+ * rotates the subtree of g to the left.
+ * @param tree
+ * @param g
+ */
+static void rotateLeft(CompactRBTree *tree, uint32_t g)
+{
+    uint32_t p = tree->nodes[g].right;
+    tree->nodes[g].right = tree->nodes[p].left;
+    if (tree->nodes[p].left != COMPACT_NIL)
+    {
+        setParent(tree, tree->nodes[p].left, g);
+    }
+    replaceChild(tree, g, p);
+    tree->nodes[p].left = g;
+    setParent(tree, g, p);
+}
+
+/**
+ * rotates the subtree of g to the right.
+ * @param tree
+ * @param g
+ */
+static void rotateRight(CompactRBTree *tree, uint32_t g)
+{
+    uint32_t p = tree->nodes[g].left;
+    tree->nodes[g].left = tree->nodes[p].right;
+    if (tree->nodes[p].right != COMPACT_NIL)
+    {
+        setParent(tree, tree->nodes[p].right, g);
+    }
+    replaceChild(tree, g, p);
+    tree->nodes[p].right = g;
+    setParent(tree, g, p);
+}
+
+/**
+ * fixes the tree after a new node was inserted: recolor on a red uncle, otherwise straighten the path and rotate
+ * the grandparent (the same cases as fixTree in RBTree.c).
+ * @param tree
+ * @param node
+ */
+static void fixTree(CompactRBTree *tree, uint32_t node)
+{
+    while (node != tree->root && colorOf(tree, parentOf(tree, node)) == RED)
+    {
+        uint32_t parent = parentOf(tree, node);
+        uint32_t grandparent = parentOf(tree, parent);
+        int parentIsLeft = tree->nodes[grandparent].left == parent;
+        uint32_t uncle = parentIsLeft ? tree->nodes[grandparent].right : tree->nodes[grandparent].left;
+        if (colorOf(tree, uncle) == RED)
+        {
+            setColor(tree, uncle, BLACK);
+            setColor(tree, parent, BLACK);
+            setColor(tree, grandparent, RED);
+            node = grandparent;
+            continue;
+        }
+        if (parentIsLeft)
+        {
+            if (tree->nodes[parent].right == node)
+            {
+                rotateLeft(tree, parent);
+                parent = node;
+            }
+            rotateRight(tree, grandparent);
+        }
+        else
+        {
+            if (tree->nodes[parent].left == node)
+            {
+                rotateRight(tree, parent);
+                parent = node;
+            }
+            rotateLeft(tree, grandparent);
+        }
+        setColor(tree, parent, BLACK);
+        setColor(tree, grandparent, RED);
+        break;
+    }
+    setColor(tree, tree->root, BLACK);
+}
+
+/**
+ * makes room for one more node, doubling the arena when it is full.
+ * @param tree
+ * @return 1 if success 0 else
+ */
+static int reserveNode(CompactRBTree *tree)
+{
+    uint32_t used = (uint32_t) tree->size + 1; // slot 0 is never used
+    if (used < tree->capacity)
+    {
+        return SUCCESS;
+    }
+    if (used >= COMPACT_MAX_NODES)
+    {
+        return FAILURE;
+    }
+    uint32_t capacity = tree->capacity == 0 ? INITIAL_CAPACITY : tree->capacity * 2;
+    if (capacity > COMPACT_MAX_NODES)
+    {
+        capacity = COMPACT_MAX_NODES;
+    }
+    CompactNode *nodes = realloc(tree->nodes, sizeof(CompactNode) * capacity);
+    if (nodes == NULL)
+    {
+        return FAILURE;
+    }
+    tree->nodes = nodes;
+    tree->capacity = capacity;
+    return SUCCESS;
+}
+
+/**
+ * add an item to the tree.
+ * @param tree: the tree to add an item to.
+ * @param data: item to add to the tree.
+ * @return: 0 on failure, other on success. (if the item is already in the tree - failure).
+ */
+int addToCompactRBTree(CompactRBTree *tree, void *data)
+{
+    if (tree == NULL || data == NULL)
+    {
+        return FAILURE;
+    }
+    uint32_t parent = COMPACT_NIL;
+    uint32_t current = tree->root;
+    int comp = 0;
+    while (current != COMPACT_NIL)
+    {
+        comp = tree->compFunc(tree->nodes[current].data, data);
+        if (comp == 0)
+        {
+            return FAILURE;
+        }
+        parent = current;
+        current = comp > 0 ? tree->nodes[current].left : tree->nodes[current].right;
+    }
+    if (!reserveNode(tree))
+    {
+        return FAILURE;
+    }
+
+    // the tree only grows, so the nodes are exactly the slots 1..size.
+    uint32_t node = (uint32_t) tree->size + 1;
+    tree->nodes[node].parentAndColor = (parent << 1) | (uint32_t) RED;
+    tree->nodes[node].left = COMPACT_NIL;
+    tree->nodes[node].right = COMPACT_NIL;
+    tree->nodes[node].data = data;
+    if (parent == COMPACT_NIL)
+    {
+        tree->root = node;
+    }
+    else if (comp > 0)
+    {
+        tree->nodes[parent].left = node;
+    }
+    else
+    {
+        tree->nodes[parent].right = node;
+    }
+    tree->size++;
+    fixTree(tree, node);
+    return SUCCESS;
+}
+
+/**
+ * check whether the tree contains this item.
+ * @param tree: the tree to search.
+ * @param data: item to check.
+ * @return: 0 if the item is not in the tree, other if it is.
+ */
+int containsCompactRBTree(const CompactRBTree *tree, const void *data)
+{
+    return findCompactRBTree(tree, data) != NULL ? SUCCESS : FAILURE;
+}
+
+/**
+ * @param tree: the tree to search.
+ * @param data: item to compare to.
+ * @return: the item in the tree that is equal to data, NULL if there is none.
+ */
+void *findCompactRBTree(const CompactRBTree *tree, const void *data)
+{
+    if (tree == NULL || data == NULL)
+    {
+        return NULL;
+    }
+    uint32_t current = tree->root;
+    while (current != COMPACT_NIL)
+    {
+        int comp = tree->compFunc(tree->nodes[current].data, data);
+        if (comp == 0)
+        {
+            return tree->nodes[current].data;
+        }
+        current = comp > 0 ? tree->nodes[current].left : tree->nodes[current].right;
+    }
+    return NULL;
+}
+
+/**
+ * Activate a function on each item of the tree, in an ascending order. if one of the activations of the function
+ * returns 0, the process stops.
+ * @param tree: the tree with all the items.
+ * @param func: the function to activate on all items.
+ * @param args: more optional arguments to the function.
+ * @return: 0 on failure, other on success.
+ */
+int forEachCompactRBTree(const CompactRBTree *tree, forEachFunc func, void *args)
+{
+    if (tree == NULL || tree->root == COMPACT_NIL || func == NULL)
+    {
+        return FAILURE;
+    }
+    uint32_t node = tree->root;
+    while (tree->nodes[node].left != COMPACT_NIL)
+    {
+        node = tree->nodes[node].left;
+    }
+    while (node != COMPACT_NIL)
+    {
+        if (func(tree->nodes[node].data, args) == 0)
+        {
+            return FAILURE;
+        }
+        if (tree->nodes[node].right != COMPACT_NIL)
+        {
+            node = tree->nodes[node].right;
+            while (tree->nodes[node].left != COMPACT_NIL)
+            {
+                node = tree->nodes[node].left;
+            }
+        }
+        else
+        {
+            uint32_t parent = parentOf(tree, node);
+            while (parent != COMPACT_NIL && tree->nodes[parent].right == node)
+            {
+                node = parent;
+                parent = parentOf(tree, node);
+            }
+            node = parent;
+        }
+    }
+    return SUCCESS;
+}
+
+/**
+ * free all memory of the tree, and the items with freeFunc.
+ * @param tree: the tree to free.
+ * @param freeFunc: a function to free a data item.
+ */
+void freeCompactRBTree(CompactRBTree *tree, FreeFunc freeFunc)
+{
+    if (tree == NULL)
+    {
+        return;
+    }
+    // the nodes are the slots 1..size of the arena, no need to walk the tree.
+    for (uint32_t i = 1; i <= (uint32_t) tree->size; ++i)
+    {
+        freeFunc(tree->nodes[i].data);
+    }
+    free(tree->nodes);
+    free(tree);
+}
@@ -0,0 +1,95 @@
+#ifndef RBTREE_COMPACTRBTREE_H
+#define RBTREE_COMPACTRBTREE_H
+
+#include "RBTree.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * the index of "no node". real nodes are stored from index 1.
+ */
+#define COMPACT_NIL (0)
+
+/**
+ * maximal number of nodes: the parent index shares its 32 bits with the color.
+ */
+#define COMPACT_MAX_NODES ((uint32_t) 1 << 31)
+
+/*
+ * a node of a compact tree: 24 bytes on x86-64 instead of the 40 of Node.
+ * links are 32 bit indices into the arena of the tree, and the color is the low bit of the parent link.
+ */
+typedef struct CompactNode
+{
+	uint32_t parentAndColor; // (parent index << 1) | color
+	uint32_t left, right;
+	void *data;
+} CompactNode;
+
+/**
+ * a red-black tree whose nodes live in one growing array.
+ */
+typedef struct CompactRBTree
+{
+	CompactNode *nodes; // nodes[0] is unused, so index 0 can stand for NULL
+	uint32_t capacity; // number of slots in nodes
+	uint32_t root;
+	int size;
+	CompareFunc compFunc;
+} CompactRBTree;
+
+/**
+ * constructs a new empty compact tree.
+ * @param compFunc: a function two compare two variables.
+ * @return: the new tree, NULL on failure.
+ */
+CompactRBTree *newCompactRBTree(CompareFunc compFunc);
+
+/**
+ * add an item to the tree.
+ * @param tree: the tree to add an item to.
+ * @param data: item to add to the tree.
+ * @return: 0 on failure, other on success. (if the item is already in the tree - failure).
+ */
+int addToCompactRBTree(CompactRBTree *tree, void *data);
+
+/**
+ * check whether the tree contains this item.
+ * @param tree: the tree to search.
+ * @param data: item to check.
+ * @return: 0 if the item is not in the tree, other if it is.
+ */
+int containsCompactRBTree(const CompactRBTree *tree, const void *data);
+
+/**
+ * @param tree: the tree to search.
+ * @param data: item to compare to.
+ * @return: the item in the tree that is equal to data, NULL if there is none.
+ */
+void *findCompactRBTree(const CompactRBTree *tree, const void *data);
+
+/**
+ * Activate a function on each item of the tree, in an ascending order. if one of the activations of the function
+ * returns 0, the process stops.
+ * @param tree: the tree with all the items.
+ * @param func: the function to activate on all items.
+ * @param args: more optional arguments to the function.
+ * @return: 0 on failure, other on success.
+ */
+int forEachCompactRBTree(const CompactRBTree *tree, forEachFunc func, void *args);
+
+/**
+ * free all memory of the tree, and the items with freeFunc.
+ * @param tree: the tree to free.
+ * @param freeFunc: a function to free a data item.
+ */
+void freeCompactRBTree(CompactRBTree *tree, FreeFunc freeFunc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //RBTREE_COMPACTRBTREE_H
@@ -0,0 +1,501 @@
+#include "ConcurrentRBTree.h"
+#include <stdlib.h>
+
+#define SUCCESS (1)
+#define FAILURE (0)
+#define RECLAIM_THRESHOLD (256) // retired nodes collected before the writer tries to free them
+
+/**
+ * constructs a new empty concurrent tree.
+ * @param compFunc: a function two compare two variables.
+ * @param freeFunc: a function to free a data item.
+ * @return: the new tree, NULL on failure.
+ */
+ConcurrentRBTree *newConcurrentRBTree(CompareFunc compFunc, FreeFunc freeFunc)
+{
+    if (compFunc == NULL || freeFunc == NULL)
+    {
+        return NULL;
+    }
+    ConcurrentRBTree *tree = calloc(1, sizeof(ConcurrentRBTree));
+    if (tree == NULL)
+    {
+        return NULL;
+    }
+    tree->compFunc = compFunc;
+    tree->freeFunc = freeFunc;
+    tree->epoch = 1; // 0 marks a reader that is outside the tree
+    return tree;
+}
+
+/**
+ * register the calling thread as a reader of the tree. may be called from any thread.
+ * @param tree: the tree to read.
+ * @return: the reader id to pass to the read functions, -1 if all CONCURRENT_MAX_READERS slots are taken.
+ */
+int registerConcurrentReader(ConcurrentRBTree *tree)
+{
+    if (tree == NULL)
+    {
+        return -1;
+    }
+    for (int i = 0; i < CONCURRENT_MAX_READERS; ++i)
+    {
+        int unused = 0;
+        if (__atomic_compare_exchange_n(&tree->readers[i].used, &unused, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * release a reader id. the reader must not be inside a read function.
+ * @param tree: the tree the reader was registered to.
+ * @param reader: the id returned by registerConcurrentReader.
+ */
+void unregisterConcurrentReader(ConcurrentRBTree *tree, int reader)
+{
+    if (tree == NULL || reader < 0 || reader >= CONCURRENT_MAX_READERS)
+    {
+        return;
+    }
+    __atomic_store_n(&tree->readers[reader].used, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * announces that the reader is inside the tree, and takes the snapshot it will read.
+ * the announcement is sequentially consistent with the load of the root, so the writer either sees the reader's
+ * epoch or the reader sees the root the writer published.
+ * @param tree
+ * @param reader
+ * @return the root of the snapshot
+ */
+static ConcurrentNode *enterEpoch(ConcurrentRBTree *tree, int reader)
+{
+    __atomic_store_n(&tree->readers[reader].epoch, __atomic_load_n(&tree->epoch, __ATOMIC_SEQ_CST),
+                     __ATOMIC_SEQ_CST);
+    return __atomic_load_n(&tree->root, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * announces that the reader holds no node of the tree anymore.
+ * @param tree
+ * @param reader
+ */
+static void leaveEpoch(ConcurrentRBTree *tree, int reader)
+{
+    __atomic_store_n(&tree->readers[reader].epoch, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * @param tree
+ * @param reader
+ * @return 1 if reader is an id the read functions can use, 0 else
+ */
+static int isValidReader(ConcurrentRBTree *tree, int reader)
+{
+    return reader >= 0 && reader < CONCURRENT_MAX_READERS &&
+           __atomic_load_n(&tree->readers[reader].used, __ATOMIC_RELAXED);
+}
+
+/**
+ * frees the retired nodes no reader can hold anymore: the ones unlinked before the oldest epoch a reader is in.
+ * @param tree
+ */
+static void reclaimRetired(ConcurrentRBTree *tree)
+{
+    unsigned long oldest = __atomic_load_n(&tree->epoch, __ATOMIC_SEQ_CST);
+    for (int i = 0; i < CONCURRENT_MAX_READERS; ++i)
+    {
+        unsigned long epoch = __atomic_load_n(&tree->readers[i].epoch, __ATOMIC_SEQ_CST);
+        if (epoch != 0 && epoch < oldest)
+        {
+            oldest = epoch;
+        }
+    }
+    int freed = 0;
+    while (freed < tree->retiredCount && tree->retired[freed].epoch < oldest)
+    {
+        free(tree->retired[freed].node);
+        freed++;
+    }
+    for (int i = freed; i < tree->retiredCount; ++i)
+    {
+        tree->retired[i - freed] = tree->retired[i];
+    }
+    tree->retiredCount -= freed;
+}
+
+/**
+ * makes sure an insert of a node at the given depth can't fail halfway: reserves room for the retired path and
+ * uncles, and a spare node for each uncle that may be recolored.
+ * @param tree
+ * @param depth
+ * @return 1 if success 0 else
+ */
+static int reserveForInsert(ConcurrentRBTree *tree, int depth)
+{
+    int needed = tree->retiredCount + depth + depth / 2;
+    if (needed > tree->retiredCapacity)
+    {
+        int capacity = tree->retiredCapacity == 0 ? RECLAIM_THRESHOLD * 2 : tree->retiredCapacity;
+        while (capacity < needed)
+        {
+            capacity *= 2;
+        }
+        RetiredNode *retired = realloc(tree->retired, sizeof(RetiredNode) * capacity);
+        if (retired == NULL)
+        {
+            return FAILURE;
+        }
+        tree->retired = retired;
+        tree->retiredCapacity = capacity;
+    }
+    while (tree->spareCount < depth / 2)
+    {
+        ConcurrentNode *spare = malloc(sizeof(ConcurrentNode));
+        if (spare == NULL)
+        {
+            return FAILURE;
+        }
+        tree->spareNodes[tree->spareCount++] = spare;
+    }
+    return SUCCESS;
+}
+
+/**
+ * queues a node that was unlinked in the current epoch (room was reserved by reserveForInsert).
+ * @param tree
+ * @param node
+ */
+static void retireNode(ConcurrentRBTree *tree, ConcurrentNode *node)
+{
+    tree->retired[tree->retiredCount].node = node;
+    tree->retired[tree->retiredCount].epoch = tree->epoch;
+    tree->retiredCount++;
+}
+
+/**
+ * @param node
+ * @return a private copy of node, NULL on failure
+ */
+static ConcurrentNode *copyNode(const ConcurrentNode *node)
+{
+    ConcurrentNode *copy = malloc(sizeof(ConcurrentNode));
+    if (copy != NULL)
+    {
+        *copy = *node;
+    }
+    return copy;
+}
+
+/**
+ * @param node
+ * @return 1 if the node is red (NULL leaves are black), 0 else
+ */
+static int isRed(const ConcurrentNode *node)
+{
+    return node != NULL && node->color == RED;
+}
+
+/**
+ * rotates the subtree of g to the left.
+ * @param g
+ * @return the new root of the subtree
+ */
+static ConcurrentNode *rotateLeft(ConcurrentNode *g)
+{
+    ConcurrentNode *p = g->right;
+    g->right = p->left;
+    p->left = g;
+    return p;
+}
+
+/**
+ * rotates the subtree of g to the right.
+ * @param g
+ * @return the new root of the subtree
+ */
+static ConcurrentNode *rotateRight(ConcurrentNode *g)
+{
+    ConcurrentNode *p = g->left;
+    g->left = p->right;
+    p->right = g;
+    return p;
+}
+
+/**
+ * hangs a subtree in the place of path[depth] (under path[depth - 1], or as the new root).
+ * @param path the copied path
+ * @param depth
+ * @param subtree
+ * @param root the root of the new version
+ */
+static void replaceOnPath(ConcurrentNode **path, int depth, ConcurrentNode *subtree, ConcurrentNode **root)
+{
+    if (depth == 0)
+    {
+        *root = subtree;
+    }
+    else if (path[depth - 1]->left == path[depth])
+    {
+        path[depth - 1]->left = subtree;
+    }
+    else
+    {
+        path[depth - 1]->right = subtree;
+    }
+}
+
+/**
+ * fixes the new version after a red node was inserted at path[depth]. only copied nodes are changed: a red uncle
+ * is copied before it is recolored, and rotations only move pointers to shared subtrees.
+ * @param tree
+ * @param path the copied path from the new root to the new node
+ * @param depth
+ * @param root the root of the new version
+ */
+static void fixPath(ConcurrentRBTree *tree, ConcurrentNode **path, int depth, ConcurrentNode **root)
+{
+    while (depth >= 2 && isRed(path[depth - 1]))
+    {
+        ConcurrentNode *node = path[depth], *parent = path[depth - 1], *grandparent = path[depth - 2];
+        int parentIsLeft = grandparent->left == parent;
+        ConcurrentNode *uncle = parentIsLeft ? grandparent->right : grandparent->left;
+        if (isRed(uncle))
+        {
+            ConcurrentNode *uncleCopy = tree->spareNodes[--tree->spareCount];
+            *uncleCopy = *uncle;
+            uncleCopy->color = BLACK;
+            retireNode(tree, uncle);
+            if (parentIsLeft)
+            {
+                grandparent->right = uncleCopy;
+            }
+            else
+            {
+                grandparent->left = uncleCopy;
+            }
+            parent->color = BLACK;
+            grandparent->color = RED;
+            depth -= 2;
+            continue;
+        }
+        if (parentIsLeft)
+        {
+            if (parent->right == node)
+            {
+                grandparent->left = rotateLeft(parent);
+                parent = node;
+            }
+            replaceOnPath(path, depth - 2, rotateRight(grandparent), root);
+        }
+        else
+        {
+            if (parent->left == node)
+            {
+                grandparent->right = rotateRight(parent);
+                parent = node;
+            }
+            replaceOnPath(path, depth - 2, rotateLeft(grandparent), root);
+        }
+        parent->color = BLACK;
+        grandparent->color = RED;
+        break;
+    }
+    (*root)->color = BLACK;
+}
+
+/**
+ * add an item to the tree. only one thread may write at a time, readers may run concurrently.
+ * @param tree: the tree to add an item to.
+ * @param data: item to add to the tree.
+ * @return: 0 on failure, other on success. (if the item is already in the tree - failure).
+ */
+int addToConcurrentRBTree(ConcurrentRBTree *tree, void *data)
+{
+    if (tree == NULL || data == NULL)
+    {
+        return FAILURE;
+    }
+    // the writer is the only one that changes root, so it can read it without ordering.
+    ConcurrentNode *oldPath[CONCURRENT_MAX_HEIGHT];
+    int wentLeft[CONCURRENT_MAX_HEIGHT];
+    ConcurrentNode *path[CONCURRENT_MAX_HEIGHT + 1];
+    int depth = 0;
+    ConcurrentNode *current = tree->root;
+    while (current != NULL)
+    {
+        int comp = tree->compFunc(current->data, data);
+        if (comp == 0 || depth == CONCURRENT_MAX_HEIGHT)
+        {
+            return FAILURE;
+        }
+        oldPath[depth] = current;
+        wentLeft[depth++] = comp > 0;
+        current = comp > 0 ? current->left : current->right;
+    }
+    if (!reserveForInsert(tree, depth))
+    {
+        return FAILURE;
+    }
+
+    // copy the search path. nothing is shared with readers until the new root is published.
+    for (int i = 0; i < depth; ++i)
+    {
+        path[i] = copyNode(oldPath[i]);
+        if (path[i] == NULL)
+        {
+            for (int j = 0; j < i; ++j)
+            {
+                free(path[j]);
+            }
+            return FAILURE;
+        }
+    }
+    path[depth] = malloc(sizeof(ConcurrentNode));
+    if (path[depth] == NULL)
+    {
+        for (int j = 0; j < depth; ++j)
+        {
+            free(path[j]);
+        }
+        return FAILURE;
+    }
+    path[depth]->left = NULL;
+    path[depth]->right = NULL;
+    path[depth]->color = RED;
+    path[depth]->data = data;
+    for (int i = 0; i < depth; ++i)
+    {
+        if (wentLeft[i])
+        {
+            path[i]->left = path[i + 1];
+        }
+        else
+        {
+            path[i]->right = path[i + 1];
+        }
+        retireNode(tree, oldPath[i]);
+    }
+
+    ConcurrentNode *root = path[0];
+    fixPath(tree, path, depth, &root);
+
+    // publish, then open a new epoch: readers that enter from now on can't reach the retired nodes.
+    __atomic_store_n(&tree->root, root, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&tree->epoch, 1, __ATOMIC_SEQ_CST);
+    tree->size++;
+    if (tree->retiredCount >= RECLAIM_THRESHOLD)
+    {
+        reclaimRetired(tree);
+    }
+    return SUCCESS;
+}
+
+/**
+ * check whether the tree contains this item, without locks.
+ * @param tree: the tree to search.
+ * @param reader: the id of the calling reader.
+ * @param data: item to check.
+ * @return: 0 if the item is not in the tree, other if it is.
+ */
+int containsConcurrentRBTree(ConcurrentRBTree *tree, int reader, const void *data)
+{
+    if (tree == NULL || data == NULL || !isValidReader(tree, reader))
+    {
+        return FAILURE;
+    }
+    int found = FAILURE;
+    const ConcurrentNode *current = enterEpoch(tree, reader);
+    while (current != NULL)
+    {
+        int comp = tree->compFunc(current->data, data);
+        if (comp == 0)
+        {
+            found = SUCCESS;
+            break;
+        }
+        current = comp > 0 ? current->left : current->right;
+    }
+    leaveEpoch(tree, reader);
+    return found;
+}
+
+/**
+ * Activate a function on each item of a snapshot of the tree, in an ascending order. items the writer adds meanwhile
+ * are not visited. if one of the activations of the function returns 0, the process stops.
+ * @param tree: the tree with all the items.
+ * @param reader: the id of the calling reader.
+ * @param func: the function to activate on all items.
+ * @param args: more optional arguments to the function.
+ * @return: 0 on failure, other on success.
+ */
+int forEachConcurrentRBTree(ConcurrentRBTree *tree, int reader, forEachFunc func, void *args)
+{
+    if (tree == NULL || func == NULL || !isValidReader(tree, reader))
+    {
+        return FAILURE;
+    }
+    // the nodes have no parent pointers (a parent is copied whenever a child changes), so walk with a stack.
+    const ConcurrentNode *stack[CONCURRENT_MAX_HEIGHT];
+    int top = 0;
+    const ConcurrentNode *current = enterEpoch(tree, reader);
+    int result = current != NULL ? SUCCESS : FAILURE;
+    while (result && (current != NULL || top > 0))
+    {
+        while (current != NULL)
+        {
+            stack[top++] = current;
+            current = current->left;
+        }
+        current = stack[--top];
+        result = func(current->data, args) != 0;
+        current = current->right;
+    }
+    leaveEpoch(tree, reader);
+    return result;
+}
+
+/**
+ * frees the nodes of a subtree, and their items with freeFunc.
+ * @param node
+ * @param freeFunc
+ */
+static void freeSubtree(ConcurrentNode *node, FreeFunc freeFunc)
+{
+    if (node == NULL)
+    {
+        return;
+    }
+    freeSubtree(node->left, freeFunc);
+    freeSubtree(node->right, freeFunc);
+    freeFunc(node->data);
+    free(node);
+}
+
+/**
+ * free all memory of the tree. no reader or writer may use the tree anymore.
+ * @param tree: the tree to free.
+ */
+void freeConcurrentRBTree(ConcurrentRBTree *tree)
+{
+    if (tree == NULL)
+    {
+        return;
+    }
+    // retired nodes are old copies: their items are still in the tree and are freed with it.
+    for (int i = 0; i < tree->retiredCount; ++i)
+    {
+        free(tree->retired[i].node);
+    }
+    free(tree->retired);
+    for (int i = 0; i < tree->spareCount; ++i)
+    {
+        free(tree->spareNodes[i]);
+    }
+    freeSubtree(tree->root, tree->freeFunc);
+    free(tree);
+}
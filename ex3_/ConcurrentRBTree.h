@@ -0,0 +1,128 @@
+#ifndef RBTREE_CONCURRENTRBTREE_H
+#define RBTREE_CONCURRENTRBTREE_H
+
+#include "RBTree.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * maximal number of readers registered at the same time.
+ */
+#define CONCURRENT_MAX_READERS (64)
+
+/**
+ * maximal height of a concurrent tree (a red-black tree of less than 2^31 items is at most 62 nodes high).
+ */
+#define CONCURRENT_MAX_HEIGHT (64)
+
+/*
+ * a node of a concurrent tree. once a node is published it is never changed: the writer copies it instead.
+ */
+typedef struct ConcurrentNode
+{
+	struct ConcurrentNode *left, *right;
+	Color color;
+	void *data;
+} ConcurrentNode;
+
+/*
+ * the epoch a reader entered at (0 while it's outside the tree). one cache line each, so readers don't share lines.
+ */
+typedef struct ReaderSlot
+{
+	unsigned long epoch;
+	int used;
+	char padding[64 - sizeof(unsigned long) - sizeof(int)];
+} ReaderSlot;
+
+/*
+ * a replaced node, and the epoch it was unlinked at.
+ */
+typedef struct RetiredNode
+{
+	ConcurrentNode *node;
+	unsigned long epoch;
+} RetiredNode;
+
+/**
+ * a red-black tree for one writer and many lock-free readers. the writer copies the path it changes and publishes
+ * a new root, so a reader always walks a consistent snapshot. replaced nodes are freed once every reader that could
+ * have seen them has left the tree (epoch based reclamation).
+ */
+typedef struct ConcurrentRBTree
+{
+	ConcurrentNode *root; // read and written atomically
+	CompareFunc compFunc;
+	FreeFunc freeFunc;
+	int size; // maintained by the writer
+	unsigned long epoch; // the global epoch, advanced by the writer after each publish
+	ReaderSlot readers[CONCURRENT_MAX_READERS];
+	RetiredNode *retired; // ordered by epoch
+	int retiredCount, retiredCapacity;
+	ConcurrentNode *spareNodes[CONCURRENT_MAX_HEIGHT / 2]; // reserved before an insert, for the uncles it recolors
+	int spareCount;
+} ConcurrentRBTree;
+
+/**
+ * constructs a new empty concurrent tree.
+ * @param compFunc: a function two compare two variables.
+ * @param freeFunc: a function to free a data item.
+ * @return: the new tree, NULL on failure.
+ */
+ConcurrentRBTree *newConcurrentRBTree(CompareFunc compFunc, FreeFunc freeFunc);
+
+/**
+ * register the calling thread as a reader of the tree. may be called from any thread.
+ * @param tree: the tree to read.
+ * @return: the reader id to pass to the read functions, -1 if all CONCURRENT_MAX_READERS slots are taken.
+ */
+int registerConcurrentReader(ConcurrentRBTree *tree);
+
+/**
+ * release a reader id. the reader must not be inside a read function.
+ * @param tree: the tree the reader was registered to.
+ * @param reader: the id returned by registerConcurrentReader.
+ */
+void unregisterConcurrentReader(ConcurrentRBTree *tree, int reader);
+
+/**
+ * add an item to the tree. only one thread may write at a time, readers may run concurrently.
+ * @param tree: the tree to add an item to.
+ * @param data: item to add to the tree.
+ * @return: 0 on failure, other on success. (if the item is already in the tree - failure).
+ */
+int addToConcurrentRBTree(ConcurrentRBTree *tree, void *data);
+
+/**
+ * check whether the tree contains this item, without locks.
+ * @param tree: the tree to search.
+ * @param reader: the id of the calling reader.
+ * @param data: item to check.
+ * @return: 0 if the item is not in the tree, other if it is.
+ */
+int containsConcurrentRBTree(ConcurrentRBTree *tree, int reader, const void *data);
+
+/**
+ * Activate a function on each item of a snapshot of the tree, in an ascending order. items the writer adds meanwhile
+ * are not visited. if one of the activations of the function returns 0, the process stops.
+ * @param tree: the tree with all the items.
+ * @param reader: the id of the calling reader.
+ * @param func: the function to activate on all items.
+ * @param args: more optional arguments to the function.
+ * @return: 0 on failure, other on success.
+ */
+int forEachConcurrentRBTree(ConcurrentRBTree *tree, int reader, forEachFunc func, void *args);
+
+/**
+ * free all memory of the tree. no reader or writer may use the tree anymore.
+ * @param tree: the tree to free.
+ */
+void freeConcurrentRBTree(ConcurrentRBTree *tree);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //RBTREE_CONCURRENTRBTREE_H
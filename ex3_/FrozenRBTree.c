@@ -0,0 +1,242 @@
+#include "FrozenRBTree.h"
+#include <stdlib.h>
+
+#define SUCCESS (1)
+#define FAILURE (0)
+
+/**
+ * the distance (in items) from an item to its descendants 3 levels below, the 8 pointers of one cache line.
+ */
+#define PREFETCH_STRIDE (FROZEN_CACHE_LINE / sizeof(void *))
+
+/*
+ * where the next item of an in-order walk goes in an Eytzinger array.
+ */
+typedef struct EytzingerFill
+{
+    void **items;
+    size_t next;
+    size_t size;
+} EytzingerFill;
+
+/**
+ * forEachFunc that places the items of an ascending walk in an Eytzinger array.
+ * @param object
+ * @param args the EytzingerFill
+ * @return 1
+ */
+static int placeItem(const void *object, void *args)
+{
+    EytzingerFill *fill = (EytzingerFill *) args;
+    fill->items[fill->next] = (void *) object;
+    fill->next = eytzingerNext(fill->next, fill->size);
+    return SUCCESS;
+}
+
+/**
+ * FreeFunc that keeps the item, to free a tree whose items moved to another one.
+ * @param data
+ */
+static void keepItem(void *data)
+{
+    (void) data;
+}
+
+/**
+ * convert a tree into a frozen tree, in O(n). the tree can be of any engine, but not a tree opened by mapRBTree,
+ * whose items live in the mapping that freeing it unmaps.
+ * @param tree: the tree to freeze. on success it is freed and its items belong to the frozen tree.
+ * @return: the frozen tree, NULL on failure (then the tree is not changed).
+ */
+FrozenRBTree *freezeRBTree(RBTree *tree)
+{
+    if (tree == NULL || tree->mapped != NULL)
+    {
+        return NULL;
+    }
+    FrozenRBTree *frozen = malloc(sizeof(FrozenRBTree));
+    if (frozen == NULL)
+    {
+        return NULL;
+    }
+    frozen->block = malloc(sizeof(void *) * ((size_t) tree->size + 1) + FROZEN_CACHE_LINE - 1);
+    if (frozen->block == NULL)
+    {
+        free(frozen);
+        return NULL;
+    }
+    frozen->items = (void **) frozenAlign(frozen->block);
+    frozen->items[0] = NULL;
+    frozen->compFunc = tree->compFunc;
+    frozen->freeFunc = tree->freeFunc;
+    frozen->size = tree->size;
+
+    EytzingerFill fill = {frozen->items, eytzingerFirst((size_t) tree->size), (size_t) tree->size};
+    forEachRBTree(tree, placeItem, &fill);
+    tree->freeFunc = keepItem;
+    freeRBTree(tree);
+    return frozen;
+}
+
+/**
+ * convert a frozen tree back into a red-black engine tree, in O(n).
+ * @param frozen: the tree to thaw. on success it is freed and its items belong to the new tree.
+ * @return: the new tree, NULL on failure (then the frozen tree is not changed).
+ */
+RBTree *thawRBTree(FrozenRBTree *frozen)
+{
+    if (frozen == NULL)
+    {
+        return NULL;
+    }
+    void **sorted = malloc(sizeof(void *) * (frozen->size > 0 ? frozen->size : 1));
+    if (sorted == NULL)
+    {
+        return NULL;
+    }
+    int i = 0;
+    for (size_t k = eytzingerFirst((size_t) frozen->size); k != 0; k = eytzingerNext(k, (size_t) frozen->size))
+    {
+        sorted[i++] = frozen->items[k];
+    }
+    RBTree *tree = buildRBTreeFromSorted(sorted, frozen->size, frozen->compFunc, frozen->freeFunc);
+    free(sorted);
+    if (tree == NULL)
+    {
+        return NULL;
+    }
+    free(frozen->block);
+    free(frozen);
+    return tree;
+}
+
+/**
+ * descends the Eytzinger array without branching on the comparisons: right on every item lower than data, left on
+ * the others, prefetching the cache line of the items 3 levels below.
+ * @param frozen
+ * @param data
+ * @return the index of the smallest item that is not lower than data, 0 if there is none
+ */
+static size_t lowerBoundIndex(const FrozenRBTree *frozen, const void *data)
+{
+    size_t k = 1;
+    size_t n = (size_t) frozen->size;
+    while (k <= n)
+    {
+        __builtin_prefetch(frozen->items + PREFETCH_STRIDE * k);
+        k = 2 * k + (frozen->compFunc(frozen->items[k], data) < 0);
+    }
+    return eytzingerLowerBound(k);
+}
+
+/**
+ * @param frozen: the tree to search.
+ * @param data: item to compare to.
+ * @return: the item stored in the tree that is equal to data, NULL if there is none.
+ */
+void *findFrozenRBTree(const FrozenRBTree *frozen, const void *data)
+{
+    if (frozen == NULL || data == NULL)
+    {
+        return NULL;
+    }
+    size_t k = lowerBoundIndex(frozen, data);
+    return k != 0 && frozen->compFunc(frozen->items[k], data) == 0 ? frozen->items[k] : NULL;
+}
+
+/**
+ * check whether the frozen tree contains this item. the descent has no data dependent branches.
+ * @param frozen: the tree to search.
+ * @param data: item to check.
+ * @return: 0 if the item is not in the tree, other if it is.
+ */
+int containsFrozenRBTree(const FrozenRBTree *frozen, const void *data)
+{
+    return findFrozenRBTree(frozen, data) != NULL;
+}
+
+/**
+ * @param frozen: the tree to search.
+ * @param data: item to compare to.
+ * @return: the smallest item in the tree that is not lower than data, NULL if there is none.
+ */
+void *lowerBoundFrozenRBTree(const FrozenRBTree *frozen, const void *data)
+{
+    if (frozen == NULL || data == NULL)
+    {
+        return NULL;
+    }
+    return frozen->items[lowerBoundIndex(frozen, data)];
+}
+
+/**
+ * Activate a function on each item of the frozen tree, in an ascending order. if one of the activations of the
+ * function returns 0, the process stops.
+ * @param frozen: the tree with all the items.
+ * @param func: the function to activate on all items.
+ * @param args: more optional arguments to the function.
+ * @return: 0 on failure, other on success.
+ */
+int forEachFrozenRBTree(const FrozenRBTree *frozen, forEachFunc func, void *args)
+{
+    if (frozen == NULL || frozen->size == 0 || func == NULL)
+    {
+        return FAILURE;
+    }
+    size_t n = (size_t) frozen->size;
+    for (size_t k = eytzingerFirst(n); k != 0; k = eytzingerNext(k, n))
+    {
+        if (func(frozen->items[k], args) == 0)
+        {
+            return FAILURE;
+        }
+    }
+    return SUCCESS;
+}
+
+/**
+ * Activate a function on each item of the frozen tree in the range [lo, hi), in O(log n + k) for k items. the order
+ * is an ascending order. if one of the activations of the function returns 0, the process stops.
+ * @param frozen: the tree with all the items.
+ * @param lo: lowest item of the range (inclusive).
+ * @param hi: the end of the range (exclusive).
+ * @param func: the function to activate on the items.
+ * @param args: more optional arguments to the function.
+ * @return: 0 on failure, other on success (an empty range is a success).
+ */
+int forEachFrozenRBTreeRange(const FrozenRBTree *frozen, const void *lo, const void *hi, forEachFunc func,
+                             void *args)
+{
+    if (frozen == NULL || lo == NULL || hi == NULL || func == NULL)
+    {
+        return FAILURE;
+    }
+    size_t n = (size_t) frozen->size;
+    for (size_t k = lowerBoundIndex(frozen, lo); k != 0 && frozen->compFunc(frozen->items[k], hi) < 0;
+         k = eytzingerNext(k, n))
+    {
+        if (func(frozen->items[k], args) == 0)
+        {
+            return FAILURE;
+        }
+    }
+    return SUCCESS;
+}
+
+/**
+ * free all memory of the frozen tree, and its items with freeFunc.
+ * @param frozen: the tree to free.
+ */
+void freeFrozenRBTree(FrozenRBTree *frozen)
+{
+    if (frozen == NULL)
+    {
+        return;
+    }
+    for (int k = 1; k <= frozen->size; ++k)
+    {
+        frozen->freeFunc(frozen->items[k]);
+    }
+    free(frozen->block);
+    free(frozen);
+}
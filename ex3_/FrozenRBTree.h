@@ -0,0 +1,156 @@
+#ifndef RBTREE_FROZENRBTREE_H
+#define RBTREE_FROZENRBTREE_H
+
+#include "RBTree.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * size of a cache line, the alignment of the array of a frozen tree.
+ */
+#define FROZEN_CACHE_LINE (64)
+
+/**
+ * @param block: an allocation of at least FROZEN_CACHE_LINE - 1 bytes more than needed.
+ * @return: the first address in the block that is aligned to a cache line.
+ */
+static inline void *frozenAlign(void *block)
+{
+	return (void *) (((uintptr_t) block + FROZEN_CACHE_LINE - 1) & ~((uintptr_t) FROZEN_CACHE_LINE - 1));
+}
+
+/**
+ * @param n: number of items in an Eytzinger array.
+ * @return: the index of the smallest item, 0 if there is none.
+ */
+static inline size_t eytzingerFirst(size_t n)
+{
+	size_t k = n > 0 ? 1 : 0;
+	while (k != 0 && 2 * k <= n)
+	{
+		k *= 2;
+	}
+	return k;
+}
+
+/**
+ * @param k: an index in an Eytzinger array of n items.
+ * @param n: number of items.
+ * @return: the index of the next item in an ascending order, 0 after the last one.
+ */
+static inline size_t eytzingerNext(size_t k, size_t n)
+{
+	if (2 * k + 1 <= n)
+	{
+		// the leftmost item of the right subtree.
+		k = 2 * k + 1;
+		while (2 * k <= n)
+		{
+			k *= 2;
+		}
+		return k;
+	}
+	// climb while k is a right child, and once more: the first ancestor whose left subtree k is in.
+	return k >> (__builtin_ctzl(~k) + 1);
+}
+
+/**
+ * @param k: the index an Eytzinger descent ended at (beyond the array), after going right on every item lower than
+ * the searched one and left on the others.
+ * @return: the index of the last item the descent went left at (the lower bound), 0 if there is none.
+ */
+static inline size_t eytzingerLowerBound(size_t k)
+{
+	return k >> (__builtin_ctzl(~k) + 1);
+}
+
+/**
+ * a read only tree: the items of a tree in a single array, in the Eytzinger (BFS) order of a complete binary tree.
+ * items[1] is the root and the children of items[k] are items[2k] and items[2k + 1]. a lookup reads one array, its
+ * first levels stay in cache, and the items 3 levels below the current one share a cache line, so they are prefetched
+ * while the current item is compared.
+ */
+typedef struct FrozenRBTree
+{
+	void **items; // items[1..size], aligned to a cache line. items[0] is unused.
+	void *block; // the allocation that items points into.
+	CompareFunc compFunc;
+	FreeFunc freeFunc;
+	int size;
+} FrozenRBTree;
+
+/**
+ * convert a tree into a frozen tree, in O(n). the tree can be of any engine, but not a tree opened by mapRBTree,
+ * whose items live in the mapping that freeing it unmaps.
+ * @param tree: the tree to freeze. on success it is freed and its items belong to the frozen tree.
+ * @return: the frozen tree, NULL on failure (then the tree is not changed).
+ */
+FrozenRBTree *freezeRBTree(RBTree *tree);
+
+/**
+ * convert a frozen tree back into a red-black engine tree, in O(n).
+ * @param frozen: the tree to thaw. on success it is freed and its items belong to the new tree.
+ * @return: the new tree, NULL on failure (then the frozen tree is not changed).
+ */
+RBTree *thawRBTree(FrozenRBTree *frozen);
+
+/**
+ * check whether the frozen tree contains this item. the descent has no data dependent branches.
+ * @param frozen: the tree to search.
+ * @param data: item to check.
+ * @return: 0 if the item is not in the tree, other if it is.
+ */
+int containsFrozenRBTree(const FrozenRBTree *frozen, const void *data);
+
+/**
+ * @param frozen: the tree to search.
+ * @param data: item to compare to.
+ * @return: the item stored in the tree that is equal to data, NULL if there is none.
+ */
+void *findFrozenRBTree(const FrozenRBTree *frozen, const void *data);
+
+/**
+ * @param frozen: the tree to search.
+ * @param data: item to compare to.
+ * @return: the smallest item in the tree that is not lower than data, NULL if there is none.
+ */
+void *lowerBoundFrozenRBTree(const FrozenRBTree *frozen, const void *data);
+
+/**
+ * Activate a function on each item of the frozen tree, in an ascending order. if one of the activations of the
+ * function returns 0, the process stops.
+ * @param frozen: the tree with all the items.
+ * @param func: the function to activate on all items.
+ * @param args: more optional arguments to the function.
+ * @return: 0 on failure, other on success.
+ */
+int forEachFrozenRBTree(const FrozenRBTree *frozen, forEachFunc func, void *args);
+
+/**
+ * Activate a function on each item of the frozen tree in the range [lo, hi), in O(log n + k) for k items. the order
+ * is an ascending order. if one of the activations of the function returns 0, the process stops.
+ * @param frozen: the tree with all the items.
+ * @param lo: lowest item of the range (inclusive).
+ * @param hi: the end of the range (exclusive).
+ * @param func: the function to activate on the items.
+ * @param args: more optional arguments to the function.
+ * @return: 0 on failure, other on success (an empty range is a success).
+ */
+int forEachFrozenRBTreeRange(const FrozenRBTree *frozen, const void *lo, const void *hi, forEachFunc func,
+                             void *args);
+
+/**
+ * free all memory of the frozen tree, and its items with freeFunc.
+ * @param frozen: the tree to free.
+ */
+void freeFrozenRBTree(FrozenRBTree *frozen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //RBTREE_FROZENRBTREE_H
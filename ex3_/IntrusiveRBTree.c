@@ -0,0 +1,475 @@
+#include "IntrusiveRBTree.h"
+
+#define SUCCESS (1)
+#define FAILURE (0)
+
+/**
+ * @param tree
+ * @param link
+ * @return the object that contains the link
+ */
+static void *objectOf(const IntrusiveRBTree *tree, const RBLink *link)
+{
+    return (char *) link - tree->linkOffset;
+}
+
+/**
+ * @param tree
+ * @param object
+ * @return the link member of the object
+ */
+static RBLink *linkOf(const IntrusiveRBTree *tree, const void *object)
+{
+    return (RBLink *) ((char *) object + tree->linkOffset);
+}
+
+/**
+ * @param link
+ * @return 1 if the link is black (NULL leaves are black), 0 else
+ */
+static int isBlack(const RBLink *link)
+{
+    return link == NULL || link->color == BLACK;
+}
+
+/**
+ * puts p in the place of its parent g in the tree (the common part of both rotations).
+ * @param tree
+ * @param g
+ * @param p
+ */
+static void replaceChild(IntrusiveRBTree *tree, RBLink *g, RBLink *p)
+{
+    p->parent = g->parent;
+    if (g->parent == NULL)
+    {
+        tree->root = p;
+    }
+    else if (g->parent->left == g)
+    {
+        g->parent->left = p;
+    }
+    else
+    {
+        g->parent->right = p;
+    }
+}
+
+/**
+ * rotates the subtree of g to the left.
+ * @param tree
+ * @param g
+ */
+static void rotateLeft(IntrusiveRBTree *tree, RBLink *g)
+{
+    RBLink *p = g->right;
+    g->right = p->left;
+    if (p->left != NULL)
+    {
+        p->left->parent = g;
+    }
+    replaceChild(tree, g, p);
+    p->left = g;
+    g->parent = p;
+}
+
+/**
+ * rotates the subtree of g to the right.
+ * @param tree
+ * @param g
+ */
+static void rotateRight(IntrusiveRBTree *tree, RBLink *g)
+{
+    RBLink *p = g->left;
+    g->left = p->right;
+    if (p->right != NULL)
+    {
+        p->right->parent = g;
+    }
+    replaceChild(tree, g, p);
+    p->right = g;
+    g->parent = p;
+}
+
+/**
+ * initializes an empty intrusive tree.
+ * @param tree: the tree to initialize.
+ * @param linkOffset: offsetof(Type, member) of the RBLink member of the objects.
+ * @param compFunc: a function two compare two objects.
+ */
+void initIntrusiveRBTree(IntrusiveRBTree *tree, size_t linkOffset, CompareFunc compFunc)
+{
+    tree->root = NULL;
+    tree->linkOffset = linkOffset;
+    tree->compFunc = compFunc;
+    tree->size = 0;
+}
+
+/**
+ * fixes the tree after a new link was inserted: recolor on a red uncle, otherwise straighten the path and rotate the
+ * grandparent (the same cases as fixTree in RBTree.c).
+ * @param tree
+ * @param link
+ */
+static void fixTree(IntrusiveRBTree *tree, RBLink *link)
+{
+    while (link != tree->root && link->parent->color == RED)
+    {
+        RBLink *parent = link->parent;
+        RBLink *grandparent = parent->parent;
+        RBLink *uncle = grandparent->left == parent ? grandparent->right : grandparent->left;
+        if (!isBlack(uncle))
+        {
+            uncle->color = BLACK;
+            parent->color = BLACK;
+            grandparent->color = RED;
+            link = grandparent;
+            continue;
+        }
+        if (grandparent->left == parent)
+        {
+            if (parent->right == link)
+            {
+                rotateLeft(tree, parent);
+                parent = link;
+            }
+            rotateRight(tree, grandparent);
+        }
+        else
+        {
+            if (parent->left == link)
+            {
+                rotateRight(tree, parent);
+                parent = link;
+            }
+            rotateLeft(tree, grandparent);
+        }
+        parent->color = BLACK;
+        grandparent->color = RED;
+        break;
+    }
+    tree->root->color = BLACK;
+}
+
+/**
+ * link an object into the tree, with no allocation.
+ * @param tree: the tree to add the object to.
+ * @param object: the object to add. its RBLink member is overwritten.
+ * @return: 0 on failure, other on success. (if an equal object is already in the tree - failure).
+ */
+int addToIntrusiveRBTree(IntrusiveRBTree *tree, void *object)
+{
+    if (tree == NULL || object == NULL)
+    {
+        return FAILURE;
+    }
+    RBLink *parent = NULL;
+    RBLink *current = tree->root;
+    int comp = 0;
+    while (current != NULL)
+    {
+        comp = tree->compFunc(objectOf(tree, current), object);
+        if (comp == 0)
+        {
+            return FAILURE;
+        }
+        parent = current;
+        current = comp > 0 ? current->left : current->right;
+    }
+
+    RBLink *link = linkOf(tree, object);
+    link->parent = parent;
+    link->left = NULL;
+    link->right = NULL;
+    link->color = RED;
+    if (parent == NULL)
+    {
+        tree->root = link;
+    }
+    else if (comp > 0)
+    {
+        parent->left = link;
+    }
+    else
+    {
+        parent->right = link;
+    }
+    tree->size++;
+    fixTree(tree, link);
+    return SUCCESS;
+}
+
+/**
+ * @param tree: the tree to search.
+ * @param object: object to compare to (only needs the fields compFunc reads).
+ * @return: the object in the tree that is equal to the given one, NULL if there is none.
+ */
+void *findIntrusiveRBTree(const IntrusiveRBTree *tree, const void *object)
+{
+    if (tree == NULL || object == NULL)
+    {
+        return NULL;
+    }
+    const RBLink *current = tree->root;
+    while (current != NULL)
+    {
+        int comp = tree->compFunc(objectOf(tree, current), object);
+        if (comp == 0)
+        {
+            return objectOf(tree, current);
+        }
+        current = comp > 0 ? current->left : current->right;
+    }
+    return NULL;
+}
+
+/**
+ * check whether the tree contains an object equal to the given one.
+ * @param tree: the tree to search.
+ * @param object: object to check.
+ * @return: 0 if the object is not in the tree, other if it is.
+ */
+int containsIntrusiveRBTree(const IntrusiveRBTree *tree, const void *object)
+{
+    return findIntrusiveRBTree(tree, object) != NULL ? SUCCESS : FAILURE;
+}
+
+/**
+ * puts the subtree of v in the place of the subtree of u.
+ * @param tree
+ * @param u
+ * @param v may be NULL
+ */
+static void transplant(IntrusiveRBTree *tree, RBLink *u, RBLink *v)
+{
+    if (u->parent == NULL)
+    {
+        tree->root = v;
+    }
+    else if (u->parent->left == u)
+    {
+        u->parent->left = v;
+    }
+    else
+    {
+        u->parent->right = v;
+    }
+    if (v != NULL)
+    {
+        v->parent = u->parent;
+    }
+}
+
+/**
+ * fixes the tree after a black link was removed from above x.
+ * @param tree
+ * @param x the link that carries the extra black, may be NULL
+ * @param parent the parent of x (needed when x is NULL)
+ */
+static void fixTreeAfterRemove(IntrusiveRBTree *tree, RBLink *x, RBLink *parent)
+{
+    while (x != tree->root && isBlack(x))
+    {
+        int left = x == parent->left;
+        RBLink *sibling = left ? parent->right : parent->left;
+        if (sibling->color == RED)
+        {
+            sibling->color = BLACK;
+            parent->color = RED;
+            if (left)
+            {
+                rotateLeft(tree, parent);
+            }
+            else
+            {
+                rotateRight(tree, parent);
+            }
+            sibling = left ? parent->right : parent->left;
+        }
+        if (isBlack(sibling->left) && isBlack(sibling->right))
+        {
+            sibling->color = RED;
+            x = parent;
+            parent = x->parent;
+            continue;
+        }
+        if (left && isBlack(sibling->right))
+        {
+            sibling->left->color = BLACK;
+            sibling->color = RED;
+            rotateRight(tree, sibling);
+            sibling = parent->right;
+        }
+        else if (!left && isBlack(sibling->left))
+        {
+            sibling->right->color = BLACK;
+            sibling->color = RED;
+            rotateLeft(tree, sibling);
+            sibling = parent->left;
+        }
+        sibling->color = parent->color;
+        parent->color = BLACK;
+        if (left)
+        {
+            sibling->right->color = BLACK;
+            rotateLeft(tree, parent);
+        }
+        else
+        {
+            sibling->left->color = BLACK;
+            rotateRight(tree, parent);
+        }
+        x = tree->root;
+    }
+    if (x != NULL)
+    {
+        x->color = BLACK;
+    }
+}
+
+/**
+ * unlink an object that is in the tree, in O(log n) and without searching for it. the object is not freed.
+ * @param tree: the tree the object is in.
+ * @param object: the object to unlink (the very object that was added, not an equal one).
+ */
+void removeFromIntrusiveRBTree(IntrusiveRBTree *tree, void *object)
+{
+    if (tree == NULL || object == NULL)
+    {
+        return;
+    }
+    RBLink *link = linkOf(tree, object);
+    Color removedColor = link->color;
+    RBLink *x, *xParent;
+    if (link->left == NULL || link->right == NULL)
+    {
+        x = link->left != NULL ? link->left : link->right;
+        xParent = link->parent;
+        transplant(tree, link, x);
+    }
+    else
+    {
+        RBLink *next = link->right;
+        while (next->left != NULL)
+        {
+            next = next->left;
+        }
+        removedColor = next->color;
+        x = next->right;
+        if (next->parent == link)
+        {
+            xParent = next;
+        }
+        else
+        {
+            xParent = next->parent;
+            transplant(tree, next, next->right);
+            next->right = link->right;
+            next->right->parent = next;
+        }
+        transplant(tree, link, next);
+        next->left = link->left;
+        next->left->parent = next;
+        next->color = link->color;
+    }
+    if (removedColor == BLACK)
+    {
+        fixTreeAfterRemove(tree, x, xParent);
+    }
+    link->parent = link->left = link->right = NULL;
+    tree->size--;
+}
+
+/**
+ * Activate a function on each object of the tree, in an ascending order. if one of the activations of the
+ * function returns 0, the process stops.
+ * @param tree: the tree with all the objects.
+ * @param func: the function to activate on all objects.
+ * @param args: more optional arguments to the function.
+ * @return: 0 on failure, other on success.
+ */
+int forEachIntrusiveRBTree(const IntrusiveRBTree *tree, forEachFunc func, void *args)
+{
+    if (tree == NULL || tree->root == NULL || func == NULL)
+    {
+        return FAILURE;
+    }
+    const RBLink *link = tree->root;
+    while (link->left != NULL)
+    {
+        link = link->left;
+    }
+    while (link != NULL)
+    {
+        if (func(objectOf(tree, link), args) == 0)
+        {
+            return FAILURE;
+        }
+        if (link->right != NULL)
+        {
+            link = link->right;
+            while (link->left != NULL)
+            {
+                link = link->left;
+            }
+        }
+        else
+        {
+            while (link->parent != NULL && link->parent->right == link)
+            {
+                link = link->parent;
+            }
+            link = link->parent;
+        }
+    }
+    return SUCCESS;
+}
+
+/**
+ * unlink all the objects of the tree, leaving it empty.
+ * @param tree: the tree to clear.
+ * @param freeFunc: a function to free each object after it was unlinked, may be NULL.
+ */
+void clearIntrusiveRBTree(IntrusiveRBTree *tree, FreeFunc freeFunc)
+{
+    if (tree == NULL)
+    {
+        return;
+    }
+    // unlink bottom up without recursion: descend to a leaf, release it and continue from its parent.
+    RBLink *link = tree->root;
+    while (link != NULL)
+    {
+        if (link->left != NULL)
+        {
+            link = link->left;
+        }
+        else if (link->right != NULL)
+        {
+            link = link->right;
+        }
+        else
+        {
+            RBLink *parent = link->parent;
+            if (parent != NULL)
+            {
+                if (parent->left == link)
+                {
+                    parent->left = NULL;
+                }
+                else
+                {
+                    parent->right = NULL;
+                }
+            }
+            link->parent = NULL;
+            if (freeFunc != NULL)
+            {
+                freeFunc(objectOf(tree, link));
+            }
+            link = parent;
+        }
+    }
+    tree->root = NULL;
+    tree->size = 0;
+}
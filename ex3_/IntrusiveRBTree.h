@@ -0,0 +1,98 @@
+#ifndef RBTREE_INTRUSIVERBTREE_H
+#define RBTREE_INTRUSIVERBTREE_H
+
+#include "RBTree.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * the links of an object in an intrusive tree. embed it as a member of the object's struct.
+ */
+typedef struct RBLink
+{
+	struct RBLink *parent, *left, *right;
+	Color color;
+} RBLink;
+
+/**
+ * @param link: pointer to the RBLink member of an object.
+ * @param Type: the struct type of the object.
+ * @param member: name of the RBLink member in Type.
+ * @return: pointer to the object that contains the link.
+ */
+#define RB_CONTAINER_OF(link, Type, member) ((Type *) ((char *) (link) - offsetof(Type, member)))
+
+/**
+ * represents an intrusive tree. the tree allocates nothing: the objects are linked through their RBLink member.
+ */
+typedef struct IntrusiveRBTree
+{
+	RBLink *root;
+	size_t linkOffset; // offset of the RBLink member in the objects (offsetof(Type, member))
+	CompareFunc compFunc; // compares two objects
+	int size;
+} IntrusiveRBTree;
+
+/**
+ * initializes an empty intrusive tree.
+ * @param tree: the tree to initialize.
+ * @param linkOffset: offsetof(Type, member) of the RBLink member of the objects.
+ * @param compFunc: a function two compare two objects.
+ */
+void initIntrusiveRBTree(IntrusiveRBTree *tree, size_t linkOffset, CompareFunc compFunc);
+
+/**
+ * link an object into the tree, with no allocation.
+ * @param tree: the tree to add the object to.
+ * @param object: the object to add. its RBLink member is overwritten.
+ * @return: 0 on failure, other on success. (if an equal object is already in the tree - failure).
+ */
+int addToIntrusiveRBTree(IntrusiveRBTree *tree, void *object);
+
+/**
+ * @param tree: the tree to search.
+ * @param object: object to compare to (only needs the fields compFunc reads).
+ * @return: the object in the tree that is equal to the given one, NULL if there is none.
+ */
+void *findIntrusiveRBTree(const IntrusiveRBTree *tree, const void *object);
+
+/**
+ * check whether the tree contains an object equal to the given one.
+ * @param tree: the tree to search.
+ * @param object: object to check.
+ * @return: 0 if the object is not in the tree, other if it is.
+ */
+int containsIntrusiveRBTree(const IntrusiveRBTree *tree, const void *object);
+
+/**
+ * unlink an object that is in the tree, in O(log n) and without searching for it. the object is not freed.
+ * @param tree: the tree the object is in.
+ * @param object: the object to unlink (the very object that was added, not an equal one).
+ */
+void removeFromIntrusiveRBTree(IntrusiveRBTree *tree, void *object);
+
+/**
+ * Activate a function on each object of the tree, in an ascending order. if one of the activations of the
+ * function returns 0, the process stops.
+ * @param tree: the tree with all the objects.
+ * @param func: the function to activate on all objects.
+ * @param args: more optional arguments to the function.
+ * @return: 0 on failure, other on success.
+ */
+int forEachIntrusiveRBTree(const IntrusiveRBTree *tree, forEachFunc func, void *args);
+
+/**
+ * unlink all the objects of the tree, leaving it empty.
+ * @param tree: the tree to clear.
+ * @param freeFunc: a function to free each object after it was unlinked, may be NULL.
+ */
+void clearIntrusiveRBTree(IntrusiveRBTree *tree, FreeFunc freeFunc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //RBTREE_INTRUSIVERBTREE_H
@@ -0,0 +1,409 @@
+#define _GNU_SOURCE
+
+#include "MappedRBTree.h"
+#include "FrozenRBTree.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SUCCESS (1)
+#define FAILURE (0)
+
+/**
+ * the distance (in index entries) from an entry to its descendants 3 levels below, the 8 entries of one cache line.
+ */
+#define PREFETCH_STRIDE (FROZEN_CACHE_LINE / sizeof(uint64_t))
+
+/*
+ * the items of a tree in an ascending order, collected for saveRBTree.
+ */
+typedef struct ItemList
+{
+    const void **items;
+    size_t next;
+} ItemList;
+
+/**
+ * forEachFunc that appends an item to an ItemList.
+ * @param object
+ * @param args the ItemList
+ * @return 1
+ */
+static int collectItem(const void *object, void *args)
+{
+    ItemList *list = (ItemList *) args;
+    list->items[list->next++] = object;
+    return SUCCESS;
+}
+
+/**
+ * FreeFunc of a mapped tree: its items are in the file.
+ * @param data
+ */
+static void keepPayload(void *data)
+{
+    (void) data;
+}
+
+/**
+ * writes the payloads of the items after the index, and sets the offset of each one.
+ * @param file positioned at the end of the index
+ * @param items the items in an ascending order
+ * @param n
+ * @param serialize
+ * @param offsets out, offsets[i] is the offset of the payload of items[i]
+ * @param end out, the size of the file
+ * @return 1 on success, 0 on failure
+ */
+static int writePayloads(FILE *file, const void **items, size_t n, SerializeFunc serialize, uint64_t *offsets,
+                         uint64_t *end)
+{
+    static const char padding[MAPPED_ALIGNMENT] = {0};
+    size_t capacity = 256;
+    char *buffer = malloc(capacity);
+    if (buffer == NULL)
+    {
+        return FAILURE;
+    }
+    uint64_t offset = *end;
+    for (size_t i = 0; i < n; ++i)
+    {
+        size_t bytes = serialize(items[i], buffer, capacity);
+        if (bytes > capacity)
+        {
+            char *larger = realloc(buffer, bytes);
+            if (larger == NULL)
+            {
+                free(buffer);
+                return FAILURE;
+            }
+            buffer = larger;
+            capacity = bytes;
+            bytes = serialize(items[i], buffer, capacity);
+        }
+        size_t pad = (size_t) ((MAPPED_ALIGNMENT - offset % MAPPED_ALIGNMENT) % MAPPED_ALIGNMENT);
+        if (fwrite(padding, 1, pad, file) != pad || fwrite(buffer, 1, bytes, file) != bytes)
+        {
+            free(buffer);
+            return FAILURE;
+        }
+        offsets[i] = offset + pad;
+        offset += pad + bytes;
+    }
+    free(buffer);
+    *end = offset;
+    return SUCCESS;
+}
+
+/**
+ * writes a whole snapshot to a file.
+ * @param file an empty file
+ * @param items the items in an ascending order
+ * @param n
+ * @param serialize
+ * @return 1 on success, 0 on failure
+ */
+static int writeSnapshot(FILE *file, const void **items, size_t n, SerializeFunc serialize)
+{
+    uint64_t *offsets = malloc(sizeof(uint64_t) * (n > 0 ? n : 1));
+    uint64_t *index = malloc(sizeof(uint64_t) * (n + 1));
+    if (offsets == NULL || index == NULL)
+    {
+        free(offsets);
+        free(index);
+        return FAILURE;
+    }
+    // the payloads go first, after room for the header and the index, which need their offsets.
+    uint64_t end = sizeof(MappedHeader) + sizeof(uint64_t) * (n + 1);
+    int result = fseek(file, (long) end, SEEK_SET) == 0 && writePayloads(file, items, n, serialize, offsets, &end);
+    if (result)
+    {
+        index[0] = 0;
+        size_t i = 0;
+        for (size_t k = eytzingerFirst(n); k != 0; k = eytzingerNext(k, n))
+        {
+            index[k] = offsets[i++];
+        }
+        MappedHeader header;
+        memcpy(header.magic, MAPPED_MAGIC, sizeof(header.magic));
+        header.size = n;
+        header.fileSize = end;
+        result = fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1 &&
+                 fwrite(index, sizeof(uint64_t), n + 1, file) == n + 1;
+    }
+    free(offsets);
+    free(index);
+    return result;
+}
+
+/**
+ * write the items of a tree to a snapshot file, in O(n). the file is written next to path and renamed over it, so
+ * path always holds a complete snapshot. the tree can be of any engine.
+ * @param tree: the tree to save.
+ * @param path: the snapshot file.
+ * @param serialize: writes the payload of an item.
+ * @return: 0 on failure, other on success.
+ */
+int saveRBTree(RBTree *tree, const char *path, SerializeFunc serialize)
+{
+    if (tree == NULL || path == NULL || serialize == NULL)
+    {
+        return FAILURE;
+    }
+    size_t n = (size_t) tree->size;
+    ItemList list = {malloc(sizeof(void *) * (n > 0 ? n : 1)), 0};
+    char *temporary = malloc(strlen(path) + sizeof(".tmp"));
+    if (list.items == NULL || temporary == NULL)
+    {
+        free(list.items);
+        free(temporary);
+        return FAILURE;
+    }
+    if (n > 0)
+    {
+        forEachRBTree(tree, collectItem, &list);
+    }
+    strcpy(temporary, path);
+    strcat(temporary, ".tmp");
+
+    FILE *file = fopen(temporary, "wb");
+    int result = file != NULL && writeSnapshot(file, list.items, n, serialize);
+    result = file != NULL && fclose(file) == 0 && result;
+    result = result && rename(temporary, path) == 0;
+    if (!result && file != NULL)
+    {
+        remove(temporary);
+    }
+    free(list.items);
+    free(temporary);
+    return result;
+}
+
+/**
+ * @param base a mapped file
+ * @param bytes its size
+ * @return 1 if the file is a complete snapshot, 0 else. every offset in the index is checked to be an aligned offset
+ * after the index and inside the file, so a corrupt index can't send a query out of the mapping.
+ */
+static int isSnapshot(const char *base, size_t bytes)
+{
+    if (bytes < sizeof(MappedHeader))
+    {
+        return FAILURE;
+    }
+    MappedHeader header;
+    memcpy(&header, base, sizeof(header));
+    if (memcmp(header.magic, MAPPED_MAGIC, sizeof(header.magic)) != 0 || header.fileSize != bytes ||
+        header.size >= bytes / sizeof(uint64_t) || sizeof(MappedHeader) + sizeof(uint64_t) * (header.size + 1) > bytes)
+    {
+        return FAILURE;
+    }
+    const uint64_t *index = (const uint64_t *) (base + sizeof(MappedHeader));
+    uint64_t payloads = sizeof(MappedHeader) + sizeof(uint64_t) * (header.size + 1);
+    for (uint64_t k = 1; k <= header.size; ++k)
+    {
+        if (index[k] < payloads || index[k] >= bytes || index[k] % MAPPED_ALIGNMENT != 0)
+        {
+            return FAILURE;
+        }
+    }
+    return SUCCESS;
+}
+
+/**
+ * open a snapshot file as a read only tree: the file is mapped and the queries read the index and the payloads in
+ * its pages, with no parsing and no allocation per item. opening checks the offsets of the index, in O(n). the tree
+ * supports containsRBTree, findRBTree, lowerBoundRBTree, upperBoundRBTree, floorRBTree, ceilRBTree, forEachRBTree,
+ * forEachRBTreeRange and freeRBTree (which unmaps the file). the items are the payloads in the file, so they are not freed.
+ * @param path: a file written by saveRBTree.
+ * @param compFunc: compares two payloads, in the order of the saved tree.
+ * @return: the new tree, NULL on failure (e.g. the file is missing or isn't a snapshot).
+ */
+RBTree *mapRBTree(const char *path, CompareFunc compFunc)
+{
+    if (path == NULL || compFunc == NULL)
+    {
+        return NULL;
+    }
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    struct stat status;
+    void *base = MAP_FAILED;
+    if (fstat(fd, &status) == 0 && status.st_size > 0)
+    {
+        base = mmap(NULL, (size_t) status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    // the mapping keeps the file alive.
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        return NULL;
+    }
+    size_t bytes = (size_t) status.st_size;
+    MappedRBTree *mapped = isSnapshot(base, bytes) ? malloc(sizeof(MappedRBTree)) : NULL;
+    RBTree *tree = mapped != NULL ? newRBTree(compFunc, keepPayload) : NULL;
+    if (tree == NULL)
+    {
+        free(mapped);
+        munmap(base, bytes);
+        return NULL;
+    }
+    mapped->base = (const char *) base;
+    mapped->bytes = bytes;
+    mapped->index = (const uint64_t *) (mapped->base + sizeof(MappedHeader));
+    mapped->compFunc = compFunc;
+    mapped->size = (size_t) ((const MappedHeader *) base)->size;
+    tree->mapped = mapped;
+    tree->size = (int) mapped->size;
+    return tree;
+}
+
+/**
+ * @param mapped
+ * @param k an index entry
+ * @return the payload of the entry
+ */
+static inline void *payload(const MappedRBTree *mapped, size_t k)
+{
+    return (void *) (mapped->base + mapped->index[k]);
+}
+
+/**
+ * descends the Eytzinger index like FrozenRBTree does, prefetching the entries 3 levels below.
+ * @param mapped
+ * @param data
+ * @param rightOnEqual 1 to go right at a payload equal to data, 0 to go left
+ * @return the index the descent ended at (beyond the index)
+ */
+static size_t descendIndex(const MappedRBTree *mapped, const void *data, int rightOnEqual)
+{
+    size_t k = 1;
+    while (k <= mapped->size)
+    {
+        __builtin_prefetch(mapped->index + PREFETCH_STRIDE * k);
+        int comp = mapped->compFunc(payload(mapped, k), data);
+        k = 2 * k + (comp < 0 || (rightOnEqual && comp == 0));
+    }
+    return k;
+}
+
+/**
+ * @param mapped
+ * @param data
+ * @return the entry of the smallest payload that is not lower than data, 0 if there is none
+ */
+static size_t lowerBoundEntry(const MappedRBTree *mapped, const void *data)
+{
+    return eytzingerLowerBound(descendIndex(mapped, data, 0));
+}
+
+/**
+ * @param mapped: the items to search.
+ * @param data: item to compare to.
+ * @return: the payload that is equal to data, NULL if there is none.
+ */
+void *findMappedRBTree(const MappedRBTree *mapped, const void *data)
+{
+    if (mapped == NULL || data == NULL)
+    {
+        return NULL;
+    }
+    size_t k = lowerBoundEntry(mapped, data);
+    return k != 0 && mapped->compFunc(payload(mapped, k), data) == 0 ? payload(mapped, k) : NULL;
+}
+
+/**
+ * @param mapped: the items to search.
+ * @param data: item to compare to.
+ * @return: the smallest payload that is not lower than data, NULL if there is none.
+ */
+void *lowerBoundMappedRBTree(const MappedRBTree *mapped, const void *data)
+{
+    if (mapped == NULL || data == NULL)
+    {
+        return NULL;
+    }
+    size_t k = lowerBoundEntry(mapped, data);
+    return k != 0 ? payload(mapped, k) : NULL;
+}
+
+/**
+ * @param mapped: the items to search.
+ * @param data: item to compare to.
+ * @return: the smallest payload that is greater than data, NULL if there is none.
+ */
+void *upperBoundMappedRBTree(const MappedRBTree *mapped, const void *data)
+{
+    if (mapped == NULL || data == NULL)
+    {
+        return NULL;
+    }
+    size_t k = eytzingerLowerBound(descendIndex(mapped, data, 1));
+    return k != 0 ? payload(mapped, k) : NULL;
+}
+
+/**
+ * @param mapped: the items to search.
+ * @param data: item to compare to.
+ * @return: the largest payload that is lower than or equal to data, NULL if there is none.
+ */
+void *floorMappedRBTree(const MappedRBTree *mapped, const void *data)
+{
+    if (mapped == NULL || data == NULL)
+    {
+        return NULL;
+    }
+    // the last entry the descent went right at: climb while the index is a left child, and once more.
+    size_t k = descendIndex(mapped, data, 1);
+    k >>= __builtin_ctzl(k) + 1;
+    return k != 0 ? payload(mapped, k) : NULL;
+}
+
+/**
+ * Activate a function on each payload in the range [lo, hi) (on all of them if lo is NULL), in an ascending order. if
+ * one of the activations of the function returns 0, the process stops.
+ * @param mapped: the items.
+ * @param lo: lowest item of the range (inclusive), NULL for the whole tree.
+ * @param hi: the end of the range (exclusive), ignored if lo is NULL.
+ * @param func: the function to activate on the payloads.
+ * @param args: more optional arguments to the function.
+ * @return: 0 on failure, other on success.
+ */
+int forEachMappedRBTree(const MappedRBTree *mapped, const void *lo, const void *hi, forEachFunc func, void *args)
+{
+    if (mapped == NULL || func == NULL || (lo != NULL && hi == NULL))
+    {
+        return FAILURE;
+    }
+    size_t n = mapped->size;
+    size_t k = lo != NULL ? lowerBoundEntry(mapped, lo) : eytzingerFirst(n);
+    for (; k != 0 && (lo == NULL || mapped->compFunc(payload(mapped, k), hi) < 0); k = eytzingerNext(k, n))
+    {
+        if (func(payload(mapped, k), args) == 0)
+        {
+            return FAILURE;
+        }
+    }
+    return SUCCESS;
+}
+
+/**
+ * unmap the file.
+ * @param mapped: the items to unmap.
+ */
+void freeMappedRBTree(MappedRBTree *mapped)
+{
+    if (mapped == NULL)
+    {
+        return;
+    }
+    munmap((void *) mapped->base, mapped->bytes);
+    free(mapped);
+}
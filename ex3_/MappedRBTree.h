@@ -0,0 +1,130 @@
+#ifndef RBTREE_MAPPEDRBTREE_H
+#define RBTREE_MAPPEDRBTREE_H
+
+#include "RBTree.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * the first bytes of a snapshot file.
+ */
+#define MAPPED_MAGIC "RBTSNAP1"
+
+/**
+ * alignment of the payloads in a snapshot file, so a payload of doubles or pointers sized ints can be read in place.
+ */
+#define MAPPED_ALIGNMENT (8)
+
+/**
+ * a function to write an item to a snapshot. the payload must be an item itself: the CompareFunc of the mapped tree
+ * and the functions passed to its forEachRBTree get pointers to the payloads in the mapped file, so a payload holds no
+ * pointers (e.g. a string with its '\0', or a struct of numbers).
+ * @data: an item of the tree.
+ * @buffer: where to write the payload.
+ * @size: the size of buffer.
+ * @return: the size of the payload. if it is larger than size, nothing was written and the function is called again
+ * with a buffer of that size.
+ */
+typedef size_t (*SerializeFunc)(const void *data, void *buffer, size_t size);
+
+/*
+ * the beginning of a snapshot file. it is followed by the index, uint64_t index[size + 1]: index[k] is the offset
+ * (from the beginning of the file) of the payload of the k-th item in the Eytzinger order of FrozenRBTree, and index[0]
+ * is unused. the payloads follow the index, in an ascending order, each aligned to MAPPED_ALIGNMENT. the file uses
+ * the byte order of the machine that saved it.
+ */
+typedef struct MappedHeader
+{
+	char magic[8];
+	uint64_t size; // number of items
+	uint64_t fileSize; // bytes in the file
+} MappedHeader;
+
+/**
+ * the items of a tree that mapRBTree mapped, in the pages of the snapshot file.
+ */
+typedef struct MappedRBTree
+{
+	const char *base; // the mapped file
+	size_t bytes;
+	const uint64_t *index; // the index of the file
+	CompareFunc compFunc;
+	size_t size;
+} MappedRBTree;
+
+/**
+ * write the items of a tree to a snapshot file, in O(n). the file is written next to path and renamed over it, so
+ * path always holds a complete snapshot. the tree can be of any engine.
+ * @param tree: the tree to save.
+ * @param path: the snapshot file.
+ * @param serialize: writes the payload of an item.
+ * @return: 0 on failure, other on success.
+ */
+int saveRBTree(RBTree *tree, const char *path, SerializeFunc serialize);
+
+/**
+ * open a snapshot file as a read only tree: the file is mapped and the queries read the index and the payloads in
+ * its pages, with no parsing and no allocation per item. opening checks the offsets of the index, in O(n). the tree
+ * supports containsRBTree, findRBTree, lowerBoundRBTree, upperBoundRBTree, floorRBTree, ceilRBTree, forEachRBTree,
+ * forEachRBTreeRange and freeRBTree (which unmaps the file). the items are the payloads in the file, so they are not freed.
+ * @param path: a file written by saveRBTree.
+ * @param compFunc: compares two payloads, in the order of the saved tree.
+ * @return: the new tree, NULL on failure (e.g. the file is missing or isn't a snapshot).
+ */
+RBTree *mapRBTree(const char *path, CompareFunc compFunc);
+
+/**
+ * @param mapped: the items to search.
+ * @param data: item to compare to.
+ * @return: the payload that is equal to data, NULL if there is none.
+ */
+void *findMappedRBTree(const MappedRBTree *mapped, const void *data);
+
+/**
+ * @param mapped: the items to search.
+ * @param data: item to compare to.
+ * @return: the smallest payload that is not lower than data, NULL if there is none.
+ */
+void *lowerBoundMappedRBTree(const MappedRBTree *mapped, const void *data);
+
+/**
+ * @param mapped: the items to search.
+ * @param data: item to compare to.
+ * @return: the smallest payload that is greater than data, NULL if there is none.
+ */
+void *upperBoundMappedRBTree(const MappedRBTree *mapped, const void *data);
+
+/**
+ * @param mapped: the items to search.
+ * @param data: item to compare to.
+ * @return: the largest payload that is lower than or equal to data, NULL if there is none.
+ */
+void *floorMappedRBTree(const MappedRBTree *mapped, const void *data);
+
+/**
+ * Activate a function on each payload in the range [lo, hi) (on all of them if lo is NULL), in an ascending order. if
+ * one of the activations of the function returns 0, the process stops.
+ * @param mapped: the items.
+ * @param lo: lowest item of the range (inclusive), NULL for the whole tree.
+ * @param hi: the end of the range (exclusive), ignored if lo is NULL.
+ * @param func: the function to activate on the payloads.
+ * @param args: more optional arguments to the function.
+ * @return: 0 on failure, other on success.
+ */
+int forEachMappedRBTree(const MappedRBTree *mapped, const void *lo, const void *hi, forEachFunc func, void *args);
+
+/**
+ * unmap the file.
+ * @param mapped: the items to unmap.
+ */
+void freeMappedRBTree(MappedRBTree *mapped);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //RBTREE_MAPPEDRBTREE_H
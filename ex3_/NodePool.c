@@ -0,0 +1,203 @@
+#define _GNU_SOURCE
+
+#include "NodePool.h"
+#include <stdlib.h>
+#include <stdint.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#define ALIGNMENT (sizeof(void *))
+#define SLAB_HEADER_SIZE ((sizeof(Slab) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT)
+
+/**
+ * @param size
+ * @return size rounded up to the alignment of the pool.
+ */
+static size_t alignUp(size_t size)
+{
+    return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+#ifdef __linux__
+
+/**
+ * maps a slab aligned to its size, and asks the kernel to back it with huge pages.
+ * @param bytes the size of the slab
+ * @return the slab memory, NULL on failure.
+ */
+static void *mapSlab(size_t bytes)
+{
+    // map twice the size so an aligned window can be cut out of it.
+    char *raw = mmap(NULL, bytes * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED)
+    {
+        return NULL;
+    }
+    char *aligned = (char *) (((uintptr_t) raw + bytes - 1) & ~((uintptr_t) bytes - 1));
+    if (aligned != raw)
+    {
+        munmap(raw, aligned - raw);
+    }
+    munmap(aligned + bytes, raw + bytes * 2 - (aligned + bytes));
+#ifdef MADV_HUGEPAGE
+    madvise(aligned, bytes, MADV_HUGEPAGE);
+#endif
+    return aligned;
+}
+
+#endif
+
+/**
+ * allocates a new slab and makes it the current one.
+ * @param pool
+ * @return 1 if success 0 else
+ */
+static int addSlab(NodePool *pool)
+{
+    size_t bytes = NODE_POOL_SLAB_SIZE;
+    Slab *slab = NULL;
+    int mapped = 0;
+#ifdef __linux__
+    slab = mapSlab(bytes);
+    mapped = slab != NULL;
+#endif
+    if (slab == NULL)
+    {
+        slab = malloc(bytes);
+        if (slab == NULL)
+        {
+            return 0;
+        }
+    }
+    slab->next = pool->slabs;
+    slab->bytes = bytes;
+    slab->end = (char *) slab + SLAB_HEADER_SIZE;
+    slab->mapped = mapped;
+    pool->slabs = slab;
+    return 1;
+}
+
+/**
+ * releases the memory of a single slab.
+ * @param slab
+ */
+static void releaseSlab(Slab *slab)
+{
+#ifdef __linux__
+    if (slab->mapped)
+    {
+        munmap(slab, slab->bytes);
+        return;
+    }
+#endif
+    free(slab);
+}
+
+/**
+ * constructs a new pool of objects of the given size.
+ * @param objectSize: size of a single object in bytes.
+ * @return: the new pool, NULL on failure.
+ */
+NodePool *newNodePool(size_t objectSize)
+{
+    if (objectSize == 0 || alignUp(objectSize) > NODE_POOL_SLAB_SIZE - SLAB_HEADER_SIZE)
+    {
+        return NULL;
+    }
+    NodePool *pool = malloc(sizeof(NodePool));
+    if (pool == NULL)
+    {
+        return NULL;
+    }
+    pool->objectSize = alignUp(objectSize < sizeof(FreeObject) ? sizeof(FreeObject) : objectSize);
+    pool->slabs = NULL;
+    pool->freeList = NULL;
+    pool->liveObjects = 0;
+    return pool;
+}
+
+/**
+ * allocate an object from the pool. freed objects are reused before a new slab is allocated.
+ * @param pool: the pool to allocate from.
+ * @return: pointer to an uninitialized object, NULL on failure.
+ */
+void *allocFromNodePool(NodePool *pool)
+{
+    if (pool->freeList != NULL)
+    {
+        FreeObject *object = pool->freeList;
+        pool->freeList = object->next;
+        pool->liveObjects++;
+        return object;
+    }
+    Slab *slab = pool->slabs;
+    if (slab == NULL || slab->end + pool->objectSize > (char *) slab + slab->bytes)
+    {
+        if (!addSlab(pool))
+        {
+            return NULL;
+        }
+        slab = pool->slabs;
+    }
+    void *object = slab->end;
+    slab->end += pool->objectSize;
+    pool->liveObjects++;
+    return object;
+}
+
+/**
+ * return an object to the pool. the first sizeof(void *) bytes of the object are overwritten.
+ * @param pool: the pool the object was allocated from.
+ * @param object: the object to return.
+ */
+void freeToNodePool(NodePool *pool, void *object)
+{
+    if (object == NULL)
+    {
+        return;
+    }
+    FreeObject *freeObject = object;
+    freeObject->next = pool->freeList;
+    pool->freeList = freeObject;
+    pool->liveObjects--;
+}
+
+/**
+ * activate a function on every object carved from the pool so far, slab by slab, including objects that were
+ * returned to the pool. the caller is responsible for telling live objects from free ones.
+ * @param pool: the pool.
+ * @param func: the function to activate.
+ * @param args: more optional arguments to the function.
+ */
+void forEachNodePool(NodePool *pool, PoolVisitFunc func, void *args)
+{
+    for (Slab *slab = pool->slabs; slab != NULL; slab = slab->next)
+    {
+        for (char *object = (char *) slab + SLAB_HEADER_SIZE; object < slab->end; object += pool->objectSize)
+        {
+            func(object, args);
+        }
+    }
+}
+
+/**
+ * free the pool and all of its slabs at once.
+ * @param pool: the pool to free.
+ */
+void freeNodePool(NodePool *pool)
+{
+    if (pool == NULL)
+    {
+        return;
+    }
+    Slab *slab = pool->slabs;
+    while (slab != NULL)
+    {
+        Slab *next = slab->next;
+        releaseSlab(slab);
+        slab = next;
+    }
+    free(pool);
+}
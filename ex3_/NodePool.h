@@ -0,0 +1,92 @@
+#ifndef RBTREE_NODEPOOL_H
+#define RBTREE_NODEPOOL_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * size of a single slab. chosen to match the x86-64 huge page size so a slab can be backed by one huge page.
+ */
+#define NODE_POOL_SLAB_SIZE ((size_t) 2 * 1024 * 1024)
+
+/**
+ * a function to apply on every object that was ever handed out by the pool.
+ * @object: a pointer to the object.
+ * @args: pointer to other arguments for the function.
+ */
+typedef void (*PoolVisitFunc)(void *object, void *args);
+
+/*
+ * a free object. the link is stored inside the object itself, so freed objects cost no extra memory.
+ */
+typedef struct FreeObject
+{
+	struct FreeObject *next;
+} FreeObject;
+
+/*
+ * a chunk of memory objects are carved from. the header is stored at the beginning of the chunk.
+ */
+typedef struct Slab
+{
+	struct Slab *next;
+	size_t bytes;
+	char *end; // end of the carved part of the slab
+	int mapped; // 1 if the slab was allocated with mmap, 0 if with malloc
+} Slab;
+
+/**
+ * a pool of fixed size objects.
+ */
+typedef struct NodePool
+{
+	size_t objectSize;
+	Slab *slabs; // the first slab is the one objects are currently carved from
+	FreeObject *freeList;
+	size_t liveObjects;
+} NodePool;
+
+/**
+ * constructs a new pool of objects of the given size.
+ * @param objectSize: size of a single object in bytes.
+ * @return: the new pool, NULL on failure.
+ */
+NodePool *newNodePool(size_t objectSize);
+
+/**
+ * allocate an object from the pool. freed objects are reused before a new slab is allocated.
+ * @param pool: the pool to allocate from.
+ * @return: pointer to an uninitialized object, NULL on failure.
+ */
+void *allocFromNodePool(NodePool *pool);
+
+/**
+ * return an object to the pool. the first sizeof(void *) bytes of the object are overwritten.
+ * @param pool: the pool the object was allocated from.
+ * @param object: the object to return.
+ */
+void freeToNodePool(NodePool *pool, void *object);
+
+/**
+ * activate a function on every object carved from the pool so far, slab by slab, including objects that were
+ * returned to the pool. the caller is responsible for telling live objects from free ones.
+ * @param pool: the pool.
+ * @param func: the function to activate.
+ * @param args: more optional arguments to the function.
+ */
+void forEachNodePool(NodePool *pool, PoolVisitFunc func, void *args);
+
+/**
+ * free the pool and all of its slabs at once.
+ * @param pool: the pool to free.
+ */
+void freeNodePool(NodePool *pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //RBTREE_NODEPOOL_H
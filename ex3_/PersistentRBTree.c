@@ -0,0 +1,428 @@
+#include "PersistentRBTree.h"
+#include <stdlib.h>
+
+#define SUCCESS (1)
+#define FAILURE (0)
+
+/**
+ * constructs a new empty persistent tree.
+ * @param compFunc: a function two compare two variables.
+ * @param freeFunc: a function to free a data item.
+ * @return: the new tree, NULL on failure.
+ */
+PersistentRBTree *newPersistentRBTree(CompareFunc compFunc, FreeFunc freeFunc)
+{
+    if (compFunc == NULL || freeFunc == NULL)
+    {
+        return NULL;
+    }
+    PersistentRBTree *tree = malloc(sizeof(PersistentRBTree));
+    if (tree == NULL)
+    {
+        return NULL;
+    }
+    tree->root = NULL;
+    tree->compFunc = compFunc;
+    tree->freeFunc = freeFunc;
+    tree->size = 0;
+    tree->spareCount = 0;
+    return tree;
+}
+
+/**
+ * adds a reference to a node.
+ * @param node may be NULL
+ */
+static void retainNode(PersistentNode *node)
+{
+    if (node != NULL)
+    {
+        __atomic_add_fetch(&node->refCount, 1, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * drops a reference to a node, and frees it (and the children only it referenced) if it was the last one.
+ * @param node may be NULL
+ */
+static void releaseNode(PersistentNode *node)
+{
+    if (node != NULL && __atomic_sub_fetch(&node->refCount, 1, __ATOMIC_ACQ_REL) == 0)
+    {
+        releaseNode(node->left);
+        releaseNode(node->right);
+        free(node);
+    }
+}
+
+/**
+ * @param node
+ * @return 1 if the node belongs to a single version and may be changed in place, 0 else
+ */
+static int isExclusive(PersistentNode *node)
+{
+    return __atomic_load_n(&node->refCount, __ATOMIC_ACQUIRE) == 1;
+}
+
+/**
+ * replaces the reference *slot holds to a shared node with a private copy of it. the copy takes a reference to each
+ * child, and the original loses the reference of *slot.
+ * @param slot the root or the child pointer of an exclusive node
+ * @param copy memory for the copy
+ * @return the copy
+ */
+static PersistentNode *copyNode(PersistentNode **slot, PersistentNode *copy)
+{
+    PersistentNode *node = *slot;
+    *copy = *node;
+    copy->refCount = 1;
+    retainNode(copy->left);
+    retainNode(copy->right);
+    *slot = copy;
+    releaseNode(node);
+    return copy;
+}
+
+/**
+ * @param node
+ * @return 1 if the node is red (NULL leaves are black), 0 else
+ */
+static int isRed(const PersistentNode *node)
+{
+    return node != NULL && node->color == RED;
+}
+
+/**
+ * rotates the subtree of g to the left. both nodes must be exclusive. the moved subtree keeps its single parent
+ * reference, so no count changes.
+ * @param g
+ * @return the new root of the subtree
+ */
+static PersistentNode *rotateLeft(PersistentNode *g)
+{
+    PersistentNode *p = g->right;
+    g->right = p->left;
+    p->left = g;
+    return p;
+}
+
+/**
+ * rotates the subtree of g to the right. both nodes must be exclusive.
+ * @param g
+ * @return the new root of the subtree
+ */
+static PersistentNode *rotateRight(PersistentNode *g)
+{
+    PersistentNode *p = g->left;
+    g->left = p->right;
+    p->right = g;
+    return p;
+}
+
+/**
+ * hangs a subtree in the place of path[depth] (under path[depth - 1], or as the root of the tree).
+ * @param tree
+ * @param path
+ * @param depth
+ * @param subtree
+ */
+static void replaceOnPath(PersistentRBTree *tree, PersistentNode **path, int depth, PersistentNode *subtree)
+{
+    if (depth == 0)
+    {
+        tree->root = subtree;
+    }
+    else if (path[depth - 1]->left == path[depth])
+    {
+        path[depth - 1]->left = subtree;
+    }
+    else
+    {
+        path[depth - 1]->right = subtree;
+    }
+}
+
+/**
+ * fixes the tree after a red node was inserted at path[depth], like fixTree of RBTree.c. the path is exclusive,
+ * and a red uncle that is shared is copied (into a spare node) before it is recolored.
+ * @param tree
+ * @param path the exclusive path from the root to the new node
+ * @param depth
+ */
+static void fixPath(PersistentRBTree *tree, PersistentNode **path, int depth)
+{
+    while (depth >= 2 && isRed(path[depth - 1]))
+    {
+        PersistentNode *node = path[depth], *parent = path[depth - 1], *grandparent = path[depth - 2];
+        int parentIsLeft = grandparent->left == parent;
+        PersistentNode **uncle = parentIsLeft ? &grandparent->right : &grandparent->left;
+        if (isRed(*uncle))
+        {
+            if (!isExclusive(*uncle))
+            {
+                copyNode(uncle, tree->spareNodes[--tree->spareCount]);
+            }
+            (*uncle)->color = BLACK;
+            parent->color = BLACK;
+            grandparent->color = RED;
+            depth -= 2;
+            continue;
+        }
+        if (parentIsLeft)
+        {
+            if (parent->right == node)
+            {
+                grandparent->left = rotateLeft(parent);
+                parent = node;
+            }
+            replaceOnPath(tree, path, depth - 2, rotateRight(grandparent));
+        }
+        else
+        {
+            if (parent->left == node)
+            {
+                grandparent->right = rotateRight(parent);
+                parent = node;
+            }
+            replaceOnPath(tree, path, depth - 2, rotateLeft(grandparent));
+        }
+        parent->color = BLACK;
+        grandparent->color = RED;
+        break;
+    }
+    tree->root->color = BLACK;
+}
+
+/**
+ * @param root
+ * @param compFunc
+ * @param data
+ * @return 1 if the subtree of root contains data, 0 else
+ */
+static int containsSubtree(const PersistentNode *root, CompareFunc compFunc, const void *data)
+{
+    while (root != NULL)
+    {
+        int comp = compFunc(root->data, data);
+        if (comp == 0)
+        {
+            return SUCCESS;
+        }
+        root = comp > 0 ? root->left : root->right;
+    }
+    return FAILURE;
+}
+
+/**
+ * add an item to the tree. versions held by snapshots are not changed.
+ * @param tree: the tree to add an item to.
+ * @param data: item to add to the tree.
+ * @return: 0 on failure, other on success. (if the item is already in the tree - failure).
+ */
+int addToPersistentRBTree(PersistentRBTree *tree, void *data)
+{
+    if (tree == NULL || data == NULL || containsSubtree(tree->root, tree->compFunc, data))
+    {
+        return FAILURE;
+    }
+
+    // walk down making every node of the path exclusive: the first shared node and everything below it is copied,
+    // nodes that only this version references are changed in place.
+    PersistentNode *path[PERSISTENT_MAX_HEIGHT + 1];
+    PersistentNode **slot = &tree->root;
+    int depth = 0;
+    while (*slot != NULL)
+    {
+        PersistentNode *copy = NULL;
+        if (depth == PERSISTENT_MAX_HEIGHT ||
+            (!isExclusive(*slot) && (copy = malloc(sizeof(PersistentNode))) == NULL))
+        {
+            // the copies made so far are a valid equal version, nothing to undo.
+            return FAILURE;
+        }
+        path[depth] = copy != NULL ? copyNode(slot, copy) : *slot;
+        slot = tree->compFunc(path[depth]->data, data) > 0 ? &path[depth]->left : &path[depth]->right;
+        depth++;
+    }
+
+    // reserve the uncle copies up front, so the insert can't fail after the node was linked.
+    while (tree->spareCount < depth / 2)
+    {
+        PersistentNode *spare = malloc(sizeof(PersistentNode));
+        if (spare == NULL)
+        {
+            return FAILURE;
+        }
+        tree->spareNodes[tree->spareCount++] = spare;
+    }
+    PersistentNode *node = malloc(sizeof(PersistentNode));
+    if (node == NULL)
+    {
+        return FAILURE;
+    }
+    node->left = NULL;
+    node->right = NULL;
+    node->color = RED;
+    node->refCount = 1;
+    node->data = data;
+    *slot = node;
+    path[depth] = node;
+    tree->size++;
+    fixPath(tree, path, depth);
+    return SUCCESS;
+}
+
+/**
+ * check whether the tree contains this item.
+ * @param tree: the tree to search.
+ * @param data: item to check.
+ * @return: 0 if the item is not in the tree, other if it is.
+ */
+int containsPersistentRBTree(const PersistentRBTree *tree, const void *data)
+{
+    if (tree == NULL || data == NULL)
+    {
+        return FAILURE;
+    }
+    return containsSubtree(tree->root, tree->compFunc, data);
+}
+
+/**
+ * activates func on the items of a subtree in an ascending order (the nodes have no parent pointers, since a node
+ * can have a parent in each version, so walk with a stack).
+ * @param root
+ * @param func
+ * @param args
+ * @return 0 on failure, other on success.
+ */
+static int forEachSubtree(const PersistentNode *root, forEachFunc func, void *args)
+{
+    if (root == NULL || func == NULL)
+    {
+        return FAILURE;
+    }
+    const PersistentNode *stack[PERSISTENT_MAX_HEIGHT];
+    int top = 0;
+    const PersistentNode *current = root;
+    while (current != NULL || top > 0)
+    {
+        while (current != NULL)
+        {
+            stack[top++] = current;
+            current = current->left;
+        }
+        current = stack[--top];
+        if (func(current->data, args) == 0)
+        {
+            return FAILURE;
+        }
+        current = current->right;
+    }
+    return SUCCESS;
+}
+
+/**
+ * Activate a function on each item of the tree, in an ascending order. if one of the activations of the function
+ * returns 0, the process stops.
+ * @param tree: the tree with all the items.
+ * @param func: the function to activate on all items.
+ * @param args: more optional arguments to the function.
+ * @return: 0 on failure, other on success.
+ */
+int forEachPersistentRBTree(const PersistentRBTree *tree, forEachFunc func, void *args)
+{
+    return tree != NULL ? forEachSubtree(tree->root, func, args) : FAILURE;
+}
+
+/**
+ * take a snapshot of the current version of the tree, in O(1).
+ * @param tree: the tree to take a snapshot of.
+ * @return: the snapshot. release it with releasePersistentSnapshot.
+ */
+PersistentSnapshot snapshotPersistentRBTree(const PersistentRBTree *tree)
+{
+    PersistentSnapshot snapshot = {NULL, NULL, 0};
+    if (tree != NULL)
+    {
+        snapshot.root = tree->root;
+        snapshot.compFunc = tree->compFunc;
+        snapshot.size = tree->size;
+        retainNode(snapshot.root);
+    }
+    return snapshot;
+}
+
+/**
+ * check whether the snapshot contains this item. a snapshot may be read by another thread than the tree's writer.
+ * @param snapshot: the snapshot to search.
+ * @param data: item to check.
+ * @return: 0 if the item is not in the snapshot, other if it is.
+ */
+int containsPersistentSnapshot(const PersistentSnapshot *snapshot, const void *data)
+{
+    if (snapshot == NULL || data == NULL)
+    {
+        return FAILURE;
+    }
+    return containsSubtree(snapshot->root, snapshot->compFunc, data);
+}
+
+/**
+ * Activate a function on each item of the snapshot, in an ascending order. if one of the activations of the function
+ * returns 0, the process stops.
+ * @param snapshot: the snapshot with all the items.
+ * @param func: the function to activate on all items.
+ * @param args: more optional arguments to the function.
+ * @return: 0 on failure, other on success.
+ */
+int forEachPersistentSnapshot(const PersistentSnapshot *snapshot, forEachFunc func, void *args)
+{
+    return snapshot != NULL ? forEachSubtree(snapshot->root, func, args) : FAILURE;
+}
+
+/**
+ * drop a snapshot, freeing the nodes that no other version shares. the items are not freed (they belong to the
+ * tree, every item of a snapshot is also in the tree).
+ * @param snapshot: the snapshot to release. it is empty afterwards.
+ */
+void releasePersistentSnapshot(PersistentSnapshot *snapshot)
+{
+    if (snapshot == NULL)
+    {
+        return;
+    }
+    releaseNode(snapshot->root);
+    snapshot->root = NULL;
+    snapshot->size = 0;
+}
+
+/**
+ * forEachFunc that frees an item.
+ * @param object
+ * @param args the FreeFunc of the tree
+ * @return 1
+ */
+static int freeItem(const void *object, void *args)
+{
+    (*(FreeFunc *) args)((void *) object);
+    return SUCCESS;
+}
+
+/**
+ * free all memory of the tree, and its items with freeFunc. release all the snapshots of the tree first.
+ * @param tree: the tree to free.
+ */
+void freePersistentRBTree(PersistentRBTree *tree)
+{
+    if (tree == NULL)
+    {
+        return;
+    }
+    forEachSubtree(tree->root, freeItem, &tree->freeFunc);
+    releaseNode(tree->root);
+    for (int i = 0; i < tree->spareCount; ++i)
+    {
+        free(tree->spareNodes[i]);
+    }
+    free(tree);
+}
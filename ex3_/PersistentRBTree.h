@@ -0,0 +1,127 @@
+#ifndef RBTREE_PERSISTENTRBTREE_H
+#define RBTREE_PERSISTENTRBTREE_H
+
+#include "RBTree.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * maximal height of a persistent tree (a red-black tree of less than 2^31 items is at most 62 nodes high).
+ */
+#define PERSISTENT_MAX_HEIGHT (64)
+
+/*
+ * a node of a persistent tree. a node can be shared by several versions of the tree: refCount counts the parents
+ * and handles that point to it, and only a node with refCount 1 may be changed in place.
+ */
+typedef struct PersistentNode
+{
+	struct PersistentNode *left, *right;
+	Color color;
+	int refCount;
+	void *data;
+} PersistentNode;
+
+/**
+ * a tree whose versions share their nodes. addToPersistentRBTree copies only the nodes on its path that are shared
+ * with a snapshot, so taking a snapshot is O(1) and costs nothing until the next inserts.
+ */
+typedef struct PersistentRBTree
+{
+	PersistentNode *root;
+	CompareFunc compFunc;
+	FreeFunc freeFunc;
+	int size;
+	PersistentNode *spareNodes[PERSISTENT_MAX_HEIGHT / 2]; // reserved before an insert, for the uncles it copies
+	int spareCount;
+} PersistentRBTree;
+
+/**
+ * a read only version of a persistent tree, as it was when the snapshot was taken.
+ */
+typedef struct PersistentSnapshot
+{
+	PersistentNode *root;
+	CompareFunc compFunc;
+	int size;
+} PersistentSnapshot;
+
+/**
+ * constructs a new empty persistent tree.
+ * @param compFunc: a function two compare two variables.
+ * @param freeFunc: a function to free a data item.
+ * @return: the new tree, NULL on failure.
+ */
+PersistentRBTree *newPersistentRBTree(CompareFunc compFunc, FreeFunc freeFunc);
+
+/**
+ * add an item to the tree. versions held by snapshots are not changed.
+ * @param tree: the tree to add an item to.
+ * @param data: item to add to the tree.
+ * @return: 0 on failure, other on success. (if the item is already in the tree - failure).
+ */
+int addToPersistentRBTree(PersistentRBTree *tree, void *data);
+
+/**
+ * check whether the tree contains this item.
+ * @param tree: the tree to search.
+ * @param data: item to check.
+ * @return: 0 if the item is not in the tree, other if it is.
+ */
+int containsPersistentRBTree(const PersistentRBTree *tree, const void *data);
+
+/**
+ * Activate a function on each item of the tree, in an ascending order. if one of the activations of the function
+ * returns 0, the process stops.
+ * @param tree: the tree with all the items.
+ * @param func: the function to activate on all items.
+ * @param args: more optional arguments to the function.
+ * @return: 0 on failure, other on success.
+ */
+int forEachPersistentRBTree(const PersistentRBTree *tree, forEachFunc func, void *args);
+
+/**
+ * take a snapshot of the current version of the tree, in O(1).
+ * @param tree: the tree to take a snapshot of.
+ * @return: the snapshot. release it with releasePersistentSnapshot.
+ */
+PersistentSnapshot snapshotPersistentRBTree(const PersistentRBTree *tree);
+
+/**
+ * check whether the snapshot contains this item. a snapshot may be read by another thread than the tree's writer.
+ * @param snapshot: the snapshot to search.
+ * @param data: item to check.
+ * @return: 0 if the item is not in the snapshot, other if it is.
+ */
+int containsPersistentSnapshot(const PersistentSnapshot *snapshot, const void *data);
+
+/**
+ * Activate a function on each item of the snapshot, in an ascending order. if one of the activations of the function
+ * returns 0, the process stops.
+ * @param snapshot: the snapshot with all the items.
+ * @param func: the function to activate on all items.
+ * @param args: more optional arguments to the function.
+ * @return: 0 on failure, other on success.
+ */
+int forEachPersistentSnapshot(const PersistentSnapshot *snapshot, forEachFunc func, void *args);
+
+/**
+ * drop a snapshot, freeing the nodes that no other version shares. the items are not freed (they belong to the
+ * tree, every item of a snapshot is also in the tree).
+ * @param snapshot: the snapshot to release. it is empty afterwards.
+ */
+void releasePersistentSnapshot(PersistentSnapshot *snapshot);
+
+/**
+ * free all memory of the tree, and its items with freeFunc. release all the snapshots of the tree first.
+ * @param tree: the tree to free.
+ */
+void freePersistentRBTree(PersistentRBTree *tree);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //RBTREE_PERSISTENTRBTREE_H
@@ -46,6 +46,18 @@ int productComparatorByName(const void *a, const void *b)
     }
 }
 
+/**
+ * KeyCompareFunc for ProductExample, to look products up by name without building a product
+ * @param key char* name
+ * @param data ProductExample*
+ * @return -1 if key<data's name, 0 if they are equal, 1 if data's name<key
+ */
+int productKeyComparatorByName(const void *key, const void *data)
+{
+    int diff = strcmp((const char *) key, ((const ProductExample *) data)->name);
+    return (diff > 0) - (diff < 0);
+}
+
 void productFree(void *a)
 {
     ProductExample *pProduct = (ProductExample *) a;
@@ -137,7 +149,9 @@ void assertion(int passed, int assertion_num, char *msg)
 int main()
 {
     ProductExample **products = getProducts();
-    RBTree *tree = newRBTree(productComparatorByName, productFree);
+    RBTreeOptions options = {0};
+    options.keyCompFunc = productKeyComparatorByName;
+    RBTree *tree = newRBTreeWithOptions(productComparatorByName, productFree, &options);
     addToRBTree(tree, products[2]);
     addToRBTree(tree, products[3]);
     addToRBTree(tree, products[4]);
@@ -166,6 +180,13 @@ int main()
             }
         }
     }
+    if (!containsKeyRBTree(tree, "iPhone") || findKeyRBTree(tree, "iPad") != products[3] ||
+        containsKeyRBTree(tree, "Apple TV"))
+    {
+        printf("Lookup by name failed, aborting");
+        freeResources(tree, &products);
+        return 3;
+    }
     printf("\nThe number of products in the tree is %d.\n\n", tree->size);
     forEachRBTree(tree, printProduct, NULL);
     freeResources(tree, &products);
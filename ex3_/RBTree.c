@@ -1,13 +1,33 @@
 #include <stdio.h>
 #include "RBTree.h"
 #include "Structs.h"
+#include "NodePool.h"
+#include "BPlusTree.h"
+#include "CompactRBTree.h"
+#include "ThreadPool.h"
+#include "BloomFilter.h"
+#include "MappedRBTree.h"
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 
 #define SUCCESS (1)
 #define FAILURE (0)
 #define LESS (-1)
 #define EQUAL (0)
 #define GREATER (1)
+#define PARALLEL_BUILD_THRESHOLD (1 << 14)
+#define PARALLEL_TASKS_PER_THREAD (8)
+
+// the counters of RBTreeStats. without RBTREE_STATS they compile to nothing. they are atomic since the parallel build
+// allocates nodes on several threads.
+#ifdef RBTREE_STATS
+#define COUNT_STAT(tree, counter, amount) __atomic_add_fetch(&(tree)->stats.counter, (amount), __ATOMIC_RELAXED)
+#define COUNT_DESCENT(tree, depth) countDescent(tree, depth)
+#else
+#define COUNT_STAT(tree, counter, amount) ((void) 0)
+#define COUNT_DESCENT(tree, depth) ((void) (depth))
+#endif
 
 /**
  * @param node
@@ -23,6 +43,18 @@ static int isLeftSon(Node *node)
  * comp: a function two compare two variables.
  */
 RBTree *newRBTree(CompareFunc compFunc, FreeFunc freeFunc)
+{
+    return newRBTreeWithOptions(compFunc, freeFunc, NULL);
+}
+
+/**
+ * constructs a new RBTree with the given CompareFunc and optional features.
+ * @param compFunc: a function two compare two variables.
+ * @param freeFunc: a function to free a data item.
+ * @param options: the features to enable, may be NULL.
+ * @return: the new tree, NULL on failure.
+ */
+RBTree *newRBTreeWithOptions(CompareFunc compFunc, FreeFunc freeFunc, const RBTreeOptions *options)
 {
     if (compFunc == NULL || freeFunc == NULL)
     {
@@ -30,14 +62,210 @@ RBTree *newRBTree(CompareFunc compFunc, FreeFunc freeFunc)
     }
 
     RBTree *rbTree = malloc(sizeof(RBTree));
+    if (rbTree == NULL)
+    {
+        return NULL;
+    }
     rbTree->compFunc = compFunc;
     rbTree->freeFunc = freeFunc;
     rbTree->root = NULL;
+    rbTree->first = NULL;
+    rbTree->last = NULL;
     rbTree->size = 0;
+    rbTree->pool = NULL;
+    rbTree->freeNodes = NULL;
+    rbTree->orderStatistics = options != NULL && options->orderStatistics;
+    rbTree->bplus = NULL;
+    rbTree->compact = NULL;
+    rbTree->mapped = NULL;
+    rbTree->keyCompFunc = options != NULL ? options->keyCompFunc : NULL;
+    rbTree->prefixFunc = options != NULL ? options->prefixFunc : NULL;
+    rbTree->nodeSize = (int) sizeof(Node) + (rbTree->prefixFunc != NULL ? (int) sizeof(uint64_t) : 0);
+    RBTreeAggregate noAggregate = {0, NULL, NULL};
+    rbTree->aggregate = options != NULL && options->aggregate != NULL ? *options->aggregate : noAggregate;
+    rbTree->aggregateOffset = rbTree->nodeSize;
+    // the aggregates are kept in 8 byte words, so a value of doubles or pointers is aligned.
+    rbTree->nodeSize += (int) ((rbTree->aggregate.size + sizeof(uint64_t) - 1) / sizeof(uint64_t) * sizeof(uint64_t));
+    rbTree->hashFunc = options != NULL ? options->hashFunc : NULL;
+    rbTree->bloom = NULL;
+    resetRBTreeStats(rbTree);
+    if (rbTree->aggregate.size != 0 && (rbTree->aggregate.size > RBTREE_MAX_AGGREGATE_SIZE ||
+                                        rbTree->aggregate.value == NULL || rbTree->aggregate.combine == NULL))
+    {
+        free(rbTree);
+        return NULL;
+    }
+    if (rbTree->hashFunc != NULL)
+    {
+        rbTree->bloom = newBloomFilter(options->expectedSize);
+        if (rbTree->bloom == NULL)
+        {
+            free(rbTree);
+            return NULL;
+        }
+    }
+
+    if (options != NULL && options->engine == BPLUS_ENGINE)
+    {
+        // the node features belong to the red-black engine.
+        rbTree->bplus = options->usePool || options->orderStatistics || options->prefixFunc != NULL ||
+                        rbTree->aggregate.size != 0
+                        ? NULL : newBPlusTree(compFunc);
+        if (rbTree->bplus == NULL)
+        {
+            freeBloomFilter(rbTree->bloom);
+            free(rbTree);
+            return NULL;
+        }
+        return rbTree;
+    }
+    if (options != NULL && options->engine == COMPACT_ENGINE)
+    {
+        // the nodes live in the arena of the compact tree, so there is nothing to pool or count.
+        rbTree->compact = options->usePool || options->orderStatistics || options->prefixFunc != NULL ||
+                          rbTree->aggregate.size != 0
+                          ? NULL : newCompactRBTree(compFunc);
+        if (rbTree->compact == NULL)
+        {
+            freeBloomFilter(rbTree->bloom);
+            free(rbTree);
+            return NULL;
+        }
+        return rbTree;
+    }
+
+    if (options != NULL && options->usePool)
+    {
+        rbTree->pool = newNodePool((size_t) rbTree->nodeSize);
+        if (rbTree->pool == NULL)
+        {
+            freeBloomFilter(rbTree->bloom);
+            free(rbTree);
+            return NULL;
+        }
+    }
 
     return rbTree;
 }
 
+/**
+ * @param node a node of a tree with a PrefixFunc
+ * @return the prefix of the node's item, kept right after the node
+ */
+static inline uint64_t *nodePrefix(const Node *node)
+{
+    return (uint64_t *) ((char *) node + sizeof(Node));
+}
+
+/**
+ * @param tree a tree with an aggregate
+ * @param node
+ * @return the aggregate of the node's subtree, kept after the node and its prefix
+ */
+static inline void *nodeAggregate(const RBTree *tree, const Node *node)
+{
+    return (char *) node + tree->aggregateOffset;
+}
+
+/**
+ * @param tree
+ * @param data
+ * @return the prefix of data, 0 if the tree has no PrefixFunc
+ */
+static inline uint64_t itemPrefix(const RBTree *tree, const void *data)
+{
+    return tree->prefixFunc != NULL ? tree->prefixFunc(data) : 0;
+}
+
+/**
+ * compares the item of a node to data like compFunc(node->data, data), deciding by the prefixes when the tree keeps
+ * them and they differ.
+ * @param tree
+ * @param node
+ * @param data
+ * @param prefix itemPrefix(tree, data)
+ * @return equal to 0 iff the items are equal, lower than 0 if the item of node is lower, greater than 0 else
+ */
+static inline int compareToNode(const RBTree *tree, const Node *node, const void *data, uint64_t prefix)
+{
+    if (tree->prefixFunc != NULL && *nodePrefix(node) != prefix)
+    {
+        return *nodePrefix(node) < prefix ? LESS : GREATER;
+    }
+    return tree->compFunc(node->data, data);
+}
+
+/**
+ * allocates a new red node holding the given data.
+ * @param tree
+ * @param data
+ * @return the node, NULL on failure.
+ */
+static Node *allocateNode(RBTree *tree, void *data)
+{
+    Node *node = tree->freeNodes;
+    if (node != NULL)
+    {
+        tree->freeNodes = node->parent;
+    }
+    else
+    {
+        node = tree->pool != NULL ? allocFromNodePool(tree->pool) : malloc((size_t) tree->nodeSize);
+        COUNT_STAT(tree, allocations, 1);
+    }
+    if (node == NULL)
+    {
+        return NULL;
+    }
+    node->data = data;
+    if (tree->prefixFunc != NULL)
+    {
+        *nodePrefix(node) = tree->prefixFunc(data);
+    }
+    if (tree->aggregate.size != 0)
+    {
+        tree->aggregate.value(data, nodeAggregate(tree, node));
+    }
+    node->color = RED;
+    node->count = 1;
+    node->right = NULL;
+    node->left = NULL;
+    node->parent = NULL;
+    return node;
+}
+
+/**
+ * keeps a removed node for reuse. its data is cleared so a pool walk recognizes it as free.
+ * @param tree
+ * @param node
+ */
+static void releaseNode(RBTree *tree, Node *node)
+{
+    node->data = NULL;
+    node->left = NULL;
+    node->right = NULL;
+    node->parent = tree->freeNodes;
+    tree->freeNodes = node;
+}
+
+/**
+ * finds the nodes of the smallest and the largest items again, after the tree was rebuilt.
+ * @param tree
+ */
+static void findEnds(RBTree *tree)
+{
+    tree->first = tree->root;
+    tree->last = tree->root;
+    while (tree->first != NULL && tree->first->left != NULL)
+    {
+        tree->first = tree->first->left;
+    }
+    while (tree->last != NULL && tree->last->right != NULL)
+    {
+        tree->last = tree->last->right;
+    }
+}
+
 /**
  * checks if the given node is left son of right son
  * @param node
@@ -74,14 +302,72 @@ static int isRightSonOfRightSon(Node *node)
     return !isLeftSon(node) && !isLeftSon(node->parent);
 }
 
+/**
+ * @param tree
+ * @return 1 if the nodes keep something about their subtrees (the size or the aggregate), 0 else
+ */
+static inline int isAugmented(const RBTree *tree)
+{
+    return tree->orderStatistics || tree->aggregate.size != 0;
+}
+
+/**
+ * recomputes the subtree size and the aggregate of a node from its children: the aggregate is the one of the left
+ * child, combined with the value of the node's item and then with the aggregate of the right child.
+ * @param tree
+ * @param node
+ */
+static void updateNode(const RBTree *tree, Node *node)
+{
+    node->count = 1 + (node->left != NULL ? node->left->count : 0) + (node->right != NULL ? node->right->count : 0);
+    if (tree->aggregate.size == 0)
+    {
+        return;
+    }
+    void *aggregate = nodeAggregate(tree, node);
+    if (node->left != NULL)
+    {
+        uint64_t value[RBTREE_MAX_AGGREGATE_SIZE / sizeof(uint64_t)];
+        tree->aggregate.value(node->data, value);
+        memcpy(aggregate, nodeAggregate(tree, node->left), tree->aggregate.size);
+        tree->aggregate.combine(aggregate, value);
+    }
+    else
+    {
+        tree->aggregate.value(node->data, aggregate);
+    }
+    if (node->right != NULL)
+    {
+        tree->aggregate.combine(aggregate, nodeAggregate(tree, node->right));
+    }
+}
+
+/**
+ * recomputes the subtree sizes and aggregates from the given node up to the root, for trees that keep them.
+ * @param tree
+ * @param node may be NULL
+ */
+static void updateNodesToRoot(const RBTree *tree, Node *node)
+{
+    if (!isAugmented(tree))
+    {
+        return;
+    }
+    for (; node != NULL; node = node->parent)
+    {
+        updateNode(tree, node);
+    }
+}
+
 /**
  * rotates the tree to the left (where g is the root of the subtree)
+ * @param tree
  * @param g
  * @return 1 if success 0 else
  */
-static int rotateRight(Node *g)
+static int rotateRight(RBTree *tree, Node *g)
 {
-
+    COUNT_STAT(tree, rotations, 1);
     Node *p = g->left;
 
     // handle p:
@@ -106,16 +392,23 @@ static int rotateRight(Node *g)
     // handle g:
     g->parent = p;
 
+    if (isAugmented(tree))
+    {
+        updateNode(tree, g);
+        updateNode(tree, p);
+    }
     return SUCCESS;
 }
 
 /**
  * rotates the tree to the right (where g is the root of the subtree)
+ * @param tree
  * @param g
  * @return 1 if success 0 else
  */
-static int rotateLeft(Node *g)
+static int rotateLeft(RBTree *tree, Node *g)
 {
+    COUNT_STAT(tree, rotations, 1);
     Node *p = g->right;
 
     // handle p:
@@ -140,16 +433,23 @@ static int rotateLeft(Node *g)
     // handle g:
     g->parent = p;
 
+    if (isAugmented(tree))
+    {
+        updateNode(tree, g);
+        updateNode(tree, p);
+    }
     return SUCCESS;
 }
 
 /**
  * where x is right son of left son, this function will replace places so x and p will be left sons.
+ * @param tree
  * @param x
  * @return 1 if success 0 else
  */
-static int stringItLeft(Node *x)
+static int stringItLeft(RBTree *tree, Node *x)
 {
+    COUNT_STAT(tree, doubleRotations, 1);
     Node *p = x->parent;
     Node *g = p->parent;
     // handle g
@@ -164,16 +464,23 @@ static int stringItLeft(Node *x)
     // handle x
     x->parent = g;
     x->left = p;
+    if (isAugmented(tree))
+    {
+        updateNode(tree, p);
+        updateNode(tree, x);
+    }
     return SUCCESS;
 }
 
 /**
  * where x is left son of right son, this function will replace places so x and p will be right sons.
+ * @param tree
  * @param x
  * @return 1 if success 0 else
  */
-static int stringItRight(Node *x)
+static int stringItRight(RBTree *tree, Node *x)
 {
+    COUNT_STAT(tree, doubleRotations, 1);
     Node *p = x->parent;
     Node *g = p->parent;
     // handle g
@@ -188,11 +495,17 @@ static int stringItRight(Node *x)
     // handle x
     x->parent = g;
     x->right = p;
+    if (isAugmented(tree))
+    {
+        updateNode(tree, p);
+        updateNode(tree, x);
+    }
     return SUCCESS;
 }
 
 /**
- * when the uncle of a new node is black, this function will fix the tree
+ * when the uncle of a new node is black, this function will fix the tree. the root of the tree isn't updated: if the
+ * rotation was at the root, the root's parent is the new root.
  * @param newNode
  * @param tree
  * @return 1 if success, 0 else
@@ -204,15 +517,11 @@ static int blackUncle(Node *newNode, RBTree *tree)
         Node *oldG = newNode->parent->parent;
         if (isRightSonOfRightSon(newNode))
         {
-            rotateLeft(oldG);
+            rotateLeft(tree, oldG);
         }
         else
         {
-            rotateRight(oldG);
-        }
-        if (newNode->parent->parent == NULL) // new node parent might be current root
-        {
-            tree->root = newNode->parent;
+            rotateRight(tree, oldG);
         }
         newNode->parent->color = BLACK;
         oldG->color = RED;
@@ -220,12 +529,12 @@ static int blackUncle(Node *newNode, RBTree *tree)
     }
     else if (isRightSonOfLeftSon(newNode))
     {
-        stringItLeft(newNode);
+        stringItLeft(tree, newNode);
         return blackUncle(newNode->left, tree);
     }
     else if (isLeftSonOfRightSon(newNode))
     {
-        stringItRight(newNode);
+        stringItRight(tree, newNode);
         return blackUncle(newNode->right, tree);
     }
     return SUCCESS;
@@ -269,6 +578,7 @@ static int fixTree(RBTree *tree, Node *newNode)
     }
     else if ((uncle = findUncle(newNode)) != NULL && uncle->color == RED)
     {
+        COUNT_STAT(tree, recolorings, 1);
         uncle->color = BLACK;
         newNode->parent->color = BLACK;
         newNode->parent->parent->color = RED;
@@ -276,157 +586,2786 @@ static int fixTree(RBTree *tree, Node *newNode)
     } // parent is red, check if uncle is read too
     else
     { // parent is red, uncle is black
-        return blackUncle(newNode, tree);
+        blackUncle(newNode, tree);
+        if (tree->root->parent != NULL) // the rotation was at the root
+        {
+            tree->root = tree->root->parent;
+        }
+        return SUCCESS;
     }
 }
 
+#ifdef RBTREE_STATS
 /**
- * add an item to the tree
- * @param tree: the tree to add an item to.
- * @param data: item to add to the tree.
- * @return: 0 on failure, other on success. (if the item is already in the tree - failure).
+ * counts an insert descent that compared depth items.
+ * @param tree
+ * @param depth
  */
-int addToRBTree(RBTree *tree, void *data)
+static void countDescent(RBTree *tree, int depth)
 {
-    if (tree == NULL || data == NULL)
+    COUNT_STAT(tree, descents, 1);
+    COUNT_STAT(tree, comparisons, depth);
+    COUNT_STAT(tree, depthHistogram[depth < RBTREE_STATS_DEPTHS ? depth : RBTREE_STATS_DEPTHS - 1], 1);
+}
+#endif
+
+/**
+ * forEachFunc that adds an item to the Bloom filter of a tree.
+ * @param object
+ * @param args the tree
+ * @return 1
+ */
+static int addItemToBloom(const void *object, void *args)
+{
+    RBTree *tree = (RBTree *) args;
+    addToBloomFilter(tree->bloom, tree->hashFunc(object));
+    return SUCCESS;
+}
+
+/**
+ * adds an item that was just added to the tree to its Bloom filter. a filter that was filled with as many items as
+ * it was sized for is replaced by one twice as large as the tree, filled with the items of the tree (so it also
+ * forgets the removed ones).
+ * @param tree
+ * @param data
+ */
+static void addToBloom(RBTree *tree, const void *data)
+{
+    if (tree->bloom == NULL)
     {
-        return FAILURE;
+        return;
+    }
+    BloomFilter *grown = tree->bloom->items >= tree->bloom->capacity ? newBloomFilter(2 * tree->size) : NULL;
+    if (grown == NULL)
+    {
+        addToBloomFilter(tree->bloom, tree->hashFunc(data));
+        return;
     }
+    freeBloomFilter(tree->bloom);
+    tree->bloom = grown;
+    forEachRBTree(tree, addItemToBloom, tree);
+}
 
-    Node *node = malloc(sizeof(Node));
-    node->data = data;
-    node->color = RED;
-    node->right = NULL;
-    node->left = NULL;
-    node->parent = NULL;
+/**
+ * adds the items of nodes that were just linked into the tree to its Bloom filter. the size is checked once for the
+ * whole batch: if the batch doesn't fit, the filter is replaced by one twice as large as the tree, filled with the
+ * items of the tree (which already holds the batch).
+ * @param tree
+ * @param nodes
+ * @param count
+ */
+static void addNodesToBloom(RBTree *tree, Node **nodes, int count)
+{
+    if (tree->bloom == NULL || count == 0)
+    {
+        return;
+    }
+    BloomFilter *grown = tree->bloom->items + count > tree->bloom->capacity ? newBloomFilter(2 * tree->size) : NULL;
+    if (grown != NULL)
+    {
+        freeBloomFilter(tree->bloom);
+        tree->bloom = grown;
+        forEachRBTree(tree, addItemToBloom, tree);
+        return;
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        addToBloomFilter(tree->bloom, tree->hashFunc(nodes[i]->data));
+    }
+}
 
-    if (tree->root == NULL)
+/**
+ * links a new node for data as a child of parent, and fixes the tree.
+ * @param tree
+ * @param data
+ * @param parent a node whose child on the side of data is free, NULL if the tree is empty
+ * @param left 1 to link the node as the left child of parent, 0 as the right one
+ * @param inserted set to 1 if the node was linked
+ * @return the new node, NULL on failure
+ */
+static Node *linkNewNode(RBTree *tree, void *data, Node *parent, int left, int *inserted)
+{
+    Node *node = allocateNode(tree, data);
+    if (node == NULL)
+    {
+        return NULL;
+    }
+    node->parent = parent;
+    if (parent == NULL)
     {
         tree->root = node;
-        tree->size++;
-        return fixTree(tree, node);
+        tree->first = node;
+        tree->last = node;
+    }
+    else if (left)
+    {
+        parent->left = node;
+        tree->first = parent == tree->first ? node : tree->first;
+    }
+    else
+    {
+        parent->right = node;
+        tree->last = parent == tree->last ? node : tree->last;
     }
+    tree->size++;
+    updateNodesToRoot(tree, parent);
+    fixTree(tree, node);
+    addToBloom(tree, data);
+    *inserted = 1;
+    return node;
+}
 
-    Node *currentNode = tree->root;
-    while (1)
+/**
+ * finds the node of the item equal to data, or inserts a new node for data (and fixes the tree) if there is none,
+ * in one descent. an item past the largest or the smallest item is linked next to it without a descent, so a sorted
+ * stream of inserts compares each item once or twice.
+ * @param tree a red-black engine tree
+ * @param data
+ * @param inserted set to 1 if a new node was inserted, 0 else
+ * @return the node that holds the item equal to data, NULL on failure.
+ */
+static Node *insertOrFindNode(RBTree *tree, void *data, int *inserted)
+{
+    *inserted = 0;
+    uint64_t prefix = itemPrefix(tree, data);
+    int comp = 0;
+    int depth = 0;
+    if (tree->last != NULL)
     {
-        int comp = tree->compFunc(currentNode->data, data);
-        if (comp == 0)
+        comp = compareToNode(tree, tree->last, data, prefix);
+        depth++;
+        if (comp <= 0)
         {
-            free(node);
-            return FAILURE;
+            COUNT_DESCENT(tree, depth);
+            return comp == 0 ? tree->last : linkNewNode(tree, data, tree->last, 0, inserted);
         }
-        else if (comp > 0) // node >= newNode
+        if (tree->first != tree->last)
         {
-
-            if (currentNode->left == NULL)
-            {
-                node->parent = currentNode;
-                currentNode->left = node;
-                break;
-            }
-            else
+            comp = compareToNode(tree, tree->first, data, prefix);
+            depth++;
+            if (comp >= 0)
             {
-                currentNode = currentNode->left;
+                COUNT_DESCENT(tree, depth);
+                return comp == 0 ? tree->first : linkNewNode(tree, data, tree->first, 1, inserted);
             }
         }
-        else
+    }
+
+    // find the parent of the new node first, so duplicates never cost an allocation.
+    Node *parent = NULL;
+    Node *currentNode = tree->root;
+    while (currentNode != NULL)
+    {
+        comp = compareToNode(tree, currentNode, data, prefix);
+        depth++;
+        if (comp == 0)
         {
-            if (currentNode->right == NULL)
-            {
-                node->parent = currentNode;
-                currentNode->right = node;
-                break;
-            }
-            else
-            {
-                currentNode = currentNode->right;
-            }
+            COUNT_DESCENT(tree, depth);
+            return currentNode;
         }
+        parent = currentNode;
+        currentNode = comp > 0 ? currentNode->left : currentNode->right; // node >= newNode goes left
     }
-    tree->size++;
-    return fixTree(tree, node);
+    COUNT_DESCENT(tree, depth);
+    return linkNewNode(tree, data, parent, comp > 0, inserted);
 }
 
 /**
- * check whether the tree contains this item.
+ * add an item to the tree
  * @param tree: the tree to add an item to.
- * @param data: item to check.
- * @return: 0 if the item is not in the tree, other if it is.
+ * @param data: item to add to the tree.
+ * @return: 0 on failure, other on success. (if the item is already in the tree - failure).
  */
-int containsRBTree(RBTree *tree, void *data)
+int addToRBTree(RBTree *tree, void *data)
 {
-    if (tree->root == NULL || data == NULL)
+    if (tree == NULL || data == NULL || tree->mapped != NULL)
     {
         return FAILURE;
     }
-
-    Node *current = tree->root;
-    while (current != NULL)
+    if (tree->bplus != NULL)
     {
-        int comp = tree->compFunc(current->data, data);
-        if (comp == 0)
-        {
-            return SUCCESS;
-        }
-        else if (comp > 0)
+        int added = addToBPlusTree(tree->bplus, data);
+        tree->size += added ? 1 : 0;
+        if (added)
         {
-            current = current->left;
+            addToBloom(tree, data);
         }
-        else
+        return added;
+    }
+    if (tree->compact != NULL)
+    {
+        int added = addToCompactRBTree(tree->compact, data);
+        tree->size += added ? 1 : 0;
+        if (added)
         {
-            current = current->right;
+            addToBloom(tree, data);
         }
+        return added;
     }
-    return FAILURE;
+    int inserted = 0;
+    insertOrFindNode(tree, data, &inserted);
+    return inserted ? SUCCESS : FAILURE;
 }
 
 /**
- * actives the for each function on every node, in order.
- * @param root
- * @param func: the function to activate on all items.
- * @param args: more optional arguments to the function (may be null if the given function support it).
- * @return 1 if success, 0 else.
+ * add an item next to a node whose item is close to it, in O(1) amortized if data goes right before or after the
+ * item of the hint, and with a regular descent otherwise. red-black engine only.
+ * addToRBTree itself links an item that is larger than all the items (or smaller than all of them) without a
+ * descent, so sorted input needs no hint.
+ * @param tree: the tree to add an item to.
+ * @param data: item to add to the tree.
+ * @param hint: a node of the tree (e.g. the one this function returned for the previous item), may be NULL.
+ * @return: the node of the new item, NULL on failure (if the item is already in the tree - failure).
  */
-static int forEachRBTreeRecursive(Node *root, forEachFunc func, void *args)
+Node *addToRBTreeHint(RBTree *tree, void *data, Node *hint)
 {
-    if (root == NULL)
+    if (tree == NULL || data == NULL || tree->bplus != NULL || tree->compact != NULL || tree->mapped != NULL)
     {
-        return SUCCESS;
+        return NULL;
     }
-
-    int t1 = forEachRBTreeRecursive(root->left, func, args);
-    if (t1 == 0)
+    int inserted = 0;
+    if (hint != NULL)
     {
-        return t1;
-    }
-    int t = func(root->data, args);
-    int t2 = forEachRBTreeRecursive(root->right, func, args);
-    if (t2 == 0)
+        uint64_t prefix = itemPrefix(tree, data);
+        int comp = compareToNode(tree, hint, data, prefix);
+        if (comp == 0)
+        {
+            COUNT_DESCENT(tree, 1);
+            return NULL;
+        }
+        // the neighbour on the side of data. the ends are cached, so a hint at an end needs no walk.
+        Node *neighbour = NULL;
+        if (comp < 0 && hint != tree->last)
+        {
+            neighbour = rbNext(hint);
+        }
+        else if (comp > 0 && hint != tree->first)
+        {
+            neighbour = rbPrev(hint);
+        }
+        int neighbourComp = neighbour != NULL ? compareToNode(tree, neighbour, data, prefix) : -comp;
+        COUNT_DESCENT(tree, neighbour != NULL ? 2 : 1);
+        if (neighbourComp == 0)
+        {
+            return NULL;
+        }
+        if ((neighbourComp > 0) == (comp < 0))
+        {
+            // data is between hint and its neighbour: hint's child on that side is free, or else the neighbour's
+            // child on the other side is (the neighbour is the extreme of that subtree).
+            Node *child = comp < 0 ? hint->right : hint->left;
+            return child == NULL ? linkNewNode(tree, data, hint, comp > 0, &inserted)
+                                 : linkNewNode(tree, data, neighbour, comp < 0, &inserted);
+        }
+    }
+    Node *node = insertOrFindNode(tree, data, &inserted);
+    return inserted ? node : NULL;
+}
+
+/**
+ * add an item to the tree, unless an equal item is already in it. a single descent does both the lookup and the
+ * insert. red-black engine only.
+ * @param tree: the tree to add an item to.
+ * @param data: item to add to the tree.
+ * @return: the item of the tree that is equal to data (data itself if it was added), NULL on failure.
+ */
+void *insertOrGetRBTree(RBTree *tree, void *data)
+{
+    if (tree == NULL || data == NULL || tree->bplus != NULL || tree->compact != NULL || tree->mapped != NULL)
+    {
+        return NULL;
+    }
+    int inserted = 0;
+    Node *node = insertOrFindNode(tree, data, &inserted);
+    return node != NULL ? node->data : NULL;
+}
+
+/**
+ * put an item in the tree in a single descent: if an equal item is in the tree it is replaced by data and freed with
+ * the tree's FreeFunc, otherwise data is added. red-black engine only.
+ * @param tree: the tree to put the item in.
+ * @param data: item to put in the tree.
+ * @return: 0 on failure, other on success.
+ */
+int replaceRBTree(RBTree *tree, void *data)
+{
+    if (tree == NULL || data == NULL || tree->bplus != NULL || tree->compact != NULL || tree->mapped != NULL)
+    {
+        return FAILURE;
+    }
+    int inserted = 0;
+    Node *node = insertOrFindNode(tree, data, &inserted);
+    if (node == NULL)
+    {
+        return FAILURE;
+    }
+    if (!inserted && node->data != data)
+    {
+        // equal items sort the same, so the node keeps its place.
+        tree->freeFunc(node->data);
+        node->data = data;
+        updateNodesToRoot(tree, node);
+    }
+    return SUCCESS;
+}
+
+/**
+ * a subtree to build from a sorted range, possibly on another thread.
+ */
+typedef struct BuildTask
+{
+    RBTree *tree;
+    void **data;
+    int from, to; // the range [from, to) of data
+    int depth, redDepth;
+    int nThreads;
+    int failed;
+    Node *result;
+} BuildTask;
+
+/**
+ * builds a balanced subtree from data[from, to). nodes at depth redDepth (the last, incomplete level) are red and
+ * all others are black, so every path has the same number of black nodes.
+ * @param tree
+ * @param data
+ * @param from
+ * @param to
+ * @param depth depth of the subtree root
+ * @param redDepth depth of the red level
+ * @param failed set to 1 if an allocation fails (the subtree of the failed node is left out)
+ * @return the root of the subtree
+ */
+static Node *buildSubtree(RBTree *tree, void **data, int from, int to, int depth, int redDepth, int *failed)
+{
+    if (from >= to)
+    {
+        return NULL;
+    }
+    int mid = from + (to - from) / 2;
+    Node *node = allocateNode(tree, data[mid]);
+    if (node == NULL)
+    {
+        *failed = 1;
+        return NULL;
+    }
+    node->color = depth == redDepth ? RED : BLACK;
+    node->count = to - from;
+    node->left = buildSubtree(tree, data, from, mid, depth + 1, redDepth, failed);
+    node->right = buildSubtree(tree, data, mid + 1, to, depth + 1, redDepth, failed);
+    if (node->left != NULL)
+    {
+        node->left->parent = node;
+    }
+    if (node->right != NULL)
+    {
+        node->right->parent = node;
+    }
+    return node;
+}
+
+/**
+ * builds the subtree of a BuildTask, forking the left half to a new thread while there are threads to spare.
+ * @param arg the BuildTask
+ * @return NULL
+ */
+static void *runBuildTask(void *arg)
+{
+    BuildTask *task = (BuildTask *) arg;
+    if (task->nThreads < 2 || task->to - task->from < PARALLEL_BUILD_THRESHOLD)
+    {
+        task->result = buildSubtree(task->tree, task->data, task->from, task->to, task->depth, task->redDepth,
+                                    &task->failed);
+        return NULL;
+    }
+
+    int mid = task->from + (task->to - task->from) / 2;
+    BuildTask left = {task->tree, task->data, task->from, mid, task->depth + 1, task->redDepth, task->nThreads / 2,
+                      0, NULL};
+    BuildTask right = {task->tree, task->data, mid + 1, task->to, task->depth + 1, task->redDepth,
+                       task->nThreads - task->nThreads / 2, 0, NULL};
+    pthread_t thread;
+    int forked = pthread_create(&thread, NULL, runBuildTask, &left) == 0;
+    if (!forked)
+    {
+        runBuildTask(&left);
+    }
+    runBuildTask(&right);
+    if (forked)
+    {
+        pthread_join(thread, NULL);
+    }
+
+    Node *node = allocateNode(task->tree, task->data[mid]);
+    task->failed = left.failed || right.failed || node == NULL;
+    task->result = node;
+    if (node == NULL)
+    {
+        // keep the built halves reachable so they can be freed.
+        task->result = left.result != NULL ? left.result : right.result;
+        if (left.result != NULL && right.result != NULL)
+        {
+            Node *rightmost = left.result;
+            while (rightmost->right != NULL)
+            {
+                rightmost = rightmost->right;
+            }
+            rightmost->right = right.result;
+        }
+        return NULL;
+    }
+    node->color = task->depth == task->redDepth ? RED : BLACK;
+    node->count = task->to - task->from;
+    node->left = left.result;
+    node->right = right.result;
+    if (node->left != NULL)
+    {
+        node->left->parent = node;
+    }
+    if (node->right != NULL)
+    {
+        node->right->parent = node;
+    }
+    return NULL;
+}
+
+/**
+ * frees the nodes of a subtree, without the data.
+ * @param root
+ */
+static void freeNodesRecursive(Node *root)
+{
+    if (root == NULL)
+    {
+        return;
+    }
+    freeNodesRecursive(root->left);
+    freeNodesRecursive(root->right);
+    free(root);
+}
+
+/**
+ * same as buildRBTreeFromSorted, but builds disjoint subtrees on up to nThreads threads.
+ * @param data: the items, sorted by compFunc.
+ * @param n: number of items.
+ * @param compFunc: a function two compare two variables.
+ * @param freeFunc: a function to free a data item.
+ * @param nThreads: maximal number of threads to use (including the calling one).
+ * @return: the new tree, NULL on failure (the items are not freed in that case).
+ */
+RBTree *buildRBTreeFromSortedParallel(void *data[], int n, CompareFunc compFunc, FreeFunc freeFunc, int nThreads)
+{
+    if ((data == NULL && n > 0) || n < 0)
+    {
+        return NULL;
+    }
+    RBTree *tree = newRBTree(compFunc, freeFunc);
+    if (tree == NULL)
+    {
+        return NULL;
+    }
+
+    // the levels above redDepth are complete, so they are black. the extra nodes below them are red.
+    int redDepth = 0;
+    while ((1L << (redDepth + 1)) - 1 <= n)
+    {
+        redDepth++;
+    }
+    BuildTask task = {tree, data, 0, n, 0, redDepth, nThreads, 0, NULL};
+    runBuildTask(&task);
+    if (task.failed)
+    {
+        freeNodesRecursive(task.result);
+        free(tree);
+        return NULL;
+    }
+    tree->root = task.result;
+    tree->size = n;
+    findEnds(tree);
+    return tree;
+}
+
+/**
+ * constructs a new RBTree from items that are already sorted in a strictly ascending order, in O(n) and without
+ * calling compFunc. the items must not contain duplicates.
+ * @param data: the items, sorted by compFunc.
+ * @param n: number of items.
+ * @param compFunc: a function two compare two variables.
+ * @param freeFunc: a function to free a data item.
+ * @return: the new tree, NULL on failure (the items are not freed in that case).
+ */
+RBTree *buildRBTreeFromSorted(void *data[], int n, CompareFunc compFunc, FreeFunc freeFunc)
+{
+    return buildRBTreeFromSortedParallel(data, n, compFunc, freeFunc, 1);
+}
+
+/**
+ * links nodes[from, to) (in an ascending order) into a balanced subtree, colored like buildSubtree does.
+ * @param tree the tree the nodes belong to
+ * @param nodes
+ * @param from
+ * @param to
+ * @param depth depth of the subtree root
+ * @param redDepth depth of the red level
+ * @return the root of the subtree
+ */
+static Node *linkSubtree(const RBTree *tree, Node **nodes, int from, int to, int depth, int redDepth)
+{
+    if (from >= to)
+    {
+        return NULL;
+    }
+    int mid = from + (to - from) / 2;
+    Node *node = nodes[mid];
+    node->color = depth == redDepth ? RED : BLACK;
+    node->count = to - from;
+    node->left = linkSubtree(tree, nodes, from, mid, depth + 1, redDepth);
+    node->right = linkSubtree(tree, nodes, mid + 1, to, depth + 1, redDepth);
+    if (node->left != NULL)
+    {
+        node->left->parent = node;
+    }
+    if (node->right != NULL)
+    {
+        node->right->parent = node;
+    }
+    if (tree->aggregate.size != 0)
+    {
+        updateNode(tree, node);
+    }
+    return node;
+}
+
+/**
+ * sorts the indices of the non NULL items of a batch by their items, and keeps only the first index (in the batch
+ * order) of equal items.
+ * @param items
+ * @param n
+ * @param compFunc
+ * @param order out: the sorted indices (n slots)
+ * @return the number of sorted indices, -1 on failure
+ */
+static int sortBatch(void **items, int n, CompareFunc compFunc, int *order)
+{
+    int m = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        if (items[i] != NULL)
+        {
+            order[m++] = i;
+        }
+    }
+    // batches often arrive sorted, that takes m - 1 comparisons to see.
+    int ascending = 1;
+    for (int i = 1; i < m && ascending; ++i)
+    {
+        ascending = compFunc(items[order[i - 1]], items[order[i]]) < 0;
+    }
+    if (ascending)
+    {
+        return m;
+    }
+
+    int *buffer = malloc(sizeof(int) * (m > 0 ? m : 1));
+    if (buffer == NULL)
+    {
+        return -1;
+    }
+    // bottom up merge sort: stable, and n log n comparisons at worst.
+    for (int width = 1; width < m; width *= 2)
+    {
+        for (int from = 0; from < m; from += 2 * width)
+        {
+            int mid = from + width < m ? from + width : m;
+            int to = from + 2 * width < m ? from + 2 * width : m;
+            int i = from, j = mid, k = from;
+            while (i < mid && j < to)
+            {
+                buffer[k++] = compFunc(items[order[j]], items[order[i]]) < 0 ? order[j++] : order[i++];
+            }
+            while (i < mid)
+            {
+                buffer[k++] = order[i++];
+            }
+            while (j < to)
+            {
+                buffer[k++] = order[j++];
+            }
+        }
+        for (int i = 0; i < m; ++i)
+        {
+            order[i] = buffer[i];
+        }
+    }
+    free(buffer);
+
+    // equal items are adjacent and in the batch order: keep the first of each run.
+    int unique = 0;
+    for (int i = 0; i < m; ++i)
+    {
+        if (unique == 0 || compFunc(items[order[unique - 1]], items[order[i]]) != 0)
+        {
+            order[unique++] = order[i];
+        }
+    }
+    return unique;
+}
+
+/**
+ * @param tree
+ * @param m number of items to add
+ * @return 1 if merging m items and rebuilding is cheaper than m descents, 0 else
+ */
+static int shouldRebuild(const RBTree *tree, int m)
+{
+    // a rebuild walks all size + m items once, m inserts cost about log2(size + m) each.
+    long total = (long) tree->size + m;
+    int height = 0;
+    while ((1L << height) <= total)
+    {
+        height++;
+    }
+    return total < (long) m * height;
+}
+
+/**
+ * merges the sorted unique batch with the items of the tree and rebuilds the tree from the merged sequence. the
+ * existing nodes are reused, so only the added items cost an allocation.
+ * @param tree
+ * @param items
+ * @param order the sorted indices of the batch items, without duplicates
+ * @param m number of indices in order
+ * @param results may be NULL
+ * @return the number of items added, -1 on failure (then the tree is unchanged)
+ */
+static int mergeAndRebuild(RBTree *tree, void **items, const int *order, int m, int *results)
+{
+    Node **merged = malloc(sizeof(Node *) * ((size_t) tree->size + m));
+    Node **added = malloc(sizeof(Node *) * m);
+    if (merged == NULL || added == NULL)
+    {
+        free(merged);
+        free(added);
+        return -1;
+    }
+
+    // the tree isn't touched until the merged sequence is complete, so a failed allocation is easy to undo.
+    int total = 0, addedCount = 0, next = 0;
+    Node *node = rbFirst(tree);
+    while (next < m)
+    {
+        int comp = node != NULL ? tree->compFunc(node->data, items[order[next]]) : GREATER;
+        if (comp < 0)
+        {
+            merged[total++] = node;
+            node = rbNext(node);
+            continue;
+        }
+        if (comp > 0)
+        {
+            Node *newNode = allocateNode(tree, items[order[next]]);
+            if (newNode == NULL)
+            {
+                while (addedCount > 0)
+                {
+                    releaseNode(tree, added[--addedCount]);
+                }
+                for (int i = 0; i < next && results != NULL; ++i)
+                {
+                    results[order[i]] = FAILURE;
+                }
+                free(merged);
+                free(added);
+                return -1;
+            }
+            merged[total++] = newNode;
+            added[addedCount++] = newNode;
+            if (results != NULL)
+            {
+                results[order[next]] = SUCCESS;
+            }
+        }
+        next++;
+    }
+    for (; node != NULL; node = rbNext(node))
+    {
+        merged[total++] = node;
+    }
+    int redDepth = 0;
+    while ((1L << (redDepth + 1)) - 1 <= total)
+    {
+        redDepth++;
+    }
+    tree->root = linkSubtree(tree, merged, 0, total, 0, redDepth);
+    tree->root->parent = NULL;
+    tree->size = total;
+    tree->first = merged[0];
+    tree->last = merged[total - 1];
+    addNodesToBloom(tree, added, addedCount);
+    free(merged);
+    free(added);
+    return addedCount;
+}
+
+/**
+ * add a batch of items to the tree. the batch is sorted and merged with the items of the tree, and a large batch
+ * rebuilds the tree from the merged sequence (reusing its nodes) instead of descending once per item.
+ * the items are accepted exactly as adding them one by one in the batch order would: an item that is already in the
+ * tree, that is equal to an earlier item of the batch, or that is NULL is rejected.
+ * @param tree: the tree to add the items to.
+ * @param items: the items to add, in any order.
+ * @param n: number of items.
+ * @param results: if not NULL, results[i] is set to 0 if items[i] was rejected, other if it was added.
+ * @return: the number of items added, 0 on failure (then no item was added).
+ */
+int addBatchToRBTree(RBTree *tree, void *items[], int n, int *results)
+{
+    if (tree == NULL || items == NULL || n <= 0)
+    {
+        return 0;
+    }
+    for (int i = 0; i < n && results != NULL; ++i)
+    {
+        results[i] = FAILURE;
+    }
+    int addedCount = 0;
+    if (tree->bplus != NULL || tree->compact != NULL || tree->mapped != NULL)
+    {
+        // the other engines have no node sequence to merge with.
+        for (int i = 0; i < n; ++i)
+        {
+            int added = addToRBTree(tree, items[i]);
+            addedCount += added ? 1 : 0;
+            if (results != NULL)
+            {
+                results[i] = added;
+            }
+        }
+        return addedCount;
+    }
+
+    int *order = malloc(sizeof(int) * n);
+    int unique = order != NULL ? sortBatch(items, n, tree->compFunc, order) : -1;
+    if (unique < 0)
+    {
+        free(order);
+        return 0;
+    }
+
+    if (shouldRebuild(tree, unique))
+    {
+        addedCount = mergeAndRebuild(tree, items, order, unique, results);
+        addedCount = addedCount < 0 ? 0 : addedCount;
+    }
+    else
+    {
+        for (int i = 0; i < unique; ++i)
+        {
+            int added = addToRBTree(tree, items[order[i]]);
+            addedCount += added ? 1 : 0;
+            if (results != NULL)
+            {
+                results[order[i]] = added;
+            }
+        }
+    }
+    free(order);
+    return addedCount;
+}
+
+/**
+ * @param node root of a non empty subtree
+ * @return the node with the smallest item in the subtree
+ */
+static Node *minimumNode(Node *node)
+{
+    while (node->left != NULL)
+    {
+        node = node->left;
+    }
+    return node;
+}
+
+/**
+ * @param tree
+ * @param data
+ * @return the node holding an item equal to data, NULL if there is none.
+ */
+static Node *findNode(const RBTree *tree, const void *data)
+{
+    uint64_t prefix = itemPrefix(tree, data);
+    Node *current = tree->root;
+    while (current != NULL)
+    {
+        int comp = compareToNode(tree, current, data, prefix);
+        if (comp == 0)
+        {
+            return current;
+        }
+        current = comp > 0 ? current->left : current->right;
+    }
+    return NULL;
+}
+
+/**
+ * @param tree
+ * @param data
+ * @return the node holding the smallest item that is not smaller than data, NULL if there is none.
+ */
+static Node *lowerBoundNode(const RBTree *tree, const void *data)
+{
+    uint64_t prefix = itemPrefix(tree, data);
+    Node *current = tree->root;
+    Node *bound = NULL;
+    while (current != NULL)
+    {
+        if (compareToNode(tree, current, data, prefix) >= 0)
+        {
+            bound = current;
+            current = current->left;
+        }
+        else
+        {
+            current = current->right;
+        }
+    }
+    return bound;
+}
+
+/**
+ * @param tree
+ * @param data
+ * @return the node holding the smallest item that is greater than data, NULL if there is none.
+ */
+static Node *upperBoundNode(const RBTree *tree, const void *data)
+{
+    uint64_t prefix = itemPrefix(tree, data);
+    Node *current = tree->root;
+    Node *bound = NULL;
+    while (current != NULL)
+    {
+        if (compareToNode(tree, current, data, prefix) > 0)
+        {
+            bound = current;
+            current = current->left;
+        }
+        else
+        {
+            current = current->right;
+        }
+    }
+    return bound;
+}
+
+/**
+ * @param tree
+ * @param data
+ * @return the node holding the largest item that is not greater than data, NULL if there is none.
+ */
+static Node *floorNode(const RBTree *tree, const void *data)
+{
+    uint64_t prefix = itemPrefix(tree, data);
+    Node *current = tree->root;
+    Node *bound = NULL;
+    while (current != NULL)
+    {
+        int comp = compareToNode(tree, current, data, prefix);
+        if (comp == 0)
+        {
+            return current;
+        }
+        else if (comp < 0)
+        {
+            bound = current;
+            current = current->right;
+        }
+        else
+        {
+            current = current->left;
+        }
+    }
+    return bound;
+}
+
+/**
+ * rotates left around g, and updates the root of the tree if g was the root.
+ * @param tree
+ * @param g
+ */
+static void rotateTreeLeft(RBTree *tree, Node *g)
+{
+    rotateLeft(tree, g);
+    if (g->parent->parent == NULL)
+    {
+        tree->root = g->parent;
+    }
+}
+
+/**
+ * rotates right around g, and updates the root of the tree if g was the root.
+ * @param tree
+ * @param g
+ */
+static void rotateTreeRight(RBTree *tree, Node *g)
+{
+    rotateRight(tree, g);
+    if (g->parent->parent == NULL)
+    {
+        tree->root = g->parent;
+    }
+}
+
+/**
+ * @param node
+ * @return 1 if the node is black (NULL leaves are black), 0 else
+ */
+static int isBlack(const Node *node)
+{
+    return node == NULL || node->color == BLACK;
+}
+
+/**
+ * puts the subtree of v in the place of the subtree of u.
+ * @param tree
+ * @param u
+ * @param v may be NULL
+ */
+static void transplant(RBTree *tree, Node *u, Node *v)
+{
+    if (u->parent == NULL)
+    {
+        tree->root = v;
+    }
+    else if (isLeftSon(u))
+    {
+        u->parent->left = v;
+    }
+    else
+    {
+        u->parent->right = v;
+    }
+    if (v != NULL)
+    {
+        v->parent = u->parent;
+    }
+}
+
+/**
+ * fixes the tree after a black node was removed from above x.
+ * @param tree
+ * @param x the node that carries the extra black, may be NULL
+ * @param parent the parent of x (needed when x is NULL)
+ */
+static void fixTreeAfterRemove(RBTree *tree, Node *x, Node *parent)
+{
+    while (x != tree->root && isBlack(x))
+    {
+        if (x == parent->left)
+        {
+            Node *sibling = parent->right;
+            if (sibling->color == RED)
+            {
+                sibling->color = BLACK;
+                parent->color = RED;
+                rotateTreeLeft(tree, parent);
+                sibling = parent->right;
+            }
+            if (isBlack(sibling->left) && isBlack(sibling->right))
+            {
+                sibling->color = RED;
+                x = parent;
+                parent = x->parent;
+                continue;
+            }
+            if (isBlack(sibling->right))
+            {
+                sibling->left->color = BLACK;
+                sibling->color = RED;
+                rotateTreeRight(tree, sibling);
+                sibling = parent->right;
+            }
+            sibling->color = parent->color;
+            parent->color = BLACK;
+            sibling->right->color = BLACK;
+            rotateTreeLeft(tree, parent);
+        }
+        else
+        {
+            Node *sibling = parent->left;
+            if (sibling->color == RED)
+            {
+                sibling->color = BLACK;
+                parent->color = RED;
+                rotateTreeRight(tree, parent);
+                sibling = parent->left;
+            }
+            if (isBlack(sibling->left) && isBlack(sibling->right))
+            {
+                sibling->color = RED;
+                x = parent;
+                parent = x->parent;
+                continue;
+            }
+            if (isBlack(sibling->left))
+            {
+                sibling->right->color = BLACK;
+                sibling->color = RED;
+                rotateTreeLeft(tree, sibling);
+                sibling = parent->left;
+            }
+            sibling->color = parent->color;
+            parent->color = BLACK;
+            sibling->left->color = BLACK;
+            rotateTreeRight(tree, parent);
+        }
+        x = tree->root;
+    }
+    if (x != NULL)
+    {
+        x->color = BLACK;
+    }
+}
+
+/**
+ * unlinks a node from the tree, rebalances it, frees the item and keeps the node for reuse.
+ * nodes are relinked rather than having their items swapped, so pointers to other nodes stay valid.
+ * @param tree
+ * @param node
+ */
+static void removeNode(RBTree *tree, Node *node)
+{
+    if (node == tree->first)
+    {
+        tree->first = rbNext(node);
+    }
+    if (node == tree->last)
+    {
+        tree->last = rbPrev(node);
+    }
+    Color removedColor = node->color;
+    Node *x, *xParent;
+    if (node->left == NULL || node->right == NULL)
+    {
+        x = node->left != NULL ? node->left : node->right;
+        xParent = node->parent;
+        transplant(tree, node, x);
+    }
+    else
+    {
+        Node *next = minimumNode(node->right);
+        removedColor = next->color;
+        x = next->right;
+        if (next->parent == node)
+        {
+            xParent = next;
+        }
+        else
+        {
+            xParent = next->parent;
+            transplant(tree, next, next->right);
+            next->right = node->right;
+            next->right->parent = next;
+        }
+        transplant(tree, node, next);
+        next->left = node->left;
+        next->left->parent = next;
+        next->color = node->color;
+    }
+    updateNodesToRoot(tree, xParent);
+    if (removedColor == BLACK)
+    {
+        fixTreeAfterRemove(tree, x, xParent);
+    }
+    tree->size--;
+    tree->freeFunc(node->data);
+    releaseNode(tree, node);
+}
+
+/**
+ * remove an item from the tree. the item stored in the tree is freed with the tree's FreeFunc, and its node is kept
+ * for reuse by the next insert.
+ * @param tree: the tree to remove an item from.
+ * @param data: item to remove.
+ * @return: 0 on failure, other on success. (if the item is not in the tree - failure).
+ */
+int removeFromRBTree(RBTree *tree, const void *data)
+{
+    if (tree == NULL || data == NULL)
+    {
+        return FAILURE;
+    }
+    Node *node = findNode(tree, data);
+    if (node == NULL)
+    {
+        return FAILURE;
+    }
+    removeNode(tree, node);
+    return SUCCESS;
+}
+
+/*
+ * a subtree detached from a tree, with its black height (the black nodes on a path from its root to a leaf).
+ */
+typedef struct Subtree
+{
+    Node *root;
+    int height;
+} Subtree;
+
+/**
+ * @param node
+ * @return the black height of the subtree of node
+ */
+static int blackHeight(const Node *node)
+{
+    int height = 0;
+    for (; node != NULL; node = node->left)
+    {
+        height += node->color == BLACK;
+    }
+    return height;
+}
+
+/**
+ * detaches the subtree of a node from its parent. a red root is recolored black, so the subtree is a red-black tree.
+ * @param node may be NULL
+ * @param height the black height of the subtree of node
+ * @return the subtree
+ */
+static Subtree detachSubtree(Node *node, int height)
+{
+    Subtree subtree = {node, height};
+    if (node != NULL)
+    {
+        node->parent = NULL;
+        if (node->color == RED)
+        {
+            node->color = BLACK;
+            subtree.height++;
+        }
+    }
+    return subtree;
+}
+
+/**
+ * fixes a detached subtree after a red node was linked in by joinSubtrees. like fixTree, but reports whether the
+ * root was recolored, which is the only way the black height of the subtree grows.
+ * @param tree the tree the nodes belong to (its root isn't used)
+ * @param node the red node
+ * @return 1 if the black height of the tree grew, 0 else
+ */
+static int fixJoinedNode(RBTree *tree, Node *node)
+{
+    while (node->parent != NULL && node->parent->color == RED)
+    {
+        // a red parent isn't the root, so node has a grandparent.
+        Node *uncle = findUncle(node);
+        if (uncle == NULL || uncle->color == BLACK)
+        {
+            blackUncle(node, tree);
+            return 0;
+        }
+        COUNT_STAT(tree, recolorings, 1);
+        uncle->color = BLACK;
+        node->parent->color = BLACK;
+        node->parent->parent->color = RED;
+        node = node->parent->parent;
+    }
+    if (node->parent == NULL && node->color == RED)
+    {
+        node->color = BLACK;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * joins two subtrees and a node whose item is between theirs, in O(|difference of the black heights| + 1): the node
+ * is linked on the inner spine of the higher subtree, at the black node whose black height is the one of the lower
+ * subtree, with that node and the lower subtree as its children, and fixed like a new node.
+ * @param tree the tree the nodes belong to (its root isn't used)
+ * @param left a subtree of items lower than the item of node
+ * @param node a detached node
+ * @param right a subtree of items greater than the item of node
+ * @return the joined subtree
+ */
+static Subtree joinSubtrees(RBTree *tree, Subtree left, Node *node, Subtree right)
+{
+    node->parent = NULL;
+    if (left.height == right.height)
+    {
+        node->left = left.root;
+        node->right = right.root;
+        node->color = BLACK;
+        if (left.root != NULL)
+        {
+            left.root->parent = node;
+        }
+        if (right.root != NULL)
+        {
+            right.root->parent = node;
+        }
+        if (isAugmented(tree))
+        {
+            updateNode(tree, node);
+        }
+        Subtree joined = {node, left.height + 1};
+        return joined;
+    }
+
+    int rightHigher = right.height > left.height;
+    Subtree higher = rightHigher ? right : left;
+    int target = rightHigher ? left.height : right.height;
+    Node *parent = NULL;
+    Node *spine = higher.root;
+    int height = higher.height;
+    // the root of a subtree is black and higher than target, so the walk takes at least one step.
+    while (height != target || !isBlack(spine))
+    {
+        height -= spine->color == BLACK;
+        parent = spine;
+        spine = rightHigher ? spine->left : spine->right;
+    }
+    node->left = rightHigher ? left.root : spine;
+    node->right = rightHigher ? spine : right.root;
+    node->parent = parent;
+    node->color = RED;
+    if (rightHigher)
+    {
+        parent->left = node;
+    }
+    else
+    {
+        parent->right = node;
+    }
+    if (node->left != NULL)
+    {
+        node->left->parent = node;
+    }
+    if (node->right != NULL)
+    {
+        node->right->parent = node;
+    }
+    updateNodesToRoot(tree, node);
+    higher.height += fixJoinedNode(tree, node);
+    // a rotation at the root of the subtree moves it one level down.
+    higher.root = higher.root->parent != NULL ? higher.root->parent : higher.root;
+    return higher;
+}
+
+/**
+ * splits the subtree of a node into the items lower than key and the others, joining the pieces on the way up.
+ * @param tree the tree the nodes belong to
+ * @param node the root of the subtree, may be NULL
+ * @param height the black height of the subtree
+ * @param key
+ * @param left out, the items lower than key
+ * @param right out, the other items
+ */
+static void splitSubtree(RBTree *tree, Node *node, int height, const void *key, Subtree *left, Subtree *right)
+{
+    if (node == NULL)
+    {
+        Subtree empty = {NULL, 0};
+        *left = empty;
+        *right = empty;
+        return;
+    }
+    int childHeight = height - (node->color == BLACK);
+    Node *lower = node->left;
+    Node *higher = node->right;
+    if (tree->compFunc(node->data, key) >= 0)
+    {
+        splitSubtree(tree, lower, childHeight, key, left, right);
+        *right = joinSubtrees(tree, *right, node, detachSubtree(higher, childHeight));
+    }
+    else
+    {
+        splitSubtree(tree, higher, childHeight, key, left, right);
+        *left = joinSubtrees(tree, detachSubtree(lower, childHeight), node, *left);
+    }
+}
+
+/**
+ * takes the node of the largest item out of a subtree, in O(log n).
+ * @param tree the tree the nodes belong to
+ * @param node the root of a non empty subtree
+ * @param height the black height of the subtree
+ * @param last out, the detached node of the largest item
+ * @return the subtree of the other items
+ */
+static Subtree splitLastNode(RBTree *tree, Node *node, int height, Node **last)
+{
+    int childHeight = height - (node->color == BLACK);
+    Node *lower = node->left;
+    if (node->right == NULL)
+    {
+        *last = node;
+        return detachSubtree(lower, childHeight);
+    }
+    Subtree rest = splitLastNode(tree, node->right, childHeight, last);
+    return joinSubtrees(tree, detachSubtree(lower, childHeight), node, rest);
+}
+
+/**
+ * frees the items of a detached subtree and keeps its nodes for reuse.
+ * @param tree
+ * @param node may be NULL
+ */
+static void releaseSubtree(RBTree *tree, Node *node)
+{
+    if (node == NULL)
+    {
+        return;
+    }
+    releaseSubtree(tree, node->left);
+    releaseSubtree(tree, node->right);
+    tree->freeFunc(node->data);
+    releaseNode(tree, node);
+}
+
+/**
+ * removes the items in [lo, hi) from a tree that keeps subtree sizes or aggregates: it's split at lo and at hi, the
+ * middle is released and the outer parts are joined, so only O(log n) nodes are recomputed.
+ * @param tree
+ * @param lo
+ * @param hi
+ * @return the number of items removed
+ */
+static int removeRangeBySplit(RBTree *tree, const void *lo, const void *hi)
+{
+    Subtree lower, rest, middle, higher;
+    splitSubtree(tree, tree->root, blackHeight(tree->root), lo, &lower, &rest);
+    splitSubtree(tree, rest.root, rest.height, hi, &middle, &higher);
+    Node *pivot = NULL;
+    if (lower.root != NULL && higher.root != NULL)
+    {
+        lower = splitLastNode(tree, lower.root, lower.height, &pivot);
+    }
+    Subtree joined = pivot != NULL ? joinSubtrees(tree, lower, pivot, higher) : lower.root != NULL ? lower : higher;
+    int removed = middle.root != NULL ? middle.root->count : 0;
+    tree->root = joined.root;
+    tree->size -= removed;
+    findEnds(tree);
+    releaseSubtree(tree, middle.root);
+    return removed;
+}
+
+/**
+ * remove all the items in the range [lo, hi) from the tree, in O(log n + k) amortized for k removed items (a tree
+ * with order statistics or an aggregate is split around the range and joined back). the items are freed with the
+ * tree's FreeFunc.
+ * @param tree: the tree to remove items from.
+ * @param lo: lowest item to remove (inclusive).
+ * @param hi: the end of the range (exclusive).
+ * @return: the number of items removed, -1 on an engine that doesn't support it.
+ */
+int removeRangeFromRBTree(RBTree *tree, const void *lo, const void *hi)
+{
+    if (tree == NULL || lo == NULL || hi == NULL)
+    {
+        return 0;
+    }
+    if (tree->bplus != NULL || tree->compact != NULL)
+    {
+        return -1;
+    }
+    if (isAugmented(tree))
+    {
+        return tree->compFunc(lo, hi) < 0 ? removeRangeBySplit(tree, lo, hi) : 0;
+    }
+    int removed = 0;
+    Node *node = lowerBoundNode(tree, lo);
+    while (node != NULL && tree->compFunc(node->data, hi) < 0)
+    {
+        Node *next = rbNext(node);
+        removeNode(tree, node);
+        node = next;
+        removed++;
+    }
+    return removed;
+}
+
+/**
+ * @param tree
+ * @return 1 if the nodes of the tree can move to another tree: a red-black engine tree without a pool (whose nodes
+ * belong to it) and without a Bloom filter (which can't be split).
+ */
+static int canMoveNodes(const RBTree *tree)
+{
+    return tree->bplus == NULL && tree->compact == NULL && tree->mapped == NULL && tree->pool == NULL &&
+           tree->bloom == NULL;
+}
+
+/**
+ * @param tree
+ * @return a new empty tree with the same functions and node layout
+ */
+static RBTree *newTreeLike(const RBTree *tree)
+{
+    RBTreeOptions options = {0};
+    options.orderStatistics = tree->orderStatistics;
+    options.keyCompFunc = tree->keyCompFunc;
+    options.prefixFunc = tree->prefixFunc;
+    options.aggregate = tree->aggregate.size != 0 ? &tree->aggregate : NULL;
+    return newRBTreeWithOptions(tree->compFunc, tree->freeFunc, &options);
+}
+
+/**
+ * split a tree into a tree of the items lower than key and a tree of the others, in O(log n). red-black engine
+ * only, without a pool or a Bloom filter, and with order statistics or an aggregate: the sizes of the new trees are
+ * the counts of their roots.
+ * @param tree: the tree to split. on success it is freed, and its nodes belong to the new trees.
+ * @param key: item to compare to.
+ * @param left: set to a tree of the items lower than key.
+ * @param right: set to a tree of the items that are not lower than key.
+ * @return: 0 on failure (then the tree is not changed), other on success.
+ */
+int splitRBTree(RBTree *tree, const void *key, RBTree **left, RBTree **right)
+{
+    if (tree == NULL || key == NULL || left == NULL || right == NULL || !canMoveNodes(tree) || !isAugmented(tree))
+    {
+        return FAILURE;
+    }
+    RBTree *lower = newTreeLike(tree);
+    RBTree *higher = newTreeLike(tree);
+    if (lower == NULL || higher == NULL)
+    {
+        freeRBTree(lower);
+        freeRBTree(higher);
+        return FAILURE;
+    }
+    Subtree lowerItems, higherItems;
+    splitSubtree(tree, tree->root, blackHeight(tree->root), key, &lowerItems, &higherItems);
+    lower->root = lowerItems.root;
+    higher->root = higherItems.root;
+    findEnds(lower);
+    findEnds(higher);
+    lower->size = lower->root != NULL ? lower->root->count : 0;
+    higher->size = tree->size - lower->size;
+    lower->freeNodes = tree->freeNodes;
+    free(tree);
+    *left = lower;
+    *right = higher;
+    return SUCCESS;
+}
+
+/**
+ * join two trees and an item between them into one tree, in O(log n): the root of the lower tree (in black height)
+ * is linked on the inner spine of the higher one. red-black engine only, without a pool or a Bloom filter, and both
+ * trees must have the same functions and options.
+ * @param left: a tree whose items are all lower than pivot and than the items of right.
+ * @param pivot: item to add between the trees, NULL to only concatenate them.
+ * @param right: a tree whose items are all greater than pivot.
+ * @return: the joined tree (left itself, right is freed), NULL on failure (then the trees are not changed).
+ */
+RBTree *joinRBTree(RBTree *left, void *pivot, RBTree *right)
+{
+    if (left == NULL || right == NULL || left == right || !canMoveNodes(left) || !canMoveNodes(right) ||
+        left->compFunc != right->compFunc || left->freeFunc != right->freeFunc ||
+        left->orderStatistics != right->orderStatistics || left->prefixFunc != right->prefixFunc ||
+        left->keyCompFunc != right->keyCompFunc || left->aggregate.size != right->aggregate.size ||
+        left->aggregate.value != right->aggregate.value || left->aggregate.combine != right->aggregate.combine)
+    {
+        return NULL;
+    }
+    // the order is checked against the cached ends, in O(1).
+    if ((pivot != NULL && left->last != NULL && left->compFunc(left->last->data, pivot) >= 0) ||
+        (pivot != NULL && right->first != NULL && left->compFunc(pivot, right->first->data) >= 0) ||
+        (left->last != NULL && right->first != NULL && left->compFunc(left->last->data, right->first->data) >= 0))
+    {
+        return NULL;
+    }
+    Node *node = NULL;
+    if (pivot != NULL)
+    {
+        node = allocateNode(left, pivot);
+        if (node == NULL)
+        {
+            return NULL;
+        }
+    }
+
+    Subtree lower = {left->root, blackHeight(left->root)};
+    Subtree higher = {right->root, blackHeight(right->root)};
+    Node *first = left->first != NULL ? left->first : node != NULL ? node : right->first;
+    Node *last = right->last != NULL ? right->last : node != NULL ? node : left->last;
+    if (node == NULL && lower.root != NULL && higher.root != NULL)
+    {
+        // concatenating: the largest item of left joins the trees.
+        lower = splitLastNode(left, lower.root, lower.height, &node);
+    }
+    Subtree joined = node != NULL ? joinSubtrees(left, lower, node, higher) : lower.root != NULL ? lower : higher;
+    left->root = joined.root;
+    left->first = first;
+    left->last = last;
+    left->size += right->size + (pivot != NULL);
+
+    // the nodes right kept for reuse move to left.
+    if (left->freeNodes == NULL)
+    {
+        left->freeNodes = right->freeNodes;
+    }
+    else
+    {
+        while (right->freeNodes != NULL)
+        {
+            Node *next = right->freeNodes->parent;
+            right->freeNodes->parent = left->freeNodes;
+            left->freeNodes = right->freeNodes;
+            right->freeNodes = next;
+        }
+    }
+    free(right);
+    return left;
+}
+
+/**
+ * @param tree
+ * @param data
+ * @return 1 if the engine of the tree holds an item equal to data, 0 else
+ */
+static int containsInEngine(RBTree *tree, void *data)
+{
+    if (tree != NULL && tree->bplus != NULL)
+    {
+        return containsBPlusTree(tree->bplus, data);
+    }
+    if (tree != NULL && tree->compact != NULL)
+    {
+        return containsCompactRBTree(tree->compact, data);
+    }
+    if (tree != NULL && tree->mapped != NULL)
+    {
+        return findMappedRBTree(tree->mapped, data) != NULL;
+    }
+    if (tree == NULL || tree->root == NULL || data == NULL)
+    {
+        return FAILURE;
+    }
+    return findNode(tree, data) != NULL ? SUCCESS : FAILURE;
+}
+
+/**
+ * check whether the tree contains this item. a tree with a Bloom filter answers most misses without a descent.
+ * @param tree: the tree to add an item to.
+ * @param data: item to check.
+ * @return: 0 if the item is not in the tree, other if it is.
+ */
+int containsRBTree(RBTree *tree, void *data)
+{
+    if (tree != NULL && tree->bloom != NULL && data != NULL)
+    {
+        // the counters are atomic since readers may share the tree.
+        __atomic_add_fetch(&tree->bloomStats.queries, 1, __ATOMIC_RELAXED);
+        if (!mayContainBloomFilter(tree->bloom, tree->hashFunc(data)))
+        {
+            __atomic_add_fetch(&tree->bloomStats.filtered, 1, __ATOMIC_RELAXED);
+            return FAILURE;
+        }
+        int found = containsInEngine(tree, data);
+        if (!found)
+        {
+            __atomic_add_fetch(&tree->bloomStats.falsePositives, 1, __ATOMIC_RELAXED);
+        }
+        return found;
+    }
+    return containsInEngine(tree, data);
+}
+
+/**
+ * @param tree: the tree to search.
+ * @param data: item to compare to.
+ * @return: the item stored in the tree that is equal to data, NULL if there is none.
+ */
+void *findRBTree(const RBTree *tree, const void *data)
+{
+    if (tree != NULL && tree->bplus != NULL)
+    {
+        return findBPlusTree(tree->bplus, data);
+    }
+    if (tree != NULL && tree->compact != NULL)
+    {
+        return findCompactRBTree(tree->compact, data);
+    }
+    if (tree != NULL && tree->mapped != NULL)
+    {
+        return findMappedRBTree(tree->mapped, data);
+    }
+    if (tree == NULL || data == NULL)
+    {
+        return NULL;
+    }
+    Node *node = findNode(tree, data);
+    return node != NULL ? node->data : NULL;
+}
+
+/**
+ * @param tree: the tree to search, using its KeyCompareFunc. red-black engine only.
+ * @param key: the key to look for.
+ * @return: the item of the tree that matches the key, NULL if there is none (or the tree has no KeyCompareFunc).
+ */
+void *findKeyRBTree(const RBTree *tree, const void *key)
+{
+    if (tree == NULL || key == NULL || tree->keyCompFunc == NULL)
+    {
+        return NULL;
+    }
+    const Node *current = tree->root;
+    while (current != NULL)
+    {
+        int comp = tree->keyCompFunc(key, current->data);
+        if (comp == 0)
+        {
+            return current->data;
+        }
+        current = comp < 0 ? current->left : current->right;
+    }
+    return NULL;
+}
+
+/**
+ * check whether the tree contains an item that matches this key, using the tree's KeyCompareFunc. red-black engine
+ * only.
+ * @param tree: the tree to search.
+ * @param key: the key to look for.
+ * @return: 0 if no item matches the key (or the tree has no KeyCompareFunc), other if one does.
+ */
+int containsKeyRBTree(const RBTree *tree, const void *key)
+{
+    return findKeyRBTree(tree, key) != NULL ? SUCCESS : FAILURE;
+}
+
+/**
+ * @param tree: the tree to search.
+ * @param data: item to compare to.
+ * @return: the smallest item in the tree that is not lower than data, NULL if there is none (or on an
+ * engine that doesn't support it).
+ */
+void *lowerBoundRBTree(const RBTree *tree, const void *data)
+{
+    if (tree == NULL || data == NULL || tree->bplus != NULL || tree->compact != NULL)
+    {
+        return NULL;
+    }
+    if (tree->mapped != NULL)
+    {
+        return lowerBoundMappedRBTree(tree->mapped, data);
+    }
+    Node *node = lowerBoundNode(tree, data);
+    return node != NULL ? node->data : NULL;
+}
+
+/**
+ * @param tree: the tree to search.
+ * @param data: item to compare to.
+ * @return: the smallest item in the tree that is greater than data (its successor), NULL if there is none (or on an
+ * engine that doesn't support it).
+ */
+void *upperBoundRBTree(const RBTree *tree, const void *data)
+{
+    if (tree == NULL || data == NULL || tree->bplus != NULL || tree->compact != NULL)
+    {
+        return NULL;
+    }
+    if (tree->mapped != NULL)
+    {
+        return upperBoundMappedRBTree(tree->mapped, data);
+    }
+    Node *node = upperBoundNode(tree, data);
+    return node != NULL ? node->data : NULL;
+}
+
+/**
+ * @param tree: the tree to search.
+ * @param data: item to compare to.
+ * @return: the largest item in the tree that is lower than or equal to data, NULL if there is none (or on an
+ * engine that doesn't support it).
+ */
+void *floorRBTree(const RBTree *tree, const void *data)
+{
+    if (tree == NULL || data == NULL || tree->bplus != NULL || tree->compact != NULL)
+    {
+        return NULL;
+    }
+    if (tree->mapped != NULL)
+    {
+        return floorMappedRBTree(tree->mapped, data);
+    }
+    Node *node = floorNode(tree, data);
+    return node != NULL ? node->data : NULL;
+}
+
+/**
+ * @param tree: the tree to search.
+ * @param data: item to compare to.
+ * @return: the smallest item in the tree that is greater than or equal to data, NULL if there is none (or on an
+ * engine that doesn't support it).
+ * (same as lowerBoundRBTree)
+ */
+void *ceilRBTree(const RBTree *tree, const void *data)
+{
+    return lowerBoundRBTree(tree, data);
+}
+
+/**
+ * Activate a function on each item of the tree in the range [lo, hi), in O(log n + k) for k items. the order is an
+ * ascending order. if one of the activations of the function returns 0, the process stops.
+ * @param tree: the tree with all the items.
+ * @param lo: lowest item of the range (inclusive).
+ * @param hi: the end of the range (exclusive).
+ * @param func: the function to activate on the items.
+ * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @return: 0 on failure (also on an engine that doesn't support it), other on success (an empty range is a
+ * success).
+ */
+int forEachRBTreeRange(const RBTree *tree, const void *lo, const void *hi, forEachFunc func, void *args)
+{
+    if (tree == NULL || lo == NULL || hi == NULL || func == NULL || tree->bplus != NULL || tree->compact != NULL)
+    {
+        return FAILURE;
+    }
+    if (tree->mapped != NULL)
+    {
+        return forEachMappedRBTree(tree->mapped, lo, hi, func, args);
+    }
+    for (Node *node = lowerBoundNode(tree, lo); node != NULL && tree->compFunc(node->data, hi) < 0;
+         node = rbNext(node))
+    {
+        if (func(node->data, args) == 0)
+        {
+            return FAILURE;
+        }
+    }
+    return SUCCESS;
+}
+
+/**
+ * @param node
+ * @return the number of items in the subtree of node
+ */
+static int subtreeCount(const Node *node)
+{
+    return node != NULL ? node->count : 0;
+}
+
+/**
+ * @param tree: a tree with order statistics.
+ * @param data: item to compare to.
+ * @return: the number of items in the tree that are lower than data, -1 on failure.
+ */
+int rankRBTree(const RBTree *tree, const void *data)
+{
+    if (tree == NULL || data == NULL || !tree->orderStatistics)
+    {
+        return -1;
+    }
+    uint64_t prefix = itemPrefix(tree, data);
+    int rank = 0;
+    Node *current = tree->root;
+    while (current != NULL)
+    {
+        if (compareToNode(tree, current, data, prefix) < 0)
+        {
+            rank += subtreeCount(current->left) + 1;
+            current = current->right;
+        }
+        else
+        {
+            current = current->left;
+        }
+    }
+    return rank;
+}
+
+/**
+ * @param tree: a tree with order statistics.
+ * @param k: index of the item in an ascending order, starting at 0.
+ * @return: the k-th smallest item, NULL if k is out of range or on failure.
+ */
+void *selectRBTree(const RBTree *tree, int k)
+{
+    if (tree == NULL || !tree->orderStatistics || k < 0 || k >= tree->size)
+    {
+        return NULL;
+    }
+    Node *current = tree->root;
+    while (current != NULL)
+    {
+        int leftCount = subtreeCount(current->left);
+        if (k < leftCount)
+        {
+            current = current->left;
+        }
+        else if (k == leftCount)
+        {
+            return current->data;
+        }
+        else
+        {
+            k -= leftCount + 1;
+            current = current->right;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @param tree: a tree with order statistics.
+ * @param lo: lowest item of the range (inclusive).
+ * @param hi: the end of the range (exclusive).
+ * @return: the number of items in the range [lo, hi), -1 on failure.
+ */
+int countRangeRBTree(const RBTree *tree, const void *lo, const void *hi)
+{
+    int loRank = rankRBTree(tree, lo);
+    int hiRank = rankRBTree(tree, hi);
+    if (loRank == -1 || hiRank == -1)
+    {
+        return -1;
+    }
+    return hiRank > loRank ? hiRank - loRank : 0;
+}
+
+/**
+ * @param tree: a tree with order statistics.
+ * @return: an item of the tree chosen uniformly at random (using rand()), NULL if the tree is empty or on failure.
+ */
+void *sampleRBTree(const RBTree *tree)
+{
+    if (tree == NULL || tree->size == 0)
+    {
+        return NULL;
+    }
+    // RAND_MAX may be as small as 2^15, so combine two calls to cover any tree size.
+    unsigned long random = (unsigned long) rand() * ((unsigned long) RAND_MAX + 1) + (unsigned long) rand();
+    return selectRBTree(tree, (int) (random % (unsigned long) tree->size));
+}
+
+/**
+ * the aggregate of all the items of a tree, in O(1).
+ * @param tree: a tree with an aggregate.
+ * @param result: where to write the aggregate (RBTreeAggregate::size bytes).
+ * @return: 0 on failure (also if the tree is empty), other on success.
+ */
+int aggregateRBTree(const RBTree *tree, void *result)
+{
+    if (tree == NULL || result == NULL || tree->aggregate.size == 0 || tree->root == NULL)
+    {
+        return FAILURE;
+    }
+    memcpy(result, nodeAggregate(tree, tree->root), tree->aggregate.size);
+    return SUCCESS;
+}
+
+/*
+ * the aggregate of the items of a range, combined in an ascending order as they are found.
+ */
+typedef struct RangeAggregate
+{
+    const RBTree *tree;
+    void *result;
+    int empty; // 1 until the first value is written to result
+} RangeAggregate;
+
+/**
+ * combines a value of items greater than the ones already in the range aggregate into it.
+ * @param range
+ * @param value
+ */
+static void appendToRange(RangeAggregate *range, const void *value)
+{
+    if (range->empty)
+    {
+        memcpy(range->result, value, range->tree->aggregate.size);
+        range->empty = 0;
+    }
+    else
+    {
+        range->tree->aggregate.combine(range->result, value);
+    }
+}
+
+/**
+ * appends the items of a subtree that are in [lo, hi) to the range aggregate. below the node where the paths to lo
+ * and hi part, only one bound is left on each side, and every subtree off the path to it is inside the range, so
+ * O(log n) nodes are visited.
+ * @param range
+ * @param node may be NULL
+ * @param lo lowest item of the range (inclusive), NULL if the range isn't bounded from below
+ * @param hi the end of the range (exclusive), NULL if the range isn't bounded from above
+ */
+static void aggregateSubtreeRange(RangeAggregate *range, const Node *node, const void *lo, const void *hi)
+{
+    const RBTree *tree = range->tree;
+    while (node != NULL)
+    {
+        if (lo == NULL && hi == NULL)
+        {
+            appendToRange(range, nodeAggregate(tree, node));
+            return;
+        }
+        if (lo != NULL && tree->compFunc(node->data, lo) < 0)
+        {
+            node = node->right;
+        }
+        else if (hi != NULL && tree->compFunc(node->data, hi) >= 0)
+        {
+            node = node->left;
+        }
+        else
+        {
+            uint64_t value[RBTREE_MAX_AGGREGATE_SIZE / sizeof(uint64_t)];
+            aggregateSubtreeRange(range, node->left, lo, NULL);
+            tree->aggregate.value(node->data, value);
+            appendToRange(range, value);
+            node = node->right;
+            lo = NULL;
+        }
+    }
+}
+
+/**
+ * the aggregate of the items in the range [lo, hi), in O(log n): the subtrees inside the range are combined whole.
+ * @param tree: a tree with an aggregate.
+ * @param lo: lowest item of the range (inclusive).
+ * @param hi: the end of the range (exclusive).
+ * @param result: where to write the aggregate (RBTreeAggregate::size bytes).
+ * @return: 0 on failure (also if the range is empty), other on success.
+ */
+int aggregateRangeRBTree(const RBTree *tree, const void *lo, const void *hi, void *result)
+{
+    if (tree == NULL || lo == NULL || hi == NULL || result == NULL || tree->aggregate.size == 0)
+    {
+        return FAILURE;
+    }
+    RangeAggregate range = {tree, result, 1};
+    aggregateSubtreeRange(&range, tree->root, lo, hi);
+    return !range.empty;
+}
+
+/**
+ * @param tree: the tree.
+ * @return: the node of the smallest item of the tree, NULL if the tree is empty.
+ */
+Node *rbFirst(const RBTree *tree)
+{
+    return tree != NULL ? tree->first : NULL;
+}
+
+/**
+ * @param tree: the tree.
+ * @return: the node of the largest item of the tree, NULL if the tree is empty.
+ */
+Node *rbLast(const RBTree *tree)
+{
+    return tree != NULL ? tree->last : NULL;
+}
+
+/**
+ * moves a cursor one item forward, using the parent links (no stack, amortized O(1)).
+ * the cursor stays valid as long as its own node isn't removed from the tree.
+ * @param node: the current node.
+ * @return: the node of the next item in an ascending order, NULL after the last one.
+ */
+Node *rbNext(const Node *node)
+{
+    if (node == NULL)
+    {
+        return NULL;
+    }
+    if (node->right != NULL)
+    {
+        return minimumNode(node->right);
+    }
+    while (node->parent != NULL && node->parent->right == node)
+    {
+        node = node->parent;
+    }
+    return node->parent;
+}
+
+/**
+ * moves a cursor one item backward, using the parent links (no stack, amortized O(1)).
+ * @param node: the current node.
+ * @return: the node of the previous item in an ascending order, NULL before the first one.
+ */
+Node *rbPrev(const Node *node)
+{
+    if (node == NULL)
+    {
+        return NULL;
+    }
+    if (node->left != NULL)
+    {
+        node = node->left;
+        while (node->right != NULL)
+        {
+            node = node->right;
+        }
+        return (Node *) node;
+    }
+    while (node->parent != NULL && node->parent->left == node)
+    {
+        node = node->parent;
+    }
+    return node->parent;
+}
+
+/**
+ * Activate a function on each item of the tree. the order is an ascending order. if one of the activations of the
+ * function returns 0, the process stops.
+ * @param tree: the tree with all the items.
+ * @param func: the function to activate on all items.
+ * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @return: 0 on failure, other on success.
+ */
+int forEachRBTree(RBTree *tree, forEachFunc func, void *args)
+{
+    if (tree != NULL && tree->bplus != NULL)
+    {
+        return forEachBPlusTree(tree->bplus, func, args);
+    }
+    if (tree != NULL && tree->compact != NULL)
+    {
+        return forEachCompactRBTree(tree->compact, func, args);
+    }
+    if (tree != NULL && tree->mapped != NULL)
+    {
+        return tree->size > 0 && forEachMappedRBTree(tree->mapped, NULL, NULL, func, args);
+    }
+    if (tree == NULL || tree->root == NULL || func == NULL)
+    {
+        return FAILURE;
+    }
+    for (Node *node = rbFirst(tree); node != NULL; node = rbNext(node))
+    {
+        if (func(node->data, args) == 0)
+        {
+            return FAILURE;
+        }
+    }
+    return SUCCESS;
+}
+
+/*
+ * the state shared by the tasks of a parallel walk.
+ */
+typedef struct ParallelWalk
+{
+    forEachFunc func;
+    void *args; // the args of every call, unless accumulators is set
+    void **accumulators; // the args of the calls of worker w are accumulators[w]
+    int spawnDepth; // nodes above this depth hand their right subtree to the pool, deeper subtrees are walked serially
+    int stopped; // set once func returned 0
+} ParallelWalk;
+
+/**
+ * @param node
+ * @return the distance of node from the root
+ */
+static int nodeDepth(const Node *node)
+{
+    int depth = 0;
+    while (node->parent != NULL)
+    {
+        node = node->parent;
+        depth++;
+    }
+    return depth;
+}
+
+/**
+ * a PoolTaskFunc that walks a subtree: down to spawnDepth it spawns the right subtrees as new tasks and continues
+ * left, and the rest is walked serially in an ascending order.
+ * @param pool the pool, NULL if spawnDepth is 0
+ * @param worker
+ * @param context the ParallelWalk
+ * @param task the root of the subtree
+ */
+static void walkSubtree(ThreadPool *pool, int worker, void *context, void *task)
+{
+    ParallelWalk *walk = (ParallelWalk *) context;
+    Node *node = (Node *) task;
+    void *args = walk->accumulators != NULL ? walk->accumulators[worker] : walk->args;
+    for (int depth = nodeDepth(node); node != NULL && depth < walk->spawnDepth; ++depth)
+    {
+        if (node->right != NULL)
+        {
+            spawnPoolTask(pool, worker, walkSubtree, walk, node->right);
+        }
+        if (__atomic_load_n(&walk->stopped, __ATOMIC_RELAXED) || walk->func(node->data, args) == 0)
+        {
+            __atomic_store_n(&walk->stopped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+        node = node->left;
+    }
+    if (node == NULL)
+    {
+        return;
+    }
+    Node *last = node;
+    while (last->right != NULL)
+    {
+        last = last->right;
+    }
+    for (Node *current = minimumNode(node);; current = rbNext(current))
     {
-        return t2;
+        if (__atomic_load_n(&walk->stopped, __ATOMIC_RELAXED) || walk->func(current->data, args) == 0)
+        {
+            __atomic_store_n(&walk->stopped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+        if (current == last)
+        {
+            return;
+        }
     }
-    return t;
 }
 
 /**
- * Activate a function on each item of the tree. the order is an ascending order. if one of the activations of the
- * function returns 0, the process stops.
+ * walks a non empty red-black tree on a pool of nThreads workers (on the calling thread only if the pool can't be
+ * started).
+ * @param tree
+ * @param walk
+ * @param nThreads
+ * @return 0 if func returned 0 for some item, 1 else
+ */
+static int runParallelWalk(RBTree *tree, ParallelWalk *walk, int nThreads)
+{
+    ThreadPool *pool = nThreads > 1 ? newThreadPool(nThreads) : NULL;
+    if (pool == NULL)
+    {
+        walkSubtree(NULL, 0, walk, tree->root);
+        return !walk->stopped;
+    }
+    // enough tasks for the workers to balance uneven subtrees by stealing.
+    while ((1 << walk->spawnDepth) < PARALLEL_TASKS_PER_THREAD * threadPoolSize(pool))
+    {
+        walk->spawnDepth++;
+    }
+    runThreadPool(pool, walkSubtree, walk, tree->root);
+    freeThreadPool(pool);
+    return !walk->stopped;
+}
+
+/**
+ * Activate a function on each item of the tree, on up to nThreads threads: the tree is split into subtrees that a
+ * work-stealing pool walks in parallel. the order is unspecified and func must be thread safe. if one of the
+ * activations of the function returns 0, the process stops (items that other threads are already at may still be
+ * visited). other engines than the red-black one are walked serially.
  * @param tree: the tree with all the items.
  * @param func: the function to activate on all items.
- * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @param args: more optional arguments to the function, shared by all the threads.
+ * @param nThreads: maximal number of threads to use (including the calling one).
  * @return: 0 on failure, other on success.
  */
-int forEachRBTree(RBTree *tree, forEachFunc func, void *args)
+int parallelForEachRBTree(RBTree *tree, forEachFunc func, void *args, int nThreads)
+{
+    if (tree == NULL || tree->root == NULL || func == NULL)
+    {
+        return forEachRBTree(tree, func, args);
+    }
+    ParallelWalk walk = {func, args, NULL, 0, 0};
+    return runParallelWalk(tree, &walk, nThreads);
+}
+
+/**
+ * reduce the items of the tree on up to nThreads threads. the thread that is worker w of the pool calls
+ * func(item, accumulators[w]), so func needs no locking. afterwards every accumulator is merged into accumulators[0]
+ * with combine. the reduction must be associative and commutative (the items reach the accumulators in an
+ * unspecified order), and each accumulator must start as the identity of the reduction.
+ * @param tree: the tree with all the items.
+ * @param func: accumulates one item into its args.
+ * @param accumulators: nThreads accumulators. the result is in accumulators[0].
+ * @param combine: merges one accumulator into another.
+ * @param nThreads: maximal number of threads to use (including the calling one).
+ * @return: 0 on failure, other on success.
+ */
+int parallelReduceRBTree(RBTree *tree, forEachFunc func, void *accumulators[], CombineFunc combine, int nThreads)
 {
-    if (tree->root == NULL || func == NULL)
+    if (tree == NULL || func == NULL || accumulators == NULL || combine == NULL || nThreads < 1)
     {
         return FAILURE;
     }
+    if (tree->root == NULL)
+    {
+        return forEachRBTree(tree, func, accumulators[0]);
+    }
+    ParallelWalk walk = {func, NULL, accumulators, 0, 0};
+    int result = runParallelWalk(tree, &walk, nThreads);
+    for (int i = 1; i < nThreads && result; ++i)
+    {
+        result = combine(accumulators[0], accumulators[i]) != 0;
+    }
+    return result;
+}
+
+/*
+ * the set operations of the red-black engine.
+ */
+typedef enum SetOperation
+{
+    SET_UNION, SET_INTERSECTION, SET_DIFFERENCE
+} SetOperation;
+
+/*
+ * the state shared by the tasks of a set operation. the recursion follows the nodes of one tree, the driving one, and
+ * cuts the other tree at their items.
+ */
+typedef struct SetJoin
+{
+    const RBTree *driver, *other;
+    int driverIsA; // the item of a is kept when both trees have equal items
+    int keepDriver, keepOther, keepBoth; // keep the items only in the driving tree / only in the other / in both
+    RBTree *result; // the new tree. the tasks join their nodes with its functions, its fields are set at the end.
+    int spawnDepth; // driving nodes above this depth recurse on the pool, deeper ones serially
+    int size; // the nodes of the result
+    int failed; // set once an allocation failed
+} SetJoin;
+
+/*
+ * one step of the parallel recursion: a subtree of the driving tree, and the items of the other tree in its range. a
+ * task that splits has two children, and the one that finishes last joins their results.
+ */
+typedef struct SetTask
+{
+    const Node *node; // the subtree of the driving tree
+    const void *lo, *hi; // the range (lo, hi) of the subtree. NULL lo/hi: no lower/upper limit.
+    Node *top; // the highest node of the other tree in the range, NULL if there is none
+    int depth;
+    struct SetTask *parent;
+    struct SetTask *children; // the tasks of the left and the right subtrees
+    int pending; // the children that didn't finish yet
+    Node *kept; // the node of the result for the item of node, NULL if it's dropped
+    Subtree result;
+} SetTask;
+
+/**
+ * allocates a node of the result of a set operation. the tasks share the result tree, so its free list and pool are
+ * left alone, and it's a plain new tree: its nodes have no prefix or aggregate to fill.
+ * @param tree the result
+ * @param data
+ * @return the node, NULL on failure
+ */
+static Node *newResultNode(RBTree *tree, void *data)
+{
+    Node *node = malloc((size_t) tree->nodeSize);
+    if (node == NULL)
+    {
+        return NULL;
+    }
+    COUNT_STAT(tree, allocations, 1);
+    node->data = data;
+    node->color = RED;
+    node->count = 1;
+    node->right = NULL;
+    node->left = NULL;
+    node->parent = NULL;
+    return node;
+}
+
+/**
+ * @param tree
+ * @param node a subtree of tree, may be NULL
+ * @param lo the start of a range, NULL if it has none
+ * @param hi the end of a range, NULL if it has none
+ * @param atLo out, the node met on the way whose item equals lo (untouched if there is none)
+ * @param atHi out, the node met on the way whose item equals hi (untouched if there is none)
+ * @return the highest node of the subtree whose item is in the range (lo, hi), NULL if there is none
+ */
+static Node *rangeTop(const RBTree *tree, Node *node, const void *lo, const void *hi, Node **atLo, Node **atHi)
+{
+    while (node != NULL)
+    {
+        // the walk is bound by cache misses: load both children while the item is compared.
+        __builtin_prefetch(node->left);
+        __builtin_prefetch(node->right);
+        int compLo = lo != NULL ? tree->compFunc(node->data, lo) : GREATER;
+        int compHi = compLo > 0 && hi != NULL ? tree->compFunc(node->data, hi) : LESS;
+        if (compLo <= 0)
+        {
+            *atLo = compLo == 0 ? node : *atLo;
+            node = node->right;
+        }
+        else if (compHi >= 0)
+        {
+            *atHi = compHi == 0 ? node : *atHi;
+            node = node->left;
+        }
+        else
+        {
+            return node;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @param tree
+ * @param node a subtree of tree, may be NULL
+ * @param data
+ * @return the node of the subtree holding an item equal to data, NULL if there is none
+ */
+static Node *searchSubtree(const RBTree *tree, Node *node, const void *data)
+{
+    while (node != NULL)
+    {
+        __builtin_prefetch(node->left);
+        __builtin_prefetch(node->right);
+        int comp = tree->compFunc(node->data, data);
+        if (comp == 0)
+        {
+            return node;
+        }
+        node = comp > 0 ? node->left : node->right;
+    }
+    return NULL;
+}
+
+/**
+ * splits the items of a tree in a range at an item, without changing the tree: only the highest node of each side
+ * is found, along about one path down from the top of the range.
+ * @param tree
+ * @param top the highest node of tree in the range (lo, hi)
+ * @param data an item in the range
+ * @param lo the start of the range, NULL if it has none
+ * @param hi the end of the range, NULL if it has none
+ * @param lower out, the highest node of tree in (lo, data), NULL if there is none
+ * @param higher out, the highest node of tree in (data, hi), NULL if there is none
+ * @return the node of tree holding an item equal to data, NULL if there is none
+ */
+static Node *splitRange(const RBTree *tree, Node *top, const void *data, const void *lo, const void *hi,
+                        Node **lower, Node **higher)
+{
+    Node *equal = NULL, *unused = NULL;
+    int comp = tree->compFunc(top->data, data);
+    if (comp == 0)
+    {
+        *lower = rangeTop(tree, top->left, lo, NULL, &unused, &unused);
+        *higher = rangeTop(tree, top->right, NULL, hi, &unused, &unused);
+        return top;
+    }
+    // the path to the top of the other side passes the item equal to data, or else it is below that top.
+    if (comp < 0)
+    {
+        *lower = top;
+        *higher = rangeTop(tree, top->right, data, hi, &equal, &unused);
+        return equal != NULL || *higher == NULL ? equal : searchSubtree(tree, (*higher)->left, data);
+    }
+    *higher = top;
+    *lower = rangeTop(tree, top->left, lo, data, &unused, &equal);
+    return equal != NULL || *lower == NULL ? equal : searchSubtree(tree, (*lower)->right, data);
+}
+
+/**
+ * copies the nodes of a subtree with their colors.
+ * @param tree the tree of the copies
+ * @param node may be NULL
+ * @param size counts the copies
+ * @param failed set if an allocation failed
+ * @return the copy, partial if an allocation failed
+ */
+static Node *copyNodes(RBTree *tree, const Node *node, int *size, int *failed)
+{
+    if (node == NULL || *failed)
+    {
+        return NULL;
+    }
+    Node *copy = newResultNode(tree, node->data);
+    if (copy == NULL)
+    {
+        *failed = 1;
+        return NULL;
+    }
+    (*size)++;
+    copy->color = node->color;
+    copy->left = copyNodes(tree, node->left, size, failed);
+    copy->right = copyNodes(tree, node->right, size, failed);
+    if (copy->left != NULL)
+    {
+        copy->left->parent = copy;
+    }
+    if (copy->right != NULL)
+    {
+        copy->right->parent = copy;
+    }
+    return copy;
+}
+
+/**
+ * @param tree the tree of the copies
+ * @param node may be NULL
+ * @param size counts the copies
+ * @param failed set if an allocation failed
+ * @return a copy of the subtree of node, empty on failure
+ */
+static Subtree copySubtree(RBTree *tree, const Node *node, int *size, int *failed)
+{
+    Node *copy = copyNodes(tree, node, size, failed);
+    if (*failed)
+    {
+        freeNodesRecursive(copy);
+        return detachSubtree(NULL, 0);
+    }
+    return detachSubtree(copy, blackHeight(node));
+}
+
+/**
+ * joins two results and the node between them, or concatenates them if there is no such node. on failure they are
+ * freed instead.
+ * @param tree the tree of the nodes (its root isn't used)
+ * @param left
+ * @param node a detached node, NULL if there is none
+ * @param right
+ * @param failed
+ * @return the joined subtree, empty on failure
+ */
+static Subtree joinResults(RBTree *tree, Subtree left, Node *node, Subtree right, int failed)
+{
+    if (failed)
+    {
+        freeNodesRecursive(left.root);
+        freeNodesRecursive(right.root);
+        free(node);
+        return detachSubtree(NULL, 0);
+    }
+    if (node == NULL && left.root != NULL && right.root != NULL)
+    {
+        left = splitLastNode(tree, left.root, left.height, &node);
+    }
+    if (node == NULL)
+    {
+        return left.root != NULL ? left : right;
+    }
+    return joinSubtrees(tree, left, node, right);
+}
+
+/**
+ * copies the items of a tree in a range into a new subtree: the subtrees that are inside the range are copied as
+ * they are, and joined along the two paths to its ends.
+ * @param other the tree of the items
+ * @param tree the tree of the copies
+ * @param top the highest node of other in the range (lo, hi), NULL if there is none
+ * @param lo the start of the range, NULL if it has none
+ * @param hi the end of the range, NULL if it has none
+ * @param size counts the copies
+ * @param failed set if an allocation failed
+ * @return the copy, empty on failure
+ */
+static Subtree copyRange(const RBTree *other, RBTree *tree, Node *top, const void *lo, const void *hi, int *size,
+                         int *failed)
+{
+    if (top == NULL || *failed)
+    {
+        return detachSubtree(NULL, 0);
+    }
+    if (lo == NULL && hi == NULL)
+    {
+        return copySubtree(tree, top, size, failed);
+    }
+    Node *unused = NULL;
+    Subtree left = copyRange(other, tree, rangeTop(other, top->left, lo, NULL, &unused, &unused), lo, NULL, size,
+                             failed);
+    Subtree right = copyRange(other, tree, rangeTop(other, top->right, NULL, hi, &unused, &unused), NULL, hi, size,
+                              failed);
+    Node *copy = *failed ? NULL : newResultNode(tree, top->data);
+    *failed = *failed || copy == NULL;
+    *size += copy != NULL;
+    return joinResults(tree, left, copy, right, *failed);
+}
+
+/**
+ * @param join
+ * @param tree the tree of the result
+ * @param node a driving node
+ * @param equal the node of the other tree with an equal item, NULL if there is none
+ * @param size counts the new node
+ * @param failed set if an allocation failed
+ * @return a new node for the item of node in the result, NULL if the operation drops it (or on failure)
+ */
+static Node *keptNode(const SetJoin *join, RBTree *tree, const Node *node, const Node *equal, int *size, int *failed)
+{
+    if (*failed || !(equal != NULL ? join->keepBoth : join->keepDriver))
+    {
+        return NULL;
+    }
+    Node *kept = newResultNode(tree, equal != NULL && !join->driverIsA ? equal->data : node->data);
+    *failed = kept == NULL;
+    *size += kept != NULL;
+    return kept;
+}
+
+/**
+ * the serial recursion: the other tree is split at the item of the driving node, both sides recurse, and their
+ * results are joined with a copy of that node if the operation keeps it. a side that only one tree has items in is
+ * copied or dropped as a whole.
+ * @param join
+ * @param tree the tree of the result
+ * @param node a subtree of the driving tree, may be NULL
+ * @param lo the start of the range of the subtree, NULL if it has none
+ * @param hi the end of the range of the subtree, NULL if it has none
+ * @param top the highest node of the other tree in the range, NULL if there is none
+ * @param size counts the nodes of the result
+ * @param failed set if an allocation failed
+ * @return the result of the operation in the range, empty on failure
+ */
+static Subtree setSubtree(const SetJoin *join, RBTree *tree, const Node *node, const void *lo, const void *hi,
+                          Node *top, int *size, int *failed)
+{
+    if (*failed || (node == NULL && top == NULL))
+    {
+        return detachSubtree(NULL, 0);
+    }
+    if (top == NULL)
+    {
+        return join->keepDriver ? copySubtree(tree, node, size, failed) : detachSubtree(NULL, 0);
+    }
+    if (node == NULL)
+    {
+        return join->keepOther ? copyRange(join->other, tree, top, lo, hi, size, failed) : detachSubtree(NULL, 0);
+    }
+    Node *lower, *higher;
+    __builtin_prefetch(node->left);
+    __builtin_prefetch(node->right);
+    Node *equal = splitRange(join->other, top, node->data, lo, hi, &lower, &higher);
+    Subtree left = setSubtree(join, tree, node->left, lo, node->data, lower, size, failed);
+    Subtree right = setSubtree(join, tree, node->right, node->data, hi, higher, size, failed);
+    Node *kept = keptNode(join, tree, node, equal, size, failed);
+    return joinResults(tree, left, kept, right, *failed);
+}
+
+/**
+ * hands the result of a task to its parent. the last of two children to finish joins their results, and so on up.
+ * @param join
+ * @param task
+ * @param size the nodes the task allocated
+ * @param failed
+ */
+static void finishSetTask(SetJoin *join, SetTask *task, int size, int failed)
+{
+    __atomic_add_fetch(&join->size, size, __ATOMIC_RELAXED);
+    if (failed)
+    {
+        __atomic_store_n(&join->failed, 1, __ATOMIC_RELAXED);
+    }
+    for (SetTask *parent = task->parent; parent != NULL; parent = parent->parent)
+    {
+        if (__atomic_sub_fetch(&parent->pending, 1, __ATOMIC_ACQ_REL) != 0)
+        {
+            return;
+        }
+        parent->result = joinResults(join->result, parent->children[0].result, parent->kept, parent->children[1].result,
+                                     __atomic_load_n(&join->failed, __ATOMIC_RELAXED));
+        free(parent->children);
+    }
+}
+
+/**
+ * a PoolTaskFunc of the recursion: down to spawnDepth a driving node splits the other tree, spawns its left subtree
+ * as a new task and continues with the right one. deeper subtrees recurse serially.
+ * @param pool the pool, NULL if spawnDepth is 0
+ * @param worker
+ * @param context the SetJoin
+ * @param task the SetTask
+ */
+static void runSetTask(ThreadPool *pool, int worker, void *context, void *task)
+{
+    SetJoin *join = (SetJoin *) context;
+    SetTask *current = (SetTask *) task;
+    int size = 0, failed = __atomic_load_n(&join->failed, __ATOMIC_RELAXED);
+    const Node *node = current->node;
+    SetTask *children = NULL;
+    if (current->depth < join->spawnDepth && node != NULL && current->top != NULL && !failed)
+    {
+        children = calloc(2, sizeof(SetTask));
+    }
+    if (children == NULL)
+    {
+        current->result = setSubtree(join, join->result, node, current->lo, current->hi, current->top, &size, &failed);
+        finishSetTask(join, current, size, failed);
+        return;
+    }
+    Node *lower, *higher;
+    Node *equal = splitRange(join->other, current->top, node->data, current->lo, current->hi, &lower, &higher);
+    current->kept = keptNode(join, join->result, node, equal, &size, &failed);
+    children[0] = (SetTask) {node->left, current->lo, node->data, lower, current->depth + 1, current, NULL, 0, NULL,
+                             {NULL, 0}};
+    children[1] = (SetTask) {node->right, node->data, current->hi, higher, current->depth + 1, current, NULL, 0, NULL,
+                             {NULL, 0}};
+    current->children = children;
+    current->pending = 2;
+    __atomic_add_fetch(&join->size, size, __ATOMIC_RELAXED);
+    if (failed)
+    {
+        __atomic_store_n(&join->failed, 1, __ATOMIC_RELAXED);
+    }
+    spawnPoolTask(pool, worker, runSetTask, join, &children[0]);
+    runSetTask(pool, worker, join, &children[1]);
+}
+
+/**
+ * runs a set operation as a join-based recursion: the driving tree is walked from its root, the other tree is split
+ * at each of its items, and the results of both sides are joined, so the inputs are only read and the result is
+ * made of new nodes. the recursion spawns its first levels on a work-stealing pool.
+ * union and difference keep whole subtrees of the driving tree, so it's the larger tree (a, for a difference), and
+ * an intersection follows the smaller tree.
+ * @param a
+ * @param b
+ * @param operation
+ * @param freeFunc the FreeFunc of the new tree
+ * @param nThreads
+ * @return the new tree, NULL on failure
+ */
+static RBTree *runSetOperation(const RBTree *a, const RBTree *b, SetOperation operation, FreeFunc freeFunc,
+                               int nThreads)
+{
+    if (a == NULL || b == NULL || freeFunc == NULL || a->compFunc != b->compFunc || a->bplus != NULL ||
+        a->compact != NULL || a->mapped != NULL || b->bplus != NULL || b->compact != NULL || b->mapped != NULL)
+    {
+        return NULL;
+    }
+    RBTree *result = newRBTree(a->compFunc, freeFunc);
+    if (result == NULL)
+    {
+        return NULL;
+    }
+    const RBTree *driver = operation == SET_DIFFERENCE || (operation == SET_UNION) == (a->size >= b->size) ? a : b;
+    SetJoin join = {driver, driver == a ? b : a, driver == a, operation != SET_INTERSECTION, operation == SET_UNION,
+                    operation != SET_DIFFERENCE, result, 0, 0, 0};
+    SetTask root = {driver->root, NULL, NULL, join.other->root, 0, NULL, NULL, 0, NULL, {NULL, 0}};
+    ThreadPool *pool = nThreads > 1 ? newThreadPool(nThreads) : NULL;
+    if (pool != NULL)
+    {
+        // enough tasks for the workers to balance uneven subtrees by stealing.
+        while ((1 << join.spawnDepth) < PARALLEL_TASKS_PER_THREAD * threadPoolSize(pool))
+        {
+            join.spawnDepth++;
+        }
+        runThreadPool(pool, runSetTask, &join, &root);
+        freeThreadPool(pool);
+    }
     else
     {
-        return forEachRBTreeRecursive(tree->root, func, args);
+        runSetTask(NULL, 0, &join, &root);
     }
+    if (join.failed)
+    {
+        freeNodesRecursive(root.result.root);
+        freeRBTree(result);
+        return NULL;
+    }
+    result->root = root.result.root;
+    result->size = join.size;
+    findEnds(result);
+    return result;
+}
+
+/**
+ * the items that are in a or in b (the item of a, if both have equal ones), as a new tree. the larger tree is split
+ * at the items of the smaller one and the parts are joined back (recursing on up to nThreads threads), so for m items
+ * in the smaller tree and n in the larger it costs O(m log(n / m + 1)) comparisons, plus copying the nodes of the
+ * result. the trees are not changed. red-black engine only, and both trees must have the same CompareFunc.
+ * @param a: a tree.
+ * @param b: a tree.
+ * @param freeFunc: the FreeFunc of the new tree. its items are the items of a and b, so this is usually a function
+ * that doesn't free them.
+ * @param nThreads: maximal number of threads to use (including the calling one).
+ * @return: the new tree, NULL on failure.
+ */
+RBTree *unionRBTree(const RBTree *a, const RBTree *b, FreeFunc freeFunc, int nThreads)
+{
+    return runSetOperation(a, b, SET_UNION, freeFunc, nThreads);
+}
+
+/**
+ * the items of a that are also in b, as a new tree. the larger tree is split at the items of the smaller one and
+ * the parts are joined back (recursing on up to nThreads threads), so for m items in the smaller tree and n in the
+ * larger it costs O(m log(n / m + 1)). the trees are not changed. red-black engine only, and both trees must have the
+ * same CompareFunc.
+ * @param a: a tree.
+ * @param b: a tree.
+ * @param freeFunc: the FreeFunc of the new tree. its items are the items of a, so this is usually a function that
+ * doesn't free them.
+ * @param nThreads: maximal number of threads to use (including the calling one).
+ * @return: the new tree, NULL on failure.
+ */
+RBTree *intersectRBTree(const RBTree *a, const RBTree *b, FreeFunc freeFunc, int nThreads)
+{
+    return runSetOperation(a, b, SET_INTERSECTION, freeFunc, nThreads);
+}
+
+/**
+ * the items of a that are not in b, as a new tree. b is split at the items of a and the parts are joined back
+ * (recursing on up to nThreads threads), so for m items in the smaller tree and n in the larger it costs
+ * O(m log(n / m + 1)) comparisons, plus copying the nodes of the result. the trees are not changed. red-black engine
+ * only, and both trees must have the same CompareFunc.
+ * @param a: a tree.
+ * @param b: a tree.
+ * @param freeFunc: the FreeFunc of the new tree. its items are the items of a, so this is usually a function that
+ * doesn't free them.
+ * @param nThreads: maximal number of threads to use (including the calling one).
+ * @return: the new tree, NULL on failure.
+ */
+RBTree *differenceRBTree(const RBTree *a, const RBTree *b, FreeFunc freeFunc, int nThreads)
+{
+    return runSetOperation(a, b, SET_DIFFERENCE, freeFunc, nThreads);
+}
+
+/**
+ * @param tree: a red-black engine tree.
+ * @return: the counters of the tree since it was created or last reset, and its current black height.
+ */
+RBTreeStats getRBTreeStats(const RBTree *tree)
+{
+    RBTreeStats stats = {0};
+    if (tree == NULL)
+    {
+        return stats;
+    }
+#ifdef RBTREE_STATS
+    stats = tree->stats;
+    stats.enabled = 1;
+#endif
+    stats.blackHeight = blackHeight(tree->root);
+    return stats;
+}
+
+/**
+ * zero the counters of the tree and of its Bloom filter.
+ * @param tree: a red-black engine tree.
+ */
+void resetRBTreeStats(RBTree *tree)
+{
+    if (tree == NULL)
+    {
+        return;
+    }
+#ifdef RBTREE_STATS
+    RBTreeStats zero = {0};
+    tree->stats = zero;
+#endif
+    RBTreeBloomStats zeroBloom = {0};
+    tree->bloomStats = zeroBloom;
+}
+
+/**
+ * @param tree: a tree created with a HashFunc, of any engine.
+ * @return: the counters of its Bloom filter since the tree was created or its stats were last reset (all 0 if the
+ * tree has no filter).
+ */
+RBTreeBloomStats getRBTreeBloomStats(const RBTree *tree)
+{
+    RBTreeBloomStats stats = {0};
+    if (tree == NULL || tree->bloom == NULL)
+    {
+        return stats;
+    }
+    stats = tree->bloomStats;
+    long misses = stats.filtered + stats.falsePositives;
+    stats.falsePositiveRate = misses > 0 ? (double) stats.falsePositives / (double) misses : 0;
+    stats.bits = bloomFilterBits(tree->bloom);
+    return stats;
 }
 
 /**
@@ -446,13 +3385,59 @@ static void freeTreeRecursive(Node *root, FreeFunc freeFunc)
     free(root);
 }
 
+/**
+ * frees the data of a node carved from the tree's pool. free nodes are recognized by their NULL data.
+ * @param object a node of the pool
+ * @param freeFunc the free func
+ */
+static void freePooledNodeData(void *object, void *freeFunc)
+{
+    Node *node = (Node *) object;
+    if (node->data != NULL)
+    {
+        (*(FreeFunc *) freeFunc)(node->data);
+    }
+}
+
 /**
  * free all memory of the data structure.
  * @param tree: the tree to free.
  */
 void freeRBTree(RBTree *tree)
 {
-    freeTreeRecursive(tree->root, tree->freeFunc);
+    if (tree == NULL)
+    {
+        return;
+    }
+    if (tree->bplus != NULL)
+    {
+        freeBPlusTree(tree->bplus, tree->freeFunc);
+    }
+    else if (tree->compact != NULL)
+    {
+        freeCompactRBTree(tree->compact, tree->freeFunc);
+    }
+    else if (tree->mapped != NULL)
+    {
+        freeMappedRBTree(tree->mapped);
+    }
+    else if (tree->pool != NULL)
+    {
+        // walk the slabs in memory order instead of chasing the tree, then drop them whole.
+        forEachNodePool(tree->pool, freePooledNodeData, &tree->freeFunc);
+        freeNodePool(tree->pool);
+    }
+    else
+    {
+        freeTreeRecursive(tree->root, tree->freeFunc);
+        while (tree->freeNodes != NULL)
+        {
+            Node *next = tree->freeNodes->parent;
+            free(tree->freeNodes);
+            tree->freeNodes = next;
+        }
+    }
+    freeBloomFilter(tree->bloom);
     tree->root = NULL;
     free(tree);
 }
\ No newline at end of file
@@ -5,6 +5,13 @@
 #ifndef RBTREE_RBTREE_H
 #define RBTREE_RBTREE_H
 
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 // a color of a Node.
 typedef enum Color
 {
@@ -18,6 +25,30 @@ typedef enum Color
  */
 typedef int (*CompareFunc)(const void *a, const void *b);
 
+/**
+ * a function to compare a lookup key to a tree item, for lookups that don't build a whole item.
+ * @key: a key, of whatever type the function expects (e.g. the char * name of a product).
+ * @data: an item of the tree.
+ * @return: equal to 0 iff the key matches data. lower than 0 if the key sorts before data. Greater than 0 iff it
+ * sorts after data. must agree with the CompareFunc of the tree.
+ */
+typedef int (*KeyCompareFunc)(const void *key, const void *data);
+
+/**
+ * a function to map an item to an order preserving 8 byte prefix of it: if prefix(a) < prefix(b) then a < b, so equal
+ * items have equal prefixes. equal prefixes say nothing about the order of the items.
+ * @data: an item of the tree.
+ * @return: the prefix of data.
+ */
+typedef uint64_t (*PrefixFunc)(const void *data);
+
+/**
+ * a function to hash an item, for the Bloom filter of a tree.
+ * @data: an item of the tree, or an item to look for.
+ * @return: the hash of data. items that are equal by the CompareFunc must have equal hashes.
+ */
+typedef uint64_t (*HashFunc)(const void *data);
+
 /**
  * a function to apply on all tree items.
  * @object: a pointer to an item of the tree.
@@ -26,6 +57,29 @@ typedef int (*CompareFunc)(const void *a, const void *b);
  */
 typedef int (*forEachFunc)(const void *object, void *args);
 
+/**
+ * a function to merge two partial results of a reduction.
+ * @into: the result to merge into.
+ * @from: the result to merge into it.
+ * @return: 0 on failure, other on success.
+ */
+typedef int (*CombineFunc)(void *into, const void *from);
+
+/**
+ * a function to compute the aggregate value of one item, for the subtree aggregates of a tree.
+ * @data: an item of the tree.
+ * @value: where to write the value of data (RBTreeAggregate::size bytes).
+ */
+typedef void (*AggregateValueFunc)(const void *data, void *value);
+
+/**
+ * an associative function to combine two aggregate values: into becomes into + from, where the items of from are all
+ * greater than the items of into (so the function need not be commutative, e.g. "the leftmost maximum").
+ * @into: the aggregate of the lower items, and the result.
+ * @from: the aggregate of the greater items.
+ */
+typedef void (*AggregateCombineFunc)(void *into, const void *from);
+
 /**
  * a function to free a data item
  * @object: a pointer to an item of the tree.
@@ -39,19 +93,121 @@ typedef struct Node
 {
 	struct Node *parent, *left, *right;
 	Color color;
+	int count; // number of items in the subtree. kept up to date only in trees with order statistics or aggregates.
 	void *data;
 
 } Node;
 
+/**
+ * the data structure behind a tree.
+ */
+typedef enum RBTreeEngine
+{
+	RED_BLACK_ENGINE, // the red-black tree of Nodes. supports every function of this header.
+	BPLUS_ENGINE, // a B+ tree with cache line sized nodes (see BPlusTree.h). supports newRBTreeWithOptions,
+	              // addToRBTree, containsRBTree, findRBTree, forEachRBTree and freeRBTree only.
+	COMPACT_ENGINE // a red-black tree of 24 byte nodes linked by 32 bit indices (see CompactRBTree.h). supports the
+	               // same functions as BPLUS_ENGINE.
+} RBTreeEngine;
+
+/**
+ * the largest aggregate value a tree can keep in its nodes, in bytes.
+ */
+#define RBTREE_MAX_AGGREGATE_SIZE (64)
+
+/**
+ * describes the aggregate a tree keeps for every subtree (a monoid over its items): the aggregate of a subtree is the
+ * values of its items, combined in an ascending order.
+ */
+typedef struct RBTreeAggregate
+{
+	size_t size; // bytes of a value, at most RBTREE_MAX_AGGREGATE_SIZE
+	AggregateValueFunc value;
+	AggregateCombineFunc combine;
+} RBTreeAggregate;
+
+/**
+ * optional features of a tree. a zeroed struct gives the same tree newRBTree does.
+ */
+typedef struct RBTreeOptions
+{
+	RBTreeEngine engine;
+	int usePool; // allocate nodes from slabs of a NodePool instead of one malloc per node.
+	int orderStatistics; // maintain subtree sizes for rank/select queries (costs O(log n) per insert/remove).
+	KeyCompareFunc keyCompFunc; // enables containsKeyRBTree and findKeyRBTree. may be NULL.
+	PrefixFunc prefixFunc; // keep the prefix of each item in its node, so descents call compFunc only when the
+	                       // prefixes are equal (red-black engine). may be NULL.
+	HashFunc hashFunc; // keep a Bloom filter of the items, so containsRBTree answers most misses without a descent.
+	                   // may be NULL.
+	int expectedSize; // the number of items the Bloom filter is sized for. the filter is rebuilt twice as large
+	                  // when the tree outgrows it.
+	const RBTreeAggregate *aggregate; // keep the aggregate of each subtree in its root, for aggregateRBTree and
+	                                  // aggregateRangeRBTree (red-black engine, costs O(log n) values per
+	                                  // insert/remove). may be NULL.
+} RBTreeOptions;
+
+/**
+ * number of depths in the descent histogram of RBTreeStats. deeper descents are counted in the last one.
+ */
+#define RBTREE_STATS_DEPTHS (64)
+
+/**
+ * counters of the work done inside a red-black engine tree. the counters are kept only when the library and its users
+ * are compiled with -DRBTREE_STATS; otherwise they are always 0 and counting costs nothing.
+ */
+typedef struct RBTreeStats
+{
+	long comparisons; // items compared by the insert descents (by compFunc, or by the prefixes of a PrefixFunc)
+	long descents; // insert descents (including the ones that found an equal item)
+	long rotations; // single rotations (rotateLeft/rotateRight) of inserts and removes
+	long doubleRotations; // inserts fixed with a double rotation (stringItLeft/stringItRight and a rotation)
+	long recolorings; // red uncles recolored by fixTree
+	long allocations; // nodes allocated with malloc or from the pool (reused removed nodes are not counted)
+	long depthHistogram[RBTREE_STATS_DEPTHS]; // depthHistogram[d]: insert descents that compared d items
+	int blackHeight; // black nodes on every path from the root to a leaf. computed also without RBTREE_STATS.
+	int enabled; // 1 if the library was compiled with RBTREE_STATS
+} RBTreeStats;
+
+/**
+ * counters of the Bloom filter of a tree created with a HashFunc.
+ */
+typedef struct RBTreeBloomStats
+{
+	long queries; // containsRBTree calls
+	long filtered; // queries the filter answered with a miss, without touching the tree
+	long falsePositives; // queries the filter passed but the tree missed
+	double falsePositiveRate; // falsePositives / (filtered + falsePositives): the share of misses that reached the tree
+	long bits; // the current size of the filter
+} RBTreeBloomStats;
+
 /**
  * represents the tree
  */
 typedef struct RBTree
 {
 	Node *root;
+	Node *first, *last; // the nodes of the smallest and the largest items, NULL if the tree is empty.
 	CompareFunc compFunc;
 	FreeFunc freeFunc;
 	int size;
+	struct NodePool *pool; // NULL if nodes are allocated with malloc.
+	Node *freeNodes; // removed nodes kept for reuse by the next inserts (linked through parent).
+	int orderStatistics; // 1 if Node::count is maintained.
+	struct BPlusTree *bplus; // the items of a BPLUS_ENGINE tree (root is always NULL in such a tree).
+	struct CompactRBTree *compact; // the items of a COMPACT_ENGINE tree (root is always NULL in such a tree).
+	struct MappedRBTree *mapped; // the items of a tree opened by mapRBTree (root is always NULL in such a tree).
+	KeyCompareFunc keyCompFunc; // NULL if the tree has no key lookups.
+	PrefixFunc prefixFunc; // NULL if the nodes keep no prefix.
+	int nodeSize; // bytes per node: a Node, followed by the prefix of its item if the tree has a PrefixFunc, and by
+	              // the aggregate of its subtree if the tree has one.
+	RBTreeAggregate aggregate; // the size is 0 if the nodes keep no aggregate.
+	int aggregateOffset; // where the aggregate of a node starts, from the beginning of the node.
+	HashFunc hashFunc; // NULL if the tree has no Bloom filter.
+	struct BloomFilter *bloom; // a filter of every item added to the tree (removed items stay in it until it grows).
+	RBTreeBloomStats bloomStats; // the counters of the filter (bits and falsePositiveRate are left 0 here).
+#ifdef RBTREE_STATS
+	RBTreeStats stats;
+#endif
 } RBTree;
 
 /**
@@ -60,6 +216,37 @@ typedef struct RBTree
  */
 RBTree *newRBTree(CompareFunc compFunc, FreeFunc freeFunc); // implement it in RBTree.c
 
+/**
+ * constructs a new RBTree with the given CompareFunc and optional features.
+ * @param compFunc: a function two compare two variables.
+ * @param freeFunc: a function to free a data item.
+ * @param options: the features to enable, may be NULL.
+ * @return: the new tree, NULL on failure.
+ */
+RBTree *newRBTreeWithOptions(CompareFunc compFunc, FreeFunc freeFunc, const RBTreeOptions *options);
+
+/**
+ * constructs a new RBTree from items that are already sorted in a strictly ascending order, in O(n) and without
+ * calling compFunc. the items must not contain duplicates.
+ * @param data: the items, sorted by compFunc.
+ * @param n: number of items.
+ * @param compFunc: a function two compare two variables.
+ * @param freeFunc: a function to free a data item.
+ * @return: the new tree, NULL on failure (the items are not freed in that case).
+ */
+RBTree *buildRBTreeFromSorted(void *data[], int n, CompareFunc compFunc, FreeFunc freeFunc);
+
+/**
+ * same as buildRBTreeFromSorted, but builds disjoint subtrees on up to nThreads threads.
+ * @param data: the items, sorted by compFunc.
+ * @param n: number of items.
+ * @param compFunc: a function two compare two variables.
+ * @param freeFunc: a function to free a data item.
+ * @param nThreads: maximal number of threads to use (including the calling one).
+ * @return: the new tree, NULL on failure (the items are not freed in that case).
+ */
+RBTree *buildRBTreeFromSortedParallel(void *data[], int n, CompareFunc compFunc, FreeFunc freeFunc, int nThreads);
+
 /**
  * add an item to the tree
  * @param tree: the tree to add an item to.
@@ -69,13 +256,122 @@ RBTree *newRBTree(CompareFunc compFunc, FreeFunc freeFunc); // implement it in R
 int addToRBTree(RBTree *tree, void *data); // implement it in RBTree.c
 
 /**
- * check whether the tree contains this item.
+ * add an item next to a node whose item is close to it, in O(1) amortized if data goes right before or after the
+ * item of the hint, and with a regular descent otherwise. red-black engine only.
+ * addToRBTree itself links an item that is larger than all the items (or smaller than all of them) without a
+ * descent, so sorted input needs no hint.
+ * @param tree: the tree to add an item to.
+ * @param data: item to add to the tree.
+ * @param hint: a node of the tree (e.g. the one this function returned for the previous item), may be NULL.
+ * @return: the node of the new item, NULL on failure (if the item is already in the tree - failure).
+ */
+Node *addToRBTreeHint(RBTree *tree, void *data, Node *hint);
+
+/**
+ * add a batch of items to the tree. the batch is sorted and merged with the items of the tree, and a large batch
+ * rebuilds the tree from the merged sequence (reusing its nodes) instead of descending once per item.
+ * the items are accepted exactly as adding them one by one in the batch order would: an item that is already in the
+ * tree, that is equal to an earlier item of the batch, or that is NULL is rejected.
+ * @param tree: the tree to add the items to.
+ * @param items: the items to add, in any order.
+ * @param n: number of items.
+ * @param results: if not NULL, results[i] is set to 0 if items[i] was rejected, other if it was added.
+ * @return: the number of items added, 0 on failure (then no item was added).
+ */
+int addBatchToRBTree(RBTree *tree, void *items[], int n, int *results);
+
+/**
+ * add an item to the tree, unless an equal item is already in it. a single descent does both the lookup and the
+ * insert. red-black engine only.
+ * @param tree: the tree to add an item to.
+ * @param data: item to add to the tree.
+ * @return: the item of the tree that is equal to data (data itself if it was added), NULL on failure.
+ */
+void *insertOrGetRBTree(RBTree *tree, void *data);
+
+/**
+ * put an item in the tree in a single descent: if an equal item is in the tree it is replaced by data and freed with
+ * the tree's FreeFunc, otherwise data is added. red-black engine only.
+ * @param tree: the tree to put the item in.
+ * @param data: item to put in the tree.
+ * @return: 0 on failure, other on success.
+ */
+int replaceRBTree(RBTree *tree, void *data);
+
+/**
+ * remove an item from the tree. the item stored in the tree is freed with the tree's FreeFunc, and its node is kept
+ * for reuse by the next insert.
+ * @param tree: the tree to remove an item from.
+ * @param data: item to remove.
+ * @return: 0 on failure, other on success. (if the item is not in the tree - failure).
+ */
+int removeFromRBTree(RBTree *tree, const void *data);
+
+/**
+ * remove all the items in the range [lo, hi) from the tree, in O(log n + k) amortized for k removed items (a tree
+ * with order statistics or an aggregate is split around the range and joined back). the items are freed with the
+ * tree's FreeFunc.
+ * @param tree: the tree to remove items from.
+ * @param lo: lowest item to remove (inclusive).
+ * @param hi: the end of the range (exclusive).
+ * @return: the number of items removed, -1 on an engine that doesn't support it.
+ */
+int removeRangeFromRBTree(RBTree *tree, const void *lo, const void *hi);
+
+/**
+ * split a tree into a tree of the items lower than key and a tree of the others, in O(log n). red-black engine
+ * only, without a pool or a Bloom filter, and with order statistics or an aggregate: the sizes of the new trees are
+ * the counts of their roots.
+ * @param tree: the tree to split. on success it is freed, and its nodes belong to the new trees.
+ * @param key: item to compare to.
+ * @param left: set to a tree of the items lower than key.
+ * @param right: set to a tree of the items that are not lower than key.
+ * @return: 0 on failure (then the tree is not changed), other on success.
+ */
+int splitRBTree(RBTree *tree, const void *key, RBTree **left, RBTree **right);
+
+/**
+ * join two trees and an item between them into one tree, in O(log n): the root of the lower tree (in black height)
+ * is linked on the inner spine of the higher one. red-black engine only, without a pool or a Bloom filter, and both
+ * trees must have the same functions and options.
+ * @param left: a tree whose items are all lower than pivot and than the items of right.
+ * @param pivot: item to add between the trees, NULL to only concatenate them.
+ * @param right: a tree whose items are all greater than pivot.
+ * @return: the joined tree (left itself, right is freed), NULL on failure (then the trees are not changed).
+ */
+RBTree *joinRBTree(RBTree *left, void *pivot, RBTree *right);
+
+/**
+ * check whether the tree contains this item. a tree with a Bloom filter answers most misses without a descent.
  * @param tree: the tree to add an item to.
  * @param data: item to check.
  * @return: 0 if the item is not in the tree, other if it is.
  */
 int containsRBTree(RBTree *tree, void *data); // implement it in RBTree.c
 
+/**
+ * @param tree: the tree to search.
+ * @param data: item to compare to.
+ * @return: the item stored in the tree that is equal to data, NULL if there is none.
+ */
+void *findRBTree(const RBTree *tree, const void *data);
+
+/**
+ * check whether the tree contains an item that matches this key, using the tree's KeyCompareFunc. red-black engine
+ * only.
+ * @param tree: the tree to search.
+ * @param key: the key to look for.
+ * @return: 0 if no item matches the key (or the tree has no KeyCompareFunc), other if one does.
+ */
+int containsKeyRBTree(const RBTree *tree, const void *key);
+
+/**
+ * @param tree: the tree to search, using its KeyCompareFunc. red-black engine only.
+ * @param key: the key to look for.
+ * @return: the item of the tree that matches the key, NULL if there is none (or the tree has no KeyCompareFunc).
+ */
+void *findKeyRBTree(const RBTree *tree, const void *key);
+
 
 
 /**
@@ -88,11 +384,225 @@ int containsRBTree(RBTree *tree, void *data); // implement it in RBTree.c
  */
 int forEachRBTree(RBTree *tree, forEachFunc func, void *args); // implement it in RBTree.c
 
+/**
+ * Activate a function on each item of the tree, on up to nThreads threads: the tree is split into subtrees that a
+ * work-stealing pool walks in parallel. the order is unspecified and func must be thread safe. if one of the
+ * activations of the function returns 0, the process stops (items that other threads are already at may still be
+ * visited). other engines than the red-black one are walked serially.
+ * @param tree: the tree with all the items.
+ * @param func: the function to activate on all items.
+ * @param args: more optional arguments to the function, shared by all the threads.
+ * @param nThreads: maximal number of threads to use (including the calling one).
+ * @return: 0 on failure, other on success.
+ */
+int parallelForEachRBTree(RBTree *tree, forEachFunc func, void *args, int nThreads);
+
+/**
+ * reduce the items of the tree on up to nThreads threads. the thread that is worker w of the pool calls
+ * func(item, accumulators[w]), so func needs no locking. afterwards every accumulator is merged into accumulators[0]
+ * with combine. the reduction must be associative and commutative (the items reach the accumulators in an
+ * unspecified order), and each accumulator must start as the identity of the reduction.
+ * @param tree: the tree with all the items.
+ * @param func: accumulates one item into its args.
+ * @param accumulators: nThreads accumulators. the result is in accumulators[0].
+ * @param combine: merges one accumulator into another.
+ * @param nThreads: maximal number of threads to use (including the calling one).
+ * @return: 0 on failure, other on success.
+ */
+int parallelReduceRBTree(RBTree *tree, forEachFunc func, void *accumulators[], CombineFunc combine, int nThreads);
+
+/**
+ * the items that are in a or in b (the item of a, if both have equal ones), as a new tree. the larger tree is split
+ * at the items of the smaller one and the parts are joined back (recursing on up to nThreads threads), so for m items
+ * in the smaller tree and n in the larger it costs O(m log(n / m + 1)) comparisons, plus copying the nodes of the
+ * result. the trees are not changed. red-black engine only, and both trees must have the same CompareFunc.
+ * @param a: a tree.
+ * @param b: a tree.
+ * @param freeFunc: the FreeFunc of the new tree. its items are the items of a and b, so this is usually a function
+ * that doesn't free them.
+ * @param nThreads: maximal number of threads to use (including the calling one).
+ * @return: the new tree, NULL on failure.
+ */
+RBTree *unionRBTree(const RBTree *a, const RBTree *b, FreeFunc freeFunc, int nThreads);
+
+/**
+ * the items of a that are also in b, as a new tree. the larger tree is split at the items of the smaller one and
+ * the parts are joined back (recursing on up to nThreads threads), so for m items in the smaller tree and n in the
+ * larger it costs O(m log(n / m + 1)). the trees are not changed. red-black engine only, and both trees must have the
+ * same CompareFunc.
+ * @param a: a tree.
+ * @param b: a tree.
+ * @param freeFunc: the FreeFunc of the new tree. its items are the items of a, so this is usually a function that
+ * doesn't free them.
+ * @param nThreads: maximal number of threads to use (including the calling one).
+ * @return: the new tree, NULL on failure.
+ */
+RBTree *intersectRBTree(const RBTree *a, const RBTree *b, FreeFunc freeFunc, int nThreads);
+
+/**
+ * the items of a that are not in b, as a new tree. b is split at the items of a and the parts are joined back
+ * (recursing on up to nThreads threads), so for m items in the smaller tree and n in the larger it costs
+ * O(m log(n / m + 1)) comparisons, plus copying the nodes of the result. the trees are not changed. red-black engine
+ * only, and both trees must have the same CompareFunc.
+ * @param a: a tree.
+ * @param b: a tree.
+ * @param freeFunc: the FreeFunc of the new tree. its items are the items of a, so this is usually a function that
+ * doesn't free them.
+ * @param nThreads: maximal number of threads to use (including the calling one).
+ * @return: the new tree, NULL on failure.
+ */
+RBTree *differenceRBTree(const RBTree *a, const RBTree *b, FreeFunc freeFunc, int nThreads);
+
+/**
+ * @param tree: the tree to search.
+ * @param data: item to compare to.
+ * @return: the smallest item in the tree that is not lower than data, NULL if there is none (or on an
+ * engine that doesn't support it).
+ */
+void *lowerBoundRBTree(const RBTree *tree, const void *data);
+
+/**
+ * @param tree: the tree to search.
+ * @param data: item to compare to.
+ * @return: the smallest item in the tree that is greater than data (its successor), NULL if there is none (or on an
+ * engine that doesn't support it).
+ */
+void *upperBoundRBTree(const RBTree *tree, const void *data);
+
+/**
+ * @param tree: the tree to search.
+ * @param data: item to compare to.
+ * @return: the largest item in the tree that is lower than or equal to data, NULL if there is none (or on an
+ * engine that doesn't support it).
+ */
+void *floorRBTree(const RBTree *tree, const void *data);
+
+/**
+ * @param tree: the tree to search.
+ * @param data: item to compare to.
+ * @return: the smallest item in the tree that is greater than or equal to data, NULL if there is none (or on an
+ * engine that doesn't support it).
+ * (same as lowerBoundRBTree)
+ */
+void *ceilRBTree(const RBTree *tree, const void *data);
+
+/**
+ * Activate a function on each item of the tree in the range [lo, hi), in O(log n + k) for k items. the order is an
+ * ascending order. if one of the activations of the function returns 0, the process stops.
+ * @param tree: the tree with all the items.
+ * @param lo: lowest item of the range (inclusive).
+ * @param hi: the end of the range (exclusive).
+ * @param func: the function to activate on the items.
+ * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @return: 0 on failure (also on an engine that doesn't support it), other on success (an empty range is a
+ * success).
+ */
+int forEachRBTreeRange(const RBTree *tree, const void *lo, const void *hi, forEachFunc func, void *args);
+
+/**
+ * the following queries run in O(log n) and need a tree created with the orderStatistics option.
+ */
+
+/**
+ * @param tree: a tree with order statistics.
+ * @param data: item to compare to.
+ * @return: the number of items in the tree that are lower than data, -1 on failure.
+ */
+int rankRBTree(const RBTree *tree, const void *data);
+
+/**
+ * @param tree: a tree with order statistics.
+ * @param k: index of the item in an ascending order, starting at 0.
+ * @return: the k-th smallest item, NULL if k is out of range or on failure.
+ */
+void *selectRBTree(const RBTree *tree, int k);
+
+/**
+ * @param tree: a tree with order statistics.
+ * @param lo: lowest item of the range (inclusive).
+ * @param hi: the end of the range (exclusive).
+ * @return: the number of items in the range [lo, hi), -1 on failure.
+ */
+int countRangeRBTree(const RBTree *tree, const void *lo, const void *hi);
+
+/**
+ * @param tree: a tree with order statistics.
+ * @return: an item of the tree chosen uniformly at random (using rand()), NULL if the tree is empty or on failure.
+ */
+void *sampleRBTree(const RBTree *tree);
+
+/**
+ * the aggregate of all the items of a tree, in O(1).
+ * @param tree: a tree with an aggregate.
+ * @param result: where to write the aggregate (RBTreeAggregate::size bytes).
+ * @return: 0 on failure (also if the tree is empty), other on success.
+ */
+int aggregateRBTree(const RBTree *tree, void *result);
+
+/**
+ * the aggregate of the items in the range [lo, hi), in O(log n): the subtrees inside the range are combined whole.
+ * @param tree: a tree with an aggregate.
+ * @param lo: lowest item of the range (inclusive).
+ * @param hi: the end of the range (exclusive).
+ * @param result: where to write the aggregate (RBTreeAggregate::size bytes).
+ * @return: 0 on failure (also if the range is empty), other on success.
+ */
+int aggregateRangeRBTree(const RBTree *tree, const void *lo, const void *hi, void *result);
+
+/**
+ * @param tree: the tree.
+ * @return: the node of the smallest item of the tree (cached, O(1)), NULL if the tree is empty.
+ */
+Node *rbFirst(const RBTree *tree);
+
+/**
+ * @param tree: the tree.
+ * @return: the node of the largest item of the tree (cached, O(1)), NULL if the tree is empty.
+ */
+Node *rbLast(const RBTree *tree);
+
+/**
+ * moves a cursor one item forward, using the parent links (no stack, amortized O(1)).
+ * the cursor stays valid as long as its own node isn't removed from the tree.
+ * @param node: the current node.
+ * @return: the node of the next item in an ascending order, NULL after the last one.
+ */
+Node *rbNext(const Node *node);
+
+/**
+ * moves a cursor one item backward, using the parent links (no stack, amortized O(1)).
+ * @param node: the current node.
+ * @return: the node of the previous item in an ascending order, NULL before the first one.
+ */
+Node *rbPrev(const Node *node);
+
+/**
+ * @param tree: a red-black engine tree.
+ * @return: the counters of the tree since it was created or last reset, and its current black height.
+ */
+RBTreeStats getRBTreeStats(const RBTree *tree);
+
+/**
+ * zero the counters of the tree and of its Bloom filter.
+ * @param tree: a red-black engine tree.
+ */
+void resetRBTreeStats(RBTree *tree);
+
+/**
+ * @param tree: a tree created with a HashFunc, of any engine.
+ * @return: the counters of its Bloom filter since the tree was created or its stats were last reset (all 0 if the
+ * tree has no filter).
+ */
+RBTreeBloomStats getRBTreeBloomStats(const RBTree *tree);
+
 /**
  * free all memory of the data structure.
  * @param tree: the tree to free.
  */
 void freeRBTree(RBTree *tree); // implement it in RBTree.c
 
+#ifdef __cplusplus
+}
+#endif
 
 #endif //RBTREE_RBTREE_H
\ No newline at end of file
@@ -0,0 +1,1233 @@
+#define _GNU_SOURCE
+
+#include "RBTree.h"
+#include "Structs.h"
+#include "TypedRBTree.h"
+#include "CompactRBTree.h"
+#include "ConcurrentRBTree.h"
+#include "FrozenRBTree.h"
+#include "MappedRBTree.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_ELEMENTS (1000000)
+#define LOOKUPS (1000000)
+#define CONCURRENT_SECONDS (1.0)
+#define PARALLEL_MAX_THREADS (64)
+#define SNAPSHOT_PATH "/tmp/rbtree_benchmark.snapshot"
+#define AGGREGATE_ROUNDS (100)
+#define AGGREGATE_DIMENSION (8)
+#define USAGE "usage: benchmark pool <malloc|pool> [elements]\n" \
+              "       benchmark lookup <redblack|bplus|frozen> [elements]\n" \
+              "       benchmark typed <generic|typed|frozen> [elements]\n" \
+              "       benchmark memory <redblack|pool|bplus|compact> [elements]\n" \
+              "       benchmark concurrent <mutex|epoch> [elements]\n" \
+              "       benchmark batch <single|batch> [elements]\n" \
+              "       benchmark parallel <foreach|reduce> [elements]\n" \
+              "       benchmark sorted <random|add|hint> [elements]\n" \
+              "       benchmark prefix <plain|prefix> [elements]\n" \
+              "       benchmark bloom <plain|bloom> [elements]\n" \
+              "       benchmark snapshot <insert|map> [elements]\n" \
+              "       benchmark split <reinsert|split> [elements]\n" \
+              "       benchmark set <lookup|merge> [elements]\n" \
+              "       benchmark aggregate <walk|aggregate> [elements]\n"
+
+RBTREE_DEFINE(IntTree, int, RBTREE_NUMBER_COMPARE)
+
+/**
+ * CompFunc for ints.
+ */
+static int intCompare(const void *a, const void *b)
+{
+    int x = *(const int *) a;
+    int y = *(const int *) b;
+    return (x > y) - (x < y);
+}
+
+static long comparisons = 0;
+
+/**
+ * CompFunc for ints that counts its calls in comparisons.
+ */
+static int countingIntCompare(const void *a, const void *b)
+{
+    comparisons++;
+    return intCompare(a, b);
+}
+
+/**
+ * FreeFunc for ints owned by the benchmark.
+ */
+static void intNoFree(void *data)
+{
+    (void) data;
+}
+
+/**
+ * @return a monotonic timestamp in seconds
+ */
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+/**
+ * @return the resident set size of the process in bytes (0 if it can't be read).
+ */
+static long residentBytes()
+{
+    long pages = 0;
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm == NULL)
+    {
+        return 0;
+    }
+    if (fscanf(statm, "%*d %ld", &pages) != 1)
+    {
+        pages = 0;
+    }
+    fclose(statm);
+    return pages * sysconf(_SC_PAGESIZE);
+}
+
+/**
+ * @param n
+ * @return the numbers 0..n-1 in a random order. the caller frees the array.
+ */
+static int *shuffledKeys(int n)
+{
+    int *keys = malloc(sizeof(int) * n);
+    unsigned long long state = 88172645463325252ULL;
+    for (int i = 0; i < n; ++i)
+    {
+        keys[i] = i;
+    }
+    for (int i = n - 1; i > 0; --i)
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        int j = (int) (state % (unsigned long long) (i + 1));
+        int tmp = keys[i];
+        keys[i] = keys[j];
+        keys[j] = tmp;
+    }
+    return keys;
+}
+
+/**
+ * inserts n random keys into a tree allocated with malloc or with a node pool, and reports throughput and memory.
+ * @param variant "malloc" or "pool"
+ * @param n
+ * @return 0 on success
+ */
+static int benchmarkPool(const char *variant, int n)
+{
+    RBTreeOptions options = {0};
+    options.usePool = strcmp(variant, "pool") == 0;
+    if (!options.usePool && strcmp(variant, "malloc") != 0)
+    {
+        fprintf(stderr, USAGE);
+        return 1;
+    }
+
+    int *keys = shuffledKeys(n);
+    long rssBefore = residentBytes();
+    RBTree *tree = newRBTreeWithOptions(intCompare, intNoFree, &options);
+
+    double start = now();
+    for (int i = 0; i < n; ++i)
+    {
+        addToRBTree(tree, &keys[i]);
+    }
+    double insertTime = now() - start;
+    long rssAfter = residentBytes();
+
+    start = now();
+    freeRBTree(tree);
+    double freeTime = now() - start;
+
+    printf("%-8s n=%d inserts/sec=%.0f rss=%.1fMB (%.1f bytes/element) free=%.3fs\n", variant, n,
+           n / insertTime, (rssAfter - rssBefore) / 1e6, (double) (rssAfter - rssBefore) / n, freeTime);
+    free(keys);
+    return 0;
+}
+
+/**
+ * looks up random keys in a tree of n keys built with the given engine (or frozen after it was built), and reports
+ * the average latency.
+ * @param variant "redblack", "bplus" or "frozen"
+ * @param n
+ * @return 0 on success
+ */
+static int benchmarkLookup(const char *variant, int n)
+{
+    RBTreeOptions options = {0};
+    int frozen = strcmp(variant, "frozen") == 0;
+    if (strcmp(variant, "bplus") == 0)
+    {
+        options.engine = BPLUS_ENGINE;
+    }
+    else if (!frozen && strcmp(variant, "redblack") != 0)
+    {
+        fprintf(stderr, USAGE);
+        return 1;
+    }
+
+    int *keys = shuffledKeys(n);
+    int *probes = shuffledKeys(n);
+    RBTree *tree = newRBTreeWithOptions(intCompare, intNoFree, &options);
+    for (int i = 0; i < n; ++i)
+    {
+        addToRBTree(tree, &keys[i]);
+    }
+    FrozenRBTree *frozenTree = frozen ? freezeRBTree(tree) : NULL;
+
+    int found = 0;
+    double start = now();
+    for (int i = 0; i < LOOKUPS; ++i)
+    {
+        found += frozen ? containsFrozenRBTree(frozenTree, &probes[i % n]) : containsRBTree(tree, &probes[i % n]);
+    }
+    double elapsed = now() - start;
+
+    printf("%-8s n=%-10d lookup=%.1fns found=%d\n", variant, n, elapsed * 1e9 / LOOKUPS, found);
+    if (frozen)
+    {
+        freeFrozenRBTree(frozenTree);
+    }
+    else
+    {
+        freeRBTree(tree);
+    }
+    free(keys);
+    free(probes);
+    return 0;
+}
+
+/**
+ * inserts and looks up random ints in a generic tree (CompareFunc and void * items), in a typed IntTree, or in a
+ * typed IntTree that is frozen (into an IntTreeFrozen) before the lookups.
+ * @param variant "generic", "typed" or "frozen"
+ * @param n
+ * @return 0 on success
+ */
+static int benchmarkTyped(const char *variant, int n)
+{
+    int frozen = strcmp(variant, "frozen") == 0;
+    int typed = frozen || strcmp(variant, "typed") == 0;
+    if (!typed && strcmp(variant, "generic") != 0)
+    {
+        fprintf(stderr, USAGE);
+        return 1;
+    }
+
+    int *keys = shuffledKeys(n);
+    int *probes = shuffledKeys(n);
+    RBTree *tree = typed ? NULL : newRBTree(intCompare, intNoFree);
+    IntTree *intTree = typed ? newIntTree() : NULL;
+
+    double start = now();
+    for (int i = 0; i < n; ++i)
+    {
+        if (typed)
+        {
+            addToIntTree(intTree, keys[i]);
+        }
+        else
+        {
+            addToRBTree(tree, &keys[i]);
+        }
+    }
+    double insertTime = now() - start;
+    IntTreeFrozen *frozenTree = frozen ? freezeIntTree(intTree) : NULL;
+    intTree = frozen ? NULL : intTree;
+
+    int found = 0;
+    start = now();
+    for (int i = 0; i < LOOKUPS; ++i)
+    {
+        if (frozen)
+        {
+            found += containsFrozenIntTree(frozenTree, probes[i % n]);
+        }
+        else
+        {
+            found += typed ? containsIntTree(intTree, probes[i % n]) : containsRBTree(tree, &probes[i % n]);
+        }
+    }
+    double lookupTime = now() - start;
+
+    printf("%-8s n=%-10d inserts/sec=%.0f lookup=%.1fns found=%d\n", variant, n, n / insertTime,
+           lookupTime * 1e9 / LOOKUPS, found);
+    freeRBTree(tree);
+    freeIntTree(intTree);
+    freeFrozenIntTree(frozenTree);
+    free(keys);
+    free(probes);
+    return 0;
+}
+
+/**
+ * inserts n random keys into a tree of the given layout, and reports the memory it takes per element.
+ * @param variant "redblack" (a malloc per Node), "pool" (Nodes in slabs), "bplus" or "compact" (CompactNodes)
+ * @param n
+ * @return 0 on success
+ */
+static int benchmarkMemory(const char *variant, int n)
+{
+    RBTreeOptions options = {0};
+    size_t nodeSize = sizeof(Node);
+    if (strcmp(variant, "pool") == 0)
+    {
+        options.usePool = 1;
+    }
+    else if (strcmp(variant, "bplus") == 0)
+    {
+        options.engine = BPLUS_ENGINE;
+        nodeSize = 0; // the keys share nodes
+    }
+    else if (strcmp(variant, "compact") == 0)
+    {
+        options.engine = COMPACT_ENGINE;
+        nodeSize = sizeof(CompactNode);
+    }
+    else if (strcmp(variant, "redblack") != 0)
+    {
+        fprintf(stderr, USAGE);
+        return 1;
+    }
+
+    int *keys = shuffledKeys(n);
+    long rssBefore = residentBytes();
+    RBTree *tree = newRBTreeWithOptions(intCompare, intNoFree, &options);
+    for (int i = 0; i < n; ++i)
+    {
+        addToRBTree(tree, &keys[i]);
+    }
+    long rssAfter = residentBytes();
+
+    printf("%-8s n=%-10d node=%zu bytes rss=%.1fMB (%.1f bytes/element)\n", variant, n, nodeSize,
+           (rssAfter - rssBefore) / 1e6, (double) (rssAfter - rssBefore) / n);
+    freeRBTree(tree);
+    free(keys);
+    return 0;
+}
+
+/*
+ * the state shared by the threads of the concurrent benchmark.
+ */
+typedef struct ConcurrentBench
+{
+    int epoch; // 1 for a ConcurrentRBTree, 0 for an RBTree behind a mutex
+    RBTree *tree;
+    pthread_mutex_t lock;
+    ConcurrentRBTree *concurrentTree;
+    int *keys; // the first half is in the tree before the threads start, the writer adds the second half
+    int n;
+    int stop;
+} ConcurrentBench;
+
+/*
+ * a reader thread of the concurrent benchmark.
+ */
+typedef struct ConcurrentReaderTask
+{
+    ConcurrentBench *bench;
+    unsigned long long seed;
+    long lookups;
+    pthread_t thread;
+} ConcurrentReaderTask;
+
+/**
+ * looks up keys from the first half until the benchmark stops.
+ * @param args a ConcurrentReaderTask
+ * @return NULL
+ */
+static void *runConcurrentReader(void *args)
+{
+    ConcurrentReaderTask *task = args;
+    ConcurrentBench *bench = task->bench;
+    int reader = bench->epoch ? registerConcurrentReader(bench->concurrentTree) : -1;
+    unsigned long long state = task->seed;
+    long lookups = 0;
+    while (!__atomic_load_n(&bench->stop, __ATOMIC_RELAXED))
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        int *key = &bench->keys[state % (unsigned long long) (bench->n / 2)];
+        if (bench->epoch)
+        {
+            containsConcurrentRBTree(bench->concurrentTree, reader, key);
+        }
+        else
+        {
+            pthread_mutex_lock(&bench->lock);
+            containsRBTree(bench->tree, key);
+            pthread_mutex_unlock(&bench->lock);
+        }
+        lookups++;
+    }
+    unregisterConcurrentReader(bench->concurrentTree, reader);
+    task->lookups = lookups;
+    return NULL;
+}
+
+/**
+ * adds the second half of the keys until they run out or the benchmark stops.
+ * @param args a ConcurrentBench
+ * @return NULL
+ */
+static void *runConcurrentWriter(void *args)
+{
+    ConcurrentBench *bench = args;
+    for (int i = bench->n / 2; i < bench->n && !__atomic_load_n(&bench->stop, __ATOMIC_RELAXED); ++i)
+    {
+        if (bench->epoch)
+        {
+            addToConcurrentRBTree(bench->concurrentTree, &bench->keys[i]);
+        }
+        else
+        {
+            pthread_mutex_lock(&bench->lock);
+            addToRBTree(bench->tree, &bench->keys[i]);
+            pthread_mutex_unlock(&bench->lock);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * runs 1..cores reader threads against one inserting writer thread, and reports the lookup throughput of each run.
+ * @param variant "mutex" (an RBTree behind a global mutex) or "epoch" (a ConcurrentRBTree)
+ * @param n
+ * @return 0 on success
+ */
+static int benchmarkConcurrent(const char *variant, int n)
+{
+    ConcurrentBench bench;
+    bench.epoch = strcmp(variant, "epoch") == 0;
+    if ((!bench.epoch && strcmp(variant, "mutex") != 0) || n < 2)
+    {
+        fprintf(stderr, USAGE);
+        return 1;
+    }
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    cores = cores < 1 ? 1 : cores > CONCURRENT_MAX_READERS ? CONCURRENT_MAX_READERS : cores;
+    bench.keys = shuffledKeys(n);
+    bench.n = n;
+    pthread_mutex_init(&bench.lock, NULL);
+    ConcurrentReaderTask *tasks = malloc(sizeof(ConcurrentReaderTask) * cores);
+
+    for (int readers = 1; readers <= cores; ++readers)
+    {
+        bench.tree = bench.epoch ? NULL : newRBTree(intCompare, intNoFree);
+        bench.concurrentTree = bench.epoch ? newConcurrentRBTree(intCompare, intNoFree) : NULL;
+        for (int i = 0; i < n / 2; ++i)
+        {
+            if (bench.epoch)
+            {
+                addToConcurrentRBTree(bench.concurrentTree, &bench.keys[i]);
+            }
+            else
+            {
+                addToRBTree(bench.tree, &bench.keys[i]);
+            }
+        }
+        bench.stop = 0;
+
+        pthread_t writer;
+        for (int i = 0; i < readers; ++i)
+        {
+            tasks[i].bench = &bench;
+            tasks[i].seed = 88172645463325252ULL + i;
+            pthread_create(&tasks[i].thread, NULL, runConcurrentReader, &tasks[i]);
+        }
+        pthread_create(&writer, NULL, runConcurrentWriter, &bench);
+        struct timespec window = {(time_t) CONCURRENT_SECONDS,
+                                  (long) ((CONCURRENT_SECONDS - (time_t) CONCURRENT_SECONDS) * 1e9)};
+        nanosleep(&window, NULL);
+        __atomic_store_n(&bench.stop, 1, __ATOMIC_RELAXED);
+        pthread_join(writer, NULL);
+        long lookups = 0;
+        for (int i = 0; i < readers; ++i)
+        {
+            pthread_join(tasks[i].thread, NULL);
+            lookups += tasks[i].lookups;
+        }
+
+        int size = bench.epoch ? bench.concurrentTree->size : bench.tree->size;
+        printf("%-8s n=%-10d readers=%-3d lookups/sec=%.0f inserted=%d\n", variant, n, readers,
+               lookups / CONCURRENT_SECONDS, size - n / 2);
+        freeRBTree(bench.tree);
+        freeConcurrentRBTree(bench.concurrentTree);
+    }
+
+    pthread_mutex_destroy(&bench.lock);
+    free(tasks);
+    free(bench.keys);
+    return 0;
+}
+
+/**
+ * adds a shuffled batch of n odd keys to a tree of n even keys, one by one or with addBatchToRBTree, and reports the
+ * time and the number of comparator calls.
+ * @param variant "single" or "batch"
+ * @param n
+ * @return 0 on success
+ */
+static int benchmarkBatch(const char *variant, int n)
+{
+    int batch = strcmp(variant, "batch") == 0;
+    if (!batch && strcmp(variant, "single") != 0)
+    {
+        fprintf(stderr, USAGE);
+        return 1;
+    }
+    int *keys = shuffledKeys(2 * n);
+    void **evens = malloc(sizeof(void *) * n);
+    void **odds = malloc(sizeof(void *) * n);
+    for (int i = 0, e = 0, o = 0; i < 2 * n; ++i)
+    {
+        if (keys[i] % 2 == 0)
+        {
+            evens[e++] = &keys[i];
+        }
+        else
+        {
+            odds[o++] = &keys[i];
+        }
+    }
+    RBTree *tree = newRBTree(countingIntCompare, intNoFree);
+    addBatchToRBTree(tree, evens, n, NULL);
+
+    comparisons = 0;
+    double start = now();
+    int added = 0;
+    if (batch)
+    {
+        added = addBatchToRBTree(tree, odds, n, NULL);
+    }
+    else
+    {
+        for (int i = 0; i < n; ++i)
+        {
+            added += addToRBTree(tree, odds[i]);
+        }
+    }
+    double elapsed = now() - start;
+
+    printf("%-8s n=%-10d added=%d time=%.3fs comparisons/item=%.1f\n", variant, n, added, elapsed,
+           (double) comparisons / n);
+    freeRBTree(tree);
+    free(evens);
+    free(odds);
+    free(keys);
+    return 0;
+}
+
+/**
+ * inserts n keys into an empty tree: shuffled with addToRBTree, ascending with addToRBTree (its append fast path), or
+ * ascending with addToRBTreeHint and the previous node as the hint. reports the time and the comparator calls.
+ * @param variant "random", "add" or "hint"
+ * @param n
+ * @return 0 on success
+ */
+static int benchmarkSorted(const char *variant, int n)
+{
+    int random = strcmp(variant, "random") == 0;
+    int hint = strcmp(variant, "hint") == 0;
+    if (!random && !hint && strcmp(variant, "add") != 0)
+    {
+        fprintf(stderr, USAGE);
+        return 1;
+    }
+    int *keys = shuffledKeys(n);
+    if (!random)
+    {
+        for (int i = 0; i < n; ++i)
+        {
+            keys[i] = i;
+        }
+    }
+    RBTree *tree = newRBTree(countingIntCompare, intNoFree);
+
+    comparisons = 0;
+    double start = now();
+    Node *last = NULL;
+    for (int i = 0; i < n; ++i)
+    {
+        if (hint)
+        {
+            last = addToRBTreeHint(tree, &keys[i], last);
+        }
+        else
+        {
+            addToRBTree(tree, &keys[i]);
+        }
+    }
+    double elapsed = now() - start;
+
+    printf("%-8s n=%-10d inserts/sec=%.0f comparisons/item=%.2f\n", variant, n, n / elapsed,
+           (double) comparisons / n);
+    freeRBTree(tree);
+    free(keys);
+    return 0;
+}
+
+/**
+ * stringCompare that counts its calls in comparisons.
+ */
+static int countingStringCompare(const void *a, const void *b)
+{
+    comparisons++;
+    return stringCompare(a, b);
+}
+
+/**
+ * vectorCompare1By1 that counts its calls in comparisons.
+ */
+static int countingVectorCompare(const void *a, const void *b)
+{
+    comparisons++;
+    return vectorCompare1By1(a, b);
+}
+
+/**
+ * inserts n items into a tree with the given PrefixFunc (may be NULL), looks each of them up, and reports the time
+ * and the comparator calls per lookup.
+ * @param variant
+ * @param kind name of the items
+ * @param items
+ * @param n
+ * @param compFunc
+ * @param prefixFunc
+ */
+static void runPrefixBenchmark(const char *variant, const char *kind, void **items, int n, CompareFunc compFunc,
+                               PrefixFunc prefixFunc)
+{
+    RBTreeOptions options = {0};
+    options.prefixFunc = prefixFunc;
+    RBTree *tree = newRBTreeWithOptions(compFunc, intNoFree, &options);
+    double start = now();
+    for (int i = 0; i < n; ++i)
+    {
+        addToRBTree(tree, items[i]);
+    }
+    double insertTime = now() - start;
+
+    comparisons = 0;
+    int found = 0;
+    start = now();
+    for (int i = 0; i < LOOKUPS; ++i)
+    {
+        found += containsRBTree(tree, items[(int) ((i * 7919L) % n)]);
+    }
+    double lookupTime = now() - start;
+
+    printf("%-8s %-8s n=%-10d inserts/sec=%.0f lookup=%.1fns comparisons/lookup=%.2f found=%d\n", variant, kind, n,
+           n / insertTime, lookupTime * 1e9 / LOOKUPS, (double) comparisons / LOOKUPS, found);
+    freeRBTree(tree);
+}
+
+/**
+ * builds trees of n random strings and of n random Vectors, without or with their PrefixFunc.
+ * @param variant "plain" or "prefix"
+ * @param n
+ * @return 0 on success
+ */
+static int benchmarkPrefix(const char *variant, int n)
+{
+    int prefixed = strcmp(variant, "prefix") == 0;
+    if (!prefixed && strcmp(variant, "plain") != 0)
+    {
+        fprintf(stderr, USAGE);
+        return 1;
+    }
+    unsigned long long state = 88172645463325252ULL;
+    char *strings = malloc((size_t) n * 24);
+    double *elements = malloc(sizeof(double) * 4 * n);
+    Vector *vectors = malloc(sizeof(Vector) * n);
+    void **items = malloc(sizeof(void *) * n);
+    for (int i = 0; i < n; ++i)
+    {
+        char *string = strings + (size_t) i * 24;
+        int len = 8 + i % 16;
+        for (int j = 0; j < len; ++j)
+        {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            string[j] = (char) ('a' + state % 26);
+        }
+        string[len] = '\0';
+        for (int j = 0; j < 4; ++j)
+        {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            elements[4 * i + j] = (double) (state % 2000001) / 1000 - 1000;
+        }
+        vectors[i].len = 4;
+        vectors[i].vector = &elements[4 * i];
+    }
+
+    for (int i = 0; i < n; ++i)
+    {
+        items[i] = strings + (size_t) i * 24;
+    }
+    runPrefixBenchmark(variant, "string", items, n, countingStringCompare, prefixed ? stringPrefix : NULL);
+    for (int i = 0; i < n; ++i)
+    {
+        items[i] = &vectors[i];
+    }
+    runPrefixBenchmark(variant, "vector", items, n, countingVectorCompare, prefixed ? vectorPrefix : NULL);
+
+    free(items);
+    free(vectors);
+    free(elements);
+    free(strings);
+    return 0;
+}
+
+/**
+ * HashFunc for ints (the Bloom filter mixes the bits itself).
+ */
+static uint64_t intHash(const void *data)
+{
+    return (uint64_t) *(const int *) data;
+}
+
+/**
+ * probes a tree of n even keys with LOOKUPS random keys of which 90% are odd (misses), like a dedupe workload, with
+ * and without a Bloom filter, and reports the time per probe and the false positive rate of the filter.
+ * @param variant "plain" or "bloom"
+ * @param n
+ * @return 0 on success
+ */
+static int benchmarkBloom(const char *variant, int n)
+{
+    int bloom = strcmp(variant, "bloom") == 0;
+    if (!bloom && strcmp(variant, "plain") != 0)
+    {
+        fprintf(stderr, USAGE);
+        return 1;
+    }
+    int *keys = shuffledKeys(n);
+    int *probes = malloc(sizeof(int) * LOOKUPS);
+    RBTreeOptions options = {0};
+    options.hashFunc = bloom ? intHash : NULL;
+    options.expectedSize = n;
+    RBTree *tree = newRBTreeWithOptions(intCompare, intNoFree, &options);
+    for (int i = 0; i < n; ++i)
+    {
+        keys[i] *= 2;
+        addToRBTree(tree, &keys[i]);
+    }
+    unsigned long long state = 88172645463325252ULL;
+    for (int i = 0; i < LOOKUPS; ++i)
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        probes[i] = 2 * (int) (state % (unsigned long long) n) + (state % 10 != 0);
+    }
+
+    long found = 0;
+    double start = now();
+    for (int i = 0; i < LOOKUPS; ++i)
+    {
+        found += containsRBTree(tree, &probes[i]);
+    }
+    double elapsed = now() - start;
+    RBTreeBloomStats stats = getRBTreeBloomStats(tree);
+    printf("%-6s n=%-10d probes=%d hits=%ld time=%.3fs (%.1f ns/probe) filtered=%ld false positive rate=%.4f "
+           "bits=%ld\n", variant, n, LOOKUPS, found, elapsed, elapsed * 1e9 / LOOKUPS, stats.filtered,
+           stats.falsePositiveRate, stats.bits);
+    freeRBTree(tree);
+    free(probes);
+    free(keys);
+    return 0;
+}
+
+/**
+ * saves a tree of n random strings to a snapshot, and reloads it either by adding a copy of every string to a new
+ * tree, the way a service without snapshots starts, or with mapRBTree. reports the reload time and the time of
+ * LOOKUPS lookups in the reloaded tree.
+ * @param variant "insert" or "map"
+ * @param n
+ * @return 0 on success
+ */
+static int benchmarkSnapshot(const char *variant, int n)
+{
+    int map = strcmp(variant, "map") == 0;
+    if (!map && strcmp(variant, "insert") != 0)
+    {
+        fprintf(stderr, USAGE);
+        return 1;
+    }
+    unsigned long long state = 88172645463325252ULL;
+    char *strings = malloc((size_t) n * 24);
+    RBTree *saved = newRBTree(stringCompare, intNoFree);
+    for (int i = 0; i < n; ++i)
+    {
+        char *string = strings + (size_t) i * 24;
+        int len = 8 + i % 16;
+        for (int j = 0; j < len; ++j)
+        {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            string[j] = (char) ('a' + state % 26);
+        }
+        string[len] = '\0';
+        addToRBTree(saved, string);
+    }
+    if (!saveRBTree(saved, SNAPSHOT_PATH, serializeString))
+    {
+        fprintf(stderr, "can't write %s\n", SNAPSHOT_PATH);
+        return 1;
+    }
+
+    double start = now();
+    RBTree *tree = map ? mapRBTree(SNAPSHOT_PATH, stringCompare) : newRBTree(stringCompare, freeString);
+    for (int i = 0; i < n && !map; ++i)
+    {
+        const char *string = strings + (size_t) i * 24;
+        char *copy = malloc(strlen(string) + 1);
+        strcpy(copy, string);
+        if (!addToRBTree(tree, copy))
+        {
+            free(copy);
+        }
+    }
+    double reload = now() - start;
+
+    long found = 0;
+    start = now();
+    for (int i = 0; i < LOOKUPS; ++i)
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        found += containsRBTree(tree, strings + (size_t) (state % (unsigned long long) n) * 24);
+    }
+    double lookups = now() - start;
+    printf("%-6s n=%-10d items=%d reload=%.3fs lookups=%.3fs (%.1f ns/lookup)%s\n", variant, n, tree->size, reload,
+           lookups, lookups * 1e9 / LOOKUPS, found == LOOKUPS ? "" : " (missing items)");
+    freeRBTree(tree);
+    freeRBTree(saved);
+    free(strings);
+    remove(SNAPSHOT_PATH);
+    return 0;
+}
+
+/**
+ * moves the upper half of a tree of n keys into a new tree and back (a shard rebalance), either by re-inserting the
+ * items into new trees or with splitRBTree and joinRBTree, and reports the time of one round trip. the trees keep
+ * order statistics.
+ * @param variant "reinsert" or "split"
+ * @param n
+ * @return 0 on success
+ */
+static int benchmarkSplit(const char *variant, int n)
+{
+    int split = strcmp(variant, "split") == 0;
+    if (!split && strcmp(variant, "reinsert") != 0)
+    {
+        fprintf(stderr, USAGE);
+        return 1;
+    }
+    // splitRBTree takes the sizes of the split trees from the subtree counts of order statistics.
+    RBTreeOptions options = {0};
+    options.orderStatistics = 1;
+    int *keys = shuffledKeys(n);
+    RBTree *tree = newRBTreeWithOptions(intCompare, intNoFree, &options);
+    for (int i = 0; i < n; ++i)
+    {
+        addToRBTree(tree, &keys[i]);
+    }
+    int middle = n / 2;
+    double start = now();
+    if (split)
+    {
+        RBTree *lower = NULL, *upper = NULL;
+        splitRBTree(tree, &middle, &lower, &upper);
+        tree = joinRBTree(lower, NULL, upper);
+    }
+    else
+    {
+        RBTree *lower = newRBTreeWithOptions(intCompare, intNoFree, &options);
+        RBTree *upper = newRBTreeWithOptions(intCompare, intNoFree, &options);
+        for (Node *node = rbFirst(tree); node != NULL; node = rbNext(node))
+        {
+            addToRBTree(*(int *) node->data < middle ? lower : upper, node->data);
+        }
+        freeRBTree(tree);
+        for (Node *node = rbFirst(upper); node != NULL; node = rbNext(node))
+        {
+            addToRBTree(lower, node->data);
+        }
+        freeRBTree(upper);
+        tree = lower;
+    }
+    double elapsed = now() - start;
+    printf("%-8s n=%-10d items=%d time=%.6fs\n", variant, n, tree->size, elapsed);
+    freeRBTree(tree);
+    free(keys);
+    return 0;
+}
+
+/*
+ * the arguments of addIfContained.
+ */
+typedef struct LookupIntersection
+{
+    RBTree *other;
+    RBTree *result;
+} LookupIntersection;
+
+/**
+ * forEachFunc that adds an item to a result tree if another tree contains it.
+ */
+static int addIfContained(const void *object, void *args)
+{
+    LookupIntersection *intersection = (LookupIntersection *) args;
+    if (containsRBTree(intersection->other, (void *) object))
+    {
+        addToRBTree(intersection->result, (void *) object);
+    }
+    return 1;
+}
+
+/**
+ * intersects and unites a tree of n random strings with one of n / 10 other strings and every 20th of the first tree,
+ * either by walking one tree and looking its items up in the other, or with intersectRBTree and unionRBTree on 1 to
+ * (number of cores) threads.
+ * @param variant "lookup" or "merge"
+ * @param n
+ * @return 0 on success
+ */
+static int benchmarkSet(const char *variant, int n)
+{
+    int merge = strcmp(variant, "merge") == 0;
+    if (!merge && strcmp(variant, "lookup") != 0)
+    {
+        fprintf(stderr, USAGE);
+        return 1;
+    }
+    unsigned long long state = 88172645463325252ULL;
+    int m = n / 10 > 0 ? n / 10 : 1;
+    char *strings = malloc((size_t) (n + m) * 24);
+    RBTree *large = newRBTree(stringCompare, intNoFree);
+    RBTree *small = newRBTree(stringCompare, intNoFree);
+    for (int i = 0; i < n + m; ++i)
+    {
+        char *string = strings + (size_t) i * 24;
+        int len = 8 + i % 16;
+        for (int j = 0; j < len; ++j)
+        {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            string[j] = (char) ('a' + state % 26);
+        }
+        string[len] = '\0';
+        addToRBTree(i < n ? large : small, string);
+        if (i < n && i % 20 == 0)
+        {
+            addToRBTree(small, string);
+        }
+    }
+
+    long cores = merge ? sysconf(_SC_NPROCESSORS_ONLN) : 1;
+    cores = cores < 1 ? 1 : cores > PARALLEL_MAX_THREADS ? PARALLEL_MAX_THREADS : cores;
+    for (int threads = 1; threads <= cores; ++threads)
+    {
+        double start = now();
+        RBTree *intersection = NULL;
+        if (merge)
+        {
+            intersection = intersectRBTree(large, small, intNoFree, threads);
+        }
+        else
+        {
+            LookupIntersection args = {large, newRBTree(stringCompare, intNoFree)};
+            forEachRBTree(small, addIfContained, &args);
+            intersection = args.result;
+        }
+        double intersectTime = now() - start;
+
+        start = now();
+        RBTree *all = NULL;
+        if (merge)
+        {
+            all = unionRBTree(large, small, intNoFree, threads);
+        }
+        else
+        {
+            all = newRBTree(stringCompare, intNoFree);
+            for (Node *node = rbFirst(large); node != NULL; node = rbNext(node))
+            {
+                addToRBTree(all, node->data);
+            }
+            for (Node *node = rbFirst(small); node != NULL; node = rbNext(node))
+            {
+                addToRBTree(all, node->data);
+            }
+        }
+        double unionTime = now() - start;
+        printf("%-6s n=%-10d m=%-9d threads=%-3d intersection=%d in %.3fs union=%d in %.3fs\n", variant, n, small->size,
+               threads, intersection->size, intersectTime, all->size, unionTime);
+        freeRBTree(intersection);
+        freeRBTree(all);
+    }
+    freeRBTree(small);
+    freeRBTree(large);
+    free(strings);
+    return 0;
+}
+
+/**
+ * builds a tree of n random vectors, with or without maxNormAggregate, and then runs rounds that replace a random
+ * vector and find the vector of the largest norm, which walks the whole tree or reads the aggregate at the root.
+ * @param variant "walk" or "aggregate"
+ * @param n
+ * @return 0 on success
+ */
+static int benchmarkAggregate(const char *variant, int n)
+{
+    int aggregate = strcmp(variant, "aggregate") == 0;
+    if (!aggregate && strcmp(variant, "walk") != 0)
+    {
+        fprintf(stderr, USAGE);
+        return 1;
+    }
+    RBTreeOptions options = {0};
+    options.aggregate = aggregate ? &maxNormAggregate : NULL;
+    RBTree *tree = newRBTreeWithOptions(vectorCompare1By1, freeVector, &options);
+    unsigned long long state = 88172645463325252ULL;
+    Vector **vectors = malloc(sizeof(Vector *) * (size_t) (n + AGGREGATE_ROUNDS));
+    for (int i = 0; i < n + AGGREGATE_ROUNDS; ++i)
+    {
+        vectors[i] = malloc(sizeof(Vector));
+        vectors[i]->len = AGGREGATE_DIMENSION;
+        vectors[i]->vector = malloc(sizeof(double) * AGGREGATE_DIMENSION);
+        for (int j = 0; j < AGGREGATE_DIMENSION; ++j)
+        {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            vectors[i]->vector[j] = (double) (state % 1000000) / 1000;
+        }
+    }
+
+    double start = now();
+    for (int i = 0; i < n; ++i)
+    {
+        if (!addToRBTree(tree, vectors[i]))
+        {
+            freeVector(vectors[i]);
+            vectors[i] = NULL;
+        }
+    }
+    double buildTime = now() - start;
+
+    double checksum = 0;
+    start = now();
+    for (int round = 0; round < AGGREGATE_ROUNDS; ++round)
+    {
+        // a removed vector is freed, so it is forgotten.
+        size_t removed = (size_t) round * (size_t) n / AGGREGATE_ROUNDS;
+        if (vectors[removed] != NULL)
+        {
+            removeFromRBTree(tree, vectors[removed]);
+            vectors[removed] = NULL;
+        }
+        if (!addToRBTree(tree, vectors[n + round]))
+        {
+            freeVector(vectors[n + round]);
+        }
+        Vector *max = findMaxNormVectorInTree(tree);
+        checksum += max->vector[0];
+        freeVector(max);
+    }
+    double queryTime = now() - start;
+    printf("%-9s n=%-10d build=%.3fs rounds=%d in %.6fs (checksum %.3f)\n", variant, n, buildTime, AGGREGATE_ROUNDS,
+           queryTime, checksum);
+    freeRBTree(tree);
+    free(vectors);
+    return 0;
+}
+
+/*
+ * a per-thread sum, alone on its cache line.
+ */
+typedef struct PaddedSum
+{
+    long sum;
+    char padding[64 - sizeof(long)];
+} PaddedSum;
+
+/**
+ * forEachFunc that adds an int to a sum shared by all the threads.
+ */
+static int addToSharedSum(const void *object, void *args)
+{
+    __atomic_add_fetch((long *) args, *(const int *) object, __ATOMIC_RELAXED);
+    return 1;
+}
+
+/**
+ * forEachFunc that adds an int to the PaddedSum of its thread.
+ */
+static int addToSum(const void *object, void *args)
+{
+    ((PaddedSum *) args)->sum += *(const int *) object;
+    return 1;
+}
+
+/**
+ * CombineFunc of PaddedSums.
+ */
+static int combineSums(void *into, const void *from)
+{
+    ((PaddedSum *) into)->sum += ((const PaddedSum *) from)->sum;
+    return 1;
+}
+
+/**
+ * sums a tree of n random keys on 1 to (number of cores) threads, with parallelForEachRBTree into one shared atomic
+ * sum or with parallelReduceRBTree into per-thread sums, and reports the time and the speedup over one thread.
+ * @param variant "foreach" or "reduce"
+ * @param n
+ * @return 0 on success
+ */
+static int benchmarkParallel(const char *variant, int n)
+{
+    int reduce = strcmp(variant, "reduce") == 0;
+    if (!reduce && strcmp(variant, "foreach") != 0)
+    {
+        fprintf(stderr, USAGE);
+        return 1;
+    }
+    int *keys = shuffledKeys(n);
+    RBTree *tree = newRBTree(intCompare, intNoFree);
+    for (int i = 0; i < n; ++i)
+    {
+        addToRBTree(tree, &keys[i]);
+    }
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    cores = cores < 1 ? 1 : cores > PARALLEL_MAX_THREADS ? PARALLEL_MAX_THREADS : cores;
+    long expected = (long) n * (n - 1) / 2;
+
+    double serialTime = 0;
+    for (int threads = 1; threads <= cores; ++threads)
+    {
+        PaddedSum sums[PARALLEL_MAX_THREADS] = {{0, {0}}};
+        void *accumulators[PARALLEL_MAX_THREADS];
+        long shared = 0;
+        double start = now();
+        if (reduce)
+        {
+            for (int i = 0; i < threads; ++i)
+            {
+                accumulators[i] = &sums[i];
+            }
+            parallelReduceRBTree(tree, addToSum, accumulators, combineSums, threads);
+        }
+        else
+        {
+            parallelForEachRBTree(tree, addToSharedSum, &shared, threads);
+        }
+        double elapsed = now() - start;
+        serialTime = threads == 1 ? elapsed : serialTime;
+
+        long sum = reduce ? sums[0].sum : shared;
+        printf("%-8s n=%-10d threads=%-3d time=%.3fs speedup=%.2f%s\n", variant, n, threads, elapsed,
+               serialTime / elapsed, sum == expected ? "" : " (wrong sum)");
+    }
+    freeRBTree(tree);
+    free(keys);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, USAGE);
+        return 1;
+    }
+    int n = argc > 3 ? atoi(argv[3]) : DEFAULT_ELEMENTS;
+    if (n <= 0)
+    {
+        fprintf(stderr, USAGE);
+        return 1;
+    }
+    if (strcmp(argv[1], "pool") == 0)
+    {
+        return benchmarkPool(argv[2], n);
+    }
+    if (strcmp(argv[1], "lookup") == 0)
+    {
+        return benchmarkLookup(argv[2], n);
+    }
+    if (strcmp(argv[1], "typed") == 0)
+    {
+        return benchmarkTyped(argv[2], n);
+    }
+    if (strcmp(argv[1], "memory") == 0)
+    {
+        return benchmarkMemory(argv[2], n);
+    }
+    if (strcmp(argv[1], "concurrent") == 0)
+    {
+        return benchmarkConcurrent(argv[2], n);
+    }
+    if (strcmp(argv[1], "batch") == 0)
+    {
+        return benchmarkBatch(argv[2], n);
+    }
+    if (strcmp(argv[1], "parallel") == 0)
+    {
+        return benchmarkParallel(argv[2], n);
+    }
+    if (strcmp(argv[1], "sorted") == 0)
+    {
+        return benchmarkSorted(argv[2], n);
+    }
+    if (strcmp(argv[1], "prefix") == 0)
+    {
+        return benchmarkPrefix(argv[2], n);
+    }
+    if (strcmp(argv[1], "bloom") == 0)
+    {
+        return benchmarkBloom(argv[2], n);
+    }
+    if (strcmp(argv[1], "snapshot") == 0)
+    {
+        return benchmarkSnapshot(argv[2], n);
+    }
+    if (strcmp(argv[1], "split") == 0)
+    {
+        return benchmarkSplit(argv[2], n);
+    }
+    if (strcmp(argv[1], "set") == 0)
+    {
+        return benchmarkSet(argv[2], n);
+    }
+    if (strcmp(argv[1], "aggregate") == 0)
+    {
+        return benchmarkAggregate(argv[2], n);
+    }
+    fprintf(stderr, USAGE);
+    return 1;
+}
@@ -49,6 +49,26 @@ int vectorCompare1By1(const void *a, const void *b)
     return EQUAL;
 }
 
+/**
+ * PrefixFunc for Vectors: the first element, mapped to an integer that orders like the doubles do (0 for an empty
+ * vector, which is smaller than all others).
+ * @param a - pointer to a Vector
+ * @return the prefix of the vector
+ */
+uint64_t vectorPrefix(const void *a)
+{
+    const Vector *v = (const Vector *) a;
+    if (v->len == 0)
+    {
+        return 0;
+    }
+    double first = v->vector[0] == 0 ? 0 : v->vector[0]; // -0 is equal to 0, so it needs the same prefix
+    uint64_t bits;
+    memcpy(&bits, &first, sizeof(bits));
+    // negative doubles order backwards as integers: flip them, and put the positive ones above them.
+    return (bits >> 63) != 0 ? ~bits : bits | ((uint64_t) 1 << 63);
+}
+
 /**
  * @param vector
  * @return the first norm of the given vector
@@ -95,23 +115,74 @@ int copyIfNormIsLarger(const void *vector, void *maxVector)
         }
         v2->vector = v2V;
         v2->len = v1->len;
-        return SUCCESS;
     }
-    return FAILURE;
+    // a smaller norm is not a failure: forEachRBTree has to go on to the next vectors.
+    return SUCCESS;
+}
+
+/**
+ * AggregateValueFunc of maxNormAggregate: the norm of a vector, and the vector.
+ * @param vector pointer to Vector
+ * @param value pointer to MaxNorm
+ */
+static void maxNormValue(const void *vector, void *value)
+{
+    MaxNorm *max = (MaxNorm *) value;
+    max->norm = calculateNorm(vector);
+    max->vector = (const Vector *) vector;
+}
+
+/**
+ * AggregateCombineFunc of maxNormAggregate: keeps the vector of the larger norm (the lower vector on a tie, like
+ * copyIfNormIsLarger does in a walk).
+ * @param into pointer to MaxNorm of the lower vectors
+ * @param from pointer to MaxNorm of the greater vectors
+ */
+static void combineMaxNorms(void *into, const void *from)
+{
+    MaxNorm *max = (MaxNorm *) into;
+    const MaxNorm *other = (const MaxNorm *) from;
+    if (other->norm > max->norm)
+    {
+        *max = *other;
+    }
 }
 
+const RBTreeAggregate maxNormAggregate = {sizeof(MaxNorm), maxNormValue, combineMaxNorms};
+
 /**
  * @param tree a pointer to a tree of Vectors
- * @return pointer to a *copy* of the vector that has the largest norm (L2 Norm).
+ * @return pointer to a *copy* of the vector that has the largest norm (L2 Norm). a tree created with
+ * maxNormAggregate finds it in O(1) and copies it once, other trees are walked in O(n).
  */
 Vector *findMaxNormVectorInTree(RBTree *tree) // needs to free the vector outside!
 {
     Vector *maxVector = (Vector *) malloc(sizeof(Vector));
+    if (maxVector == NULL)
+    {
+        return NULL;
+    }
     maxVector->len = 0;
     maxVector->vector = NULL;
 
-    forEachRBTree(tree, copyIfNormIsLarger, maxVector);
-    return maxVector->len != 0 ? maxVector : NULL;
+    MaxNorm max;
+    if (tree != NULL && tree->aggregate.value == maxNormValue)
+    {
+        if (aggregateRBTree(tree, &max))
+        {
+            copyIfNormIsLarger(max.vector, maxVector);
+        }
+    }
+    else
+    {
+        forEachRBTree(tree, copyIfNormIsLarger, maxVector);
+    }
+    if (maxVector->len == 0)
+    {
+        freeVector(maxVector);
+        return NULL;
+    }
+    return maxVector;
 }
 
 /**
@@ -147,6 +218,41 @@ int stringCompare(const void *a, const void *b)
     return strcmp(x, y);
 }
 
+/**
+ * PrefixFunc for strings: the first 8 characters, big endian and padded with zeros, so the prefixes order like strcmp.
+ * @param a - char* pointer
+ * @return the prefix of the string
+ */
+uint64_t stringPrefix(const void *a)
+{
+    const unsigned char *s = (const unsigned char *) a;
+    uint64_t prefix = 0;
+    int ended = 0;
+    for (int i = 0; i < 8; ++i)
+    {
+        ended = ended || s[i] == '\0';
+        prefix = prefix << 8 | (ended ? 0 : s[i]);
+    }
+    return prefix;
+}
+
+/**
+ * SerializeFunc for strings: the string with its '\0', so the payloads in a mapped tree are strings themselves.
+ * @param a - char* pointer
+ * @param buffer - where to write the payload
+ * @param size - the size of buffer
+ * @return the size of the payload
+ */
+size_t serializeString(const void *a, void *buffer, size_t size)
+{
+    size_t bytes = strlen((const char *) a) + 1;
+    if (bytes <= size)
+    {
+        memcpy(buffer, a, bytes);
+    }
+    return bytes;
+}
+
 /**
  * ForEach function that concatenates the given word to pConcatenated. pConcatenated is already allocated with
  * enough space.
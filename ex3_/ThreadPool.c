@@ -0,0 +1,279 @@
+#define _GNU_SOURCE
+
+#include "ThreadPool.h"
+#include <sched.h>
+#include <stdlib.h>
+
+#define SUCCESS (1)
+#define FAILURE (0)
+
+/*
+ * what a worker thread needs to know.
+ */
+typedef struct WorkerArgs
+{
+    ThreadPool *pool;
+    int worker;
+} WorkerArgs;
+
+/**
+ * takes the newest task of a worker's own deque.
+ * @param deque
+ * @param task out
+ * @return 1 if a task was taken, 0 if the deque is empty
+ */
+static int popTask(WorkerDeque *deque, PoolTask *task)
+{
+    int taken = FAILURE;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->bottom > deque->top)
+    {
+        deque->bottom--;
+        *task = deque->tasks[deque->bottom % THREAD_POOL_DEQUE_SIZE];
+        taken = SUCCESS;
+    }
+    if (deque->bottom == deque->top)
+    {
+        deque->top = deque->bottom = 0;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return taken;
+}
+
+/**
+ * takes the oldest task of another worker's deque. the oldest tasks are the largest ones in a divide and conquer.
+ * @param deque
+ * @param task out
+ * @return 1 if a task was taken, 0 if the deque is empty
+ */
+static int stealTask(WorkerDeque *deque, PoolTask *task)
+{
+    int taken = FAILURE;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->bottom > deque->top)
+    {
+        *task = deque->tasks[deque->top % THREAD_POOL_DEQUE_SIZE];
+        deque->top++;
+        taken = SUCCESS;
+    }
+    if (deque->bottom == deque->top)
+    {
+        deque->top = deque->bottom = 0;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return taken;
+}
+
+/**
+ * runs one task of the worker's own deque, or one stolen from another worker.
+ * @param pool
+ * @param worker
+ * @return 1 if a task ran, 0 if there was no task to run
+ */
+static int runOneTask(ThreadPool *pool, int worker)
+{
+    PoolTask task;
+    int found = popTask(&pool->deques[worker], &task);
+    for (int i = 1; !found && i < pool->nThreads; ++i)
+    {
+        found = stealTask(&pool->deques[(worker + i) % pool->nThreads], &task);
+    }
+    if (!found)
+    {
+        return FAILURE;
+    }
+    task.func(pool, worker, task.context, task.task);
+    __atomic_sub_fetch(&pool->pending, 1, __ATOMIC_ACQ_REL);
+    return SUCCESS;
+}
+
+/**
+ * runs tasks until all the spawned tasks finished.
+ * @param pool
+ * @param worker
+ */
+static void workUntilDone(ThreadPool *pool, int worker)
+{
+    while (__atomic_load_n(&pool->pending, __ATOMIC_ACQUIRE) > 0)
+    {
+        if (!runOneTask(pool, worker))
+        {
+            sched_yield();
+        }
+    }
+}
+
+/**
+ * the loop of a worker thread: sleep until runThreadPool has work, then help until it is done.
+ * @param arg WorkerArgs, freed here
+ * @return NULL
+ */
+static void *runWorker(void *arg)
+{
+    WorkerArgs args = *(WorkerArgs *) arg;
+    free(arg);
+    ThreadPool *pool = args.pool;
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->shutdown)
+    {
+        if (__atomic_load_n(&pool->pending, __ATOMIC_ACQUIRE) == 0)
+        {
+            pthread_cond_wait(&pool->wakeUp, &pool->lock);
+            continue;
+        }
+        pthread_mutex_unlock(&pool->lock);
+        workUntilDone(pool, args.worker);
+        pthread_mutex_lock(&pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/**
+ * constructs a work-stealing pool: every worker pushes the tasks it spawns on its own deque and runs them newest
+ * first, and an idle worker steals the oldest task of another worker.
+ * @param nThreads: number of workers, including the thread that calls runThreadPool.
+ * @return: the new pool, NULL on failure.
+ */
+ThreadPool *newThreadPool(int nThreads)
+{
+    if (nThreads < 1)
+    {
+        return NULL;
+    }
+    ThreadPool *pool = malloc(sizeof(ThreadPool));
+    if (pool == NULL)
+    {
+        return NULL;
+    }
+    pool->nThreads = nThreads;
+    pool->pending = 0;
+    pool->shutdown = 0;
+    pool->deques = malloc(sizeof(WorkerDeque) * nThreads);
+    pool->threads = malloc(sizeof(pthread_t) * nThreads);
+    if (pool->deques == NULL || pool->threads == NULL)
+    {
+        free(pool->deques);
+        free(pool->threads);
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wakeUp, NULL);
+    for (int i = 0; i < nThreads; ++i)
+    {
+        pthread_mutex_init(&pool->deques[i].lock, NULL);
+        pool->deques[i].top = 0;
+        pool->deques[i].bottom = 0;
+    }
+
+    // if a thread can't be started, the pool works with the ones that did.
+    int started = 1;
+    for (int i = 1; i < nThreads; ++i)
+    {
+        WorkerArgs *args = malloc(sizeof(WorkerArgs));
+        if (args == NULL)
+        {
+            break;
+        }
+        args->pool = pool;
+        args->worker = started;
+        if (pthread_create(&pool->threads[started], NULL, runWorker, args) != 0)
+        {
+            free(args);
+            break;
+        }
+        started++;
+    }
+    pool->nThreads = started;
+    return pool;
+}
+
+/**
+ * @param pool: the pool.
+ * @return: the number of workers of the pool.
+ */
+int threadPoolSize(const ThreadPool *pool)
+{
+    return pool != NULL ? pool->nThreads : 0;
+}
+
+/**
+ * run a task and every task it spawns, with the calling thread as worker 0. returns when all of them finished.
+ * @param pool: the pool to run on.
+ * @param func: the first task.
+ * @param context: passed to func.
+ * @param task: passed to func.
+ */
+void runThreadPool(ThreadPool *pool, PoolTaskFunc func, void *context, void *task)
+{
+    if (pool == NULL || func == NULL)
+    {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    __atomic_add_fetch(&pool->pending, 1, __ATOMIC_ACQ_REL);
+    pthread_cond_broadcast(&pool->wakeUp);
+    pthread_mutex_unlock(&pool->lock);
+
+    func(pool, 0, context, task);
+    __atomic_sub_fetch(&pool->pending, 1, __ATOMIC_ACQ_REL);
+    workUntilDone(pool, 0);
+}
+
+/**
+ * spawn a task from inside a running task. if the deque of the worker is full, the task runs right away instead.
+ * @param pool: the pool the spawning task runs on.
+ * @param worker: the worker that runs the spawning task.
+ * @param func: the task to spawn.
+ * @param context: passed to func.
+ * @param task: passed to func.
+ */
+void spawnPoolTask(ThreadPool *pool, int worker, PoolTaskFunc func, void *context, void *task)
+{
+    WorkerDeque *deque = &pool->deques[worker];
+    pthread_mutex_lock(&deque->lock);
+    if (deque->bottom - deque->top == THREAD_POOL_DEQUE_SIZE)
+    {
+        pthread_mutex_unlock(&deque->lock);
+        func(pool, worker, context, task);
+        return;
+    }
+    // counted before it can be stolen, so pending never drops to 0 while the spawning task still runs.
+    __atomic_add_fetch(&pool->pending, 1, __ATOMIC_ACQ_REL);
+    PoolTask *slot = &deque->tasks[deque->bottom % THREAD_POOL_DEQUE_SIZE];
+    slot->func = func;
+    slot->context = context;
+    slot->task = task;
+    deque->bottom++;
+    pthread_mutex_unlock(&deque->lock);
+}
+
+/**
+ * stop the workers and free the pool. it must not be running.
+ * @param pool: the pool to free.
+ */
+void freeThreadPool(ThreadPool *pool)
+{
+    if (pool == NULL)
+    {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->wakeUp);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 1; i < pool->nThreads; ++i)
+    {
+        pthread_join(pool->threads[i], NULL);
+    }
+    for (int i = 0; i < pool->nThreads; ++i)
+    {
+        pthread_mutex_destroy(&pool->deques[i].lock);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wakeUp);
+    free(pool->deques);
+    free(pool->threads);
+    free(pool);
+}
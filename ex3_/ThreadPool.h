@@ -0,0 +1,103 @@
+#ifndef RBTREE_THREADPOOL_H
+#define RBTREE_THREADPOOL_H
+
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * maximal number of tasks waiting in the deque of one worker. a task that doesn't fit runs inline.
+ */
+#define THREAD_POOL_DEQUE_SIZE (1024)
+
+struct ThreadPool;
+
+/**
+ * a task of a thread pool.
+ * @pool: the pool that runs the task (to spawn more tasks on).
+ * @worker: index of the worker that runs the task, in [0, number of workers).
+ * @context: the context the task was spawned with.
+ * @task: the argument the task was spawned with.
+ */
+typedef void (*PoolTaskFunc)(struct ThreadPool *pool, int worker, void *context, void *task);
+
+/*
+ * a spawned task.
+ */
+typedef struct PoolTask
+{
+	PoolTaskFunc func;
+	void *context;
+	void *task;
+} PoolTask;
+
+/*
+ * the tasks of one worker: the owner pushes and pops at the bottom, thieves take from the top.
+ */
+typedef struct WorkerDeque
+{
+	pthread_mutex_t lock;
+	int top, bottom; // the tasks are tasks[top % size .. bottom % size)
+	PoolTask tasks[THREAD_POOL_DEQUE_SIZE];
+} WorkerDeque;
+
+/**
+ * a work-stealing thread pool.
+ */
+typedef struct ThreadPool
+{
+	int nThreads;
+	WorkerDeque *deques; // one per worker
+	pthread_t *threads; // workers 1..nThreads-1 (worker 0 is the thread in runThreadPool)
+	pthread_mutex_t lock; // guards the wake up of the workers
+	pthread_cond_t wakeUp;
+	int pending; // spawned tasks that didn't finish yet
+	int shutdown;
+} ThreadPool;
+
+/**
+ * constructs a work-stealing pool: every worker pushes the tasks it spawns on its own deque and runs them newest
+ * first, and an idle worker steals the oldest task of another worker.
+ * @param nThreads: number of workers, including the thread that calls runThreadPool.
+ * @return: the new pool, NULL on failure.
+ */
+ThreadPool *newThreadPool(int nThreads);
+
+/**
+ * @param pool: the pool.
+ * @return: the number of workers of the pool.
+ */
+int threadPoolSize(const ThreadPool *pool);
+
+/**
+ * run a task and every task it spawns, with the calling thread as worker 0. returns when all of them finished.
+ * @param pool: the pool to run on.
+ * @param func: the first task.
+ * @param context: passed to func.
+ * @param task: passed to func.
+ */
+void runThreadPool(ThreadPool *pool, PoolTaskFunc func, void *context, void *task);
+
+/**
+ * spawn a task from inside a running task. if the deque of the worker is full, the task runs right away instead.
+ * @param pool: the pool the spawning task runs on.
+ * @param worker: the worker that runs the spawning task.
+ * @param func: the task to spawn.
+ * @param context: passed to func.
+ * @param task: passed to func.
+ */
+void spawnPoolTask(ThreadPool *pool, int worker, PoolTaskFunc func, void *context, void *task);
+
+/**
+ * stop the workers and free the pool. it must not be running.
+ * @param pool: the pool to free.
+ */
+void freeThreadPool(ThreadPool *pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //RBTREE_THREADPOOL_H
@@ -0,0 +1,389 @@
+#ifndef RBTREE_TYPEDRBTREE_H
+#define RBTREE_TYPEDRBTREE_H
+
+#include "RBTree.h"
+#include "FrozenRBTree.h"
+#include <stdlib.h>
+
+/**
+ * a compare "function" for numbers, usable as the CMP argument of RBTREE_DEFINE.
+ * @return: equal to 0 iff a == b. lower than 0 if a < b. Greater than 0 iff b < a.
+ */
+#define RBTREE_NUMBER_COMPARE(a, b) (((a) > (b)) - ((a) < (b)))
+
+/**
+ * defines a red-black tree of keys of a single type. the keys are stored by value inside the nodes and CMP is
+ * called directly, so the compiler can inline it instead of calling through a CompareFunc and a void *.
+ * the generated API mirrors RBTree.h:
+ *
+ *     Name *newName(void);
+ *     int addToName(Name *tree, KeyType key);
+ *     int containsName(const Name *tree, KeyType key);
+ *     int forEachName(const Name *tree, NameForEachFunc func, void *args);
+ *     void freeName(Name *tree);
+ *
+ * with the same return values as their RBTree.h counterparts, and a read only NameFrozen that keeps the keys by value
+ * in the Eytzinger order of FrozenRBTree.h:
+ *
+ *     NameFrozen *freezeName(Name *tree);
+ *     Name *thawName(NameFrozen *frozen);
+ *     int containsFrozenName(const NameFrozen *frozen, KeyType key);
+ *     void freeFrozenName(NameFrozen *frozen);
+ *
+ * with the return values of their FrozenRBTree.h counterparts (thawName inserts the keys one by one).
+ * @param Name: name of the tree type (e.g. IntTree).
+ * @param KeyType: type of the keys (any type that can be assigned, e.g. int, double or a struct of a char array).
+ * @param CMP: a function or a function-like macro CMP(KeyType a, KeyType b) with the semantics of CompareFunc.
+ */
+#define RBTREE_DEFINE(Name, KeyType, CMP) \
+\
+typedef struct Name##Node \
+{ \
+    struct Name##Node *parent, *left, *right; \
+    Color color; \
+    KeyType key; \
+} Name##Node; \
+\
+typedef struct Name \
+{ \
+    Name##Node *root; \
+    int size; \
+} Name; \
+\
+typedef int (*Name##ForEachFunc)(KeyType key, void *args); \
+\
+static inline Name *new##Name(void) \
+{ \
+    Name *tree = (Name *) malloc(sizeof(Name)); \
+    if (tree != NULL) \
+    { \
+        tree->root = NULL; \
+        tree->size = 0; \
+    } \
+    return tree; \
+} \
+\
+static inline void rotate##Name##Left(Name *tree, Name##Node *g) \
+{ \
+    Name##Node *p = g->right; \
+    g->right = p->left; \
+    if (p->left != NULL) \
+    { \
+        p->left->parent = g; \
+    } \
+    p->parent = g->parent; \
+    if (g->parent == NULL) \
+    { \
+        tree->root = p; \
+    } \
+    else if (g->parent->left == g) \
+    { \
+        g->parent->left = p; \
+    } \
+    else \
+    { \
+        g->parent->right = p; \
+    } \
+    p->left = g; \
+    g->parent = p; \
+} \
+\
+static inline void rotate##Name##Right(Name *tree, Name##Node *g) \
+{ \
+    Name##Node *p = g->left; \
+    g->left = p->right; \
+    if (p->right != NULL) \
+    { \
+        p->right->parent = g; \
+    } \
+    p->parent = g->parent; \
+    if (g->parent == NULL) \
+    { \
+        tree->root = p; \
+    } \
+    else if (g->parent->left == g) \
+    { \
+        g->parent->left = p; \
+    } \
+    else \
+    { \
+        g->parent->right = p; \
+    } \
+    p->right = g; \
+    g->parent = p; \
+} \
+\
+/* the fixTree of RBTree.c: recolor on a red uncle, otherwise straighten the path and rotate the grandparent. */ \
+static inline void fix##Name(Name *tree, Name##Node *node) \
+{ \
+    while (node != tree->root && node->parent->color == RED) \
+    { \
+        Name##Node *parent = node->parent; \
+        Name##Node *grandparent = parent->parent; \
+        Name##Node *uncle = grandparent->left == parent ? grandparent->right : grandparent->left; \
+        if (uncle != NULL && uncle->color == RED) \
+        { \
+            uncle->color = BLACK; \
+            parent->color = BLACK; \
+            grandparent->color = RED; \
+            node = grandparent; \
+            continue; \
+        } \
+        if (grandparent->left == parent) \
+        { \
+            if (parent->right == node) \
+            { \
+                rotate##Name##Left(tree, parent); \
+                parent = node; \
+            } \
+            rotate##Name##Right(tree, grandparent); \
+        } \
+        else \
+        { \
+            if (parent->left == node) \
+            { \
+                rotate##Name##Right(tree, parent); \
+                parent = node; \
+            } \
+            rotate##Name##Left(tree, grandparent); \
+        } \
+        parent->color = BLACK; \
+        grandparent->color = RED; \
+        break; \
+    } \
+    tree->root->color = BLACK; \
+} \
+\
+static inline int addTo##Name(Name *tree, KeyType key) \
+{ \
+    if (tree == NULL) \
+    { \
+        return 0; \
+    } \
+    Name##Node *parent = NULL; \
+    Name##Node *current = tree->root; \
+    int comp = 0; \
+    while (current != NULL) \
+    { \
+        comp = CMP(current->key, key); \
+        if (comp == 0) \
+        { \
+            return 0; \
+        } \
+        parent = current; \
+        current = comp > 0 ? current->left : current->right; \
+    } \
+    Name##Node *node = (Name##Node *) malloc(sizeof(Name##Node)); \
+    if (node == NULL) \
+    { \
+        return 0; \
+    } \
+    node->key = key; \
+    node->color = RED; \
+    node->left = NULL; \
+    node->right = NULL; \
+    node->parent = parent; \
+    if (parent == NULL) \
+    { \
+        tree->root = node; \
+    } \
+    else if (comp > 0) \
+    { \
+        parent->left = node; \
+    } \
+    else \
+    { \
+        parent->right = node; \
+    } \
+    tree->size++; \
+    fix##Name(tree, node); \
+    return 1; \
+} \
+\
+static inline int contains##Name(const Name *tree, KeyType key) \
+{ \
+    const Name##Node *current = tree != NULL ? tree->root : NULL; \
+    while (current != NULL) \
+    { \
+        int comp = CMP(current->key, key); \
+        if (comp == 0) \
+        { \
+            return 1; \
+        } \
+        current = comp > 0 ? current->left : current->right; \
+    } \
+    return 0; \
+} \
+\
+static inline int forEach##Name(const Name *tree, Name##ForEachFunc func, void *args) \
+{ \
+    if (tree == NULL || tree->root == NULL || func == NULL) \
+    { \
+        return 0; \
+    } \
+    const Name##Node *node = tree->root; \
+    while (node->left != NULL) \
+    { \
+        node = node->left; \
+    } \
+    while (node != NULL) \
+    { \
+        if (func(node->key, args) == 0) \
+        { \
+            return 0; \
+        } \
+        if (node->right != NULL) \
+        { \
+            node = node->right; \
+            while (node->left != NULL) \
+            { \
+                node = node->left; \
+            } \
+        } \
+        else \
+        { \
+            while (node->parent != NULL && node->parent->right == node) \
+            { \
+                node = node->parent; \
+            } \
+            node = node->parent; \
+        } \
+    } \
+    return 1; \
+} \
+\
+static inline void free##Name(Name *tree) \
+{ \
+    if (tree == NULL) \
+    { \
+        return; \
+    } \
+    /* free bottom up without recursion: descend to a leaf, free it and continue from its parent. */ \
+    Name##Node *node = tree->root; \
+    while (node != NULL) \
+    { \
+        if (node->left != NULL) \
+        { \
+            node = node->left; \
+        } \
+        else if (node->right != NULL) \
+        { \
+            node = node->right; \
+        } \
+        else \
+        { \
+            Name##Node *parent = node->parent; \
+            if (parent != NULL) \
+            { \
+                if (parent->left == node) \
+                { \
+                    parent->left = NULL; \
+                } \
+                else \
+                { \
+                    parent->right = NULL; \
+                } \
+            } \
+            free(node); \
+            node = parent; \
+        } \
+    } \
+    free(tree); \
+} \
+\
+typedef struct Name##Frozen \
+{ \
+    KeyType *keys; /* keys[1..size] in an Eytzinger order, aligned to a cache line. */ \
+    void *block; \
+    int size; \
+} Name##Frozen; \
+\
+typedef struct Name##FrozenFill \
+{ \
+    KeyType *keys; \
+    size_t next; \
+    size_t size; \
+} Name##FrozenFill; \
+\
+static inline int place##Name##Key(KeyType key, void *args) \
+{ \
+    Name##FrozenFill *fill = (Name##FrozenFill *) args; \
+    fill->keys[fill->next] = key; \
+    fill->next = eytzingerNext(fill->next, fill->size); \
+    return 1; \
+} \
+\
+static inline Name##Frozen *freeze##Name(Name *tree) \
+{ \
+    if (tree == NULL) \
+    { \
+        return NULL; \
+    } \
+    Name##Frozen *frozen = (Name##Frozen *) malloc(sizeof(Name##Frozen)); \
+    if (frozen == NULL) \
+    { \
+        return NULL; \
+    } \
+    frozen->block = malloc(sizeof(KeyType) * ((size_t) tree->size + 1) + FROZEN_CACHE_LINE - 1); \
+    if (frozen->block == NULL) \
+    { \
+        free(frozen); \
+        return NULL; \
+    } \
+    frozen->keys = (KeyType *) frozenAlign(frozen->block); \
+    frozen->size = tree->size; \
+    Name##FrozenFill fill = {frozen->keys, eytzingerFirst((size_t) tree->size), (size_t) tree->size}; \
+    forEach##Name(tree, place##Name##Key, &fill); \
+    free##Name(tree); \
+    return frozen; \
+} \
+\
+/* the descent of FrozenRBTree.c, comparing the keys in place. */ \
+static inline int containsFrozen##Name(const Name##Frozen *frozen, KeyType key) \
+{ \
+    if (frozen == NULL) \
+    { \
+        return 0; \
+    } \
+    size_t stride = sizeof(KeyType) < FROZEN_CACHE_LINE ? FROZEN_CACHE_LINE / sizeof(KeyType) : 1; \
+    size_t k = 1; \
+    size_t n = (size_t) frozen->size; \
+    while (k <= n) \
+    { \
+        __builtin_prefetch(frozen->keys + stride * k); \
+        k = 2 * k + (CMP(frozen->keys[k], key) < 0); \
+    } \
+    k = eytzingerLowerBound(k); \
+    return k != 0 && CMP(frozen->keys[k], key) == 0; \
+} \
+\
+static inline void freeFrozen##Name(Name##Frozen *frozen) \
+{ \
+    if (frozen != NULL) \
+    { \
+        free(frozen->block); \
+        free(frozen); \
+    } \
+} \
+\
+static inline Name *thaw##Name(Name##Frozen *frozen) \
+{ \
+    Name *tree = frozen != NULL ? new##Name() : NULL; \
+    if (tree == NULL) \
+    { \
+        return NULL; \
+    } \
+    size_t n = (size_t) frozen->size; \
+    for (size_t k = eytzingerFirst(n); k != 0; k = eytzingerNext(k, n)) \
+    { \
+        if (!addTo##Name(tree, frozen->keys[k])) \
+        { \
+            free##Name(tree); \
+            return NULL; \
+        } \
+    } \
+    freeFrozen##Name(frozen); \
+    return tree; \
+}
+
+#endif //RBTREE_TYPEDRBTREE_H
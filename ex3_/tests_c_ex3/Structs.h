@@ -3,6 +3,7 @@
 //
 
 #include "RBTree.h"
+#include <stddef.h>
 
 #ifndef TA_EX3_STRUCTS_H
 #define TA_EX3_STRUCTS_H
@@ -20,6 +21,22 @@ typedef struct Vector
     double *vector;
 } Vector;
 
+/**
+ * the aggregate value of maxNormAggregate: the vector with the largest norm among some vectors (the lowest one on a
+ * tie), and its norm.
+ */
+typedef struct MaxNorm
+{
+    double norm;
+    const Vector *vector;
+} MaxNorm;
+
+/**
+ * an aggregate for trees of Vectors (see RBTreeOptions::aggregate): the MaxNorm of each subtree, so
+ * findMaxNormVectorInTree takes O(1) and aggregateRangeRBTree finds the largest norm in a range in O(log n).
+ */
+extern const RBTreeAggregate maxNormAggregate; // implement it in Structs.c
+
 /**
  * CompFunc for strings (assumes strings end with "\0")
  * @param a - char* pointer
@@ -29,6 +46,22 @@ typedef struct Vector
  */
 int stringCompare(const void *a, const void *b); // implement it in Structs.c
 
+/**
+ * PrefixFunc for strings: the first 8 characters, big endian and padded with zeros, so the prefixes order like strcmp.
+ * @param a - char* pointer
+ * @return the prefix of the string
+ */
+uint64_t stringPrefix(const void *a); // implement it in Structs.c
+
+/**
+ * SerializeFunc for strings: the string with its '\0', so the payloads in a mapped tree are strings themselves.
+ * @param a - char* pointer
+ * @param buffer - where to write the payload
+ * @param size - the size of buffer
+ * @return the size of the payload
+ */
+size_t serializeString(const void *a, void *buffer, size_t size); // implement it in Structs.c
+
 /**
  * ForEach function that concatenates the given word to pConcatenated. pConcatenated is already allocated with
  * enough space.
@@ -53,6 +86,14 @@ void freeString(void *s); // implement it in Structs.c
  */
 int vectorCompare1By1(const void *a, const void *b); // implement it in Structs.c
 
+/**
+ * PrefixFunc for Vectors: the first element, mapped to an integer that orders like the doubles do (0 for an empty
+ * vector, which is smaller than all others).
+ * @param a - pointer to a Vector
+ * @return the prefix of the vector
+ */
+uint64_t vectorPrefix(const void *a); // implement it in Structs.c
+
 /**
  * FreeFunc for vectors
  */
@@ -69,7 +110,8 @@ int copyIfNormIsLarger(const void *pVector, void *pMaxVector); // implement it i
 
 /**
  * @param tree a pointer to a tree of Vectors
- * @return pointer to a *copy* of the vector that has the largest norm (L2 Norm).
+ * @return pointer to a *copy* of the vector that has the largest norm (L2 Norm). a tree created with
+ * maxNormAggregate finds it in O(1) and copies it once, other trees are walked in O(n).
  */
 Vector *findMaxNormVectorInTree(RBTree *tree); // implement it in Structs.c You must use copyIfNormIsLarger in the implementation!
 
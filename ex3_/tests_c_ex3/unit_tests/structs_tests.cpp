@@ -4,11 +4,14 @@
 
 #include "RBTree.h"
 #include "Structs.h"
+#include "MappedRBTree.h"
+#include "FrozenRBTree.h"
 #include "catch.hpp"
 #include <iterator>
 #include <set>
 #include <algorithm>
 #include <cstring>
+#include <cstdio>
 #include "tree_visualizer/util.hpp"
 
 static Vector* args_to_vector(std::initializer_list<double> args)
@@ -148,4 +151,390 @@ SCENARIO("Vector operations", "[vector]")
 
         freeRBTree(tree);
     }
-}
\ No newline at end of file
+
+    GIVEN("A vector tree whose largest norm is in the middle, after a smaller one") {
+        auto expectedMaxVector = args_to_vector({1, 20});
+        RBTree* tree = vectors_to_tree({args_to_vector({-3, 1}), args_to_vector({0, 1}), expectedMaxVector,
+                                        args_to_vector({2, 0}), args_to_vector({3, 1})});
+
+        THEN("the walk doesn't stop at the first smaller norm") {
+            Vector* maxVector = findMaxNormVectorInTree(tree);
+            REQUIRE(maxVector != NULL);
+            CHECK(2 == maxVector->len);
+            CHECK(std::equal(maxVector->vector, maxVector->vector + 2, expectedMaxVector->vector));
+            freeVector(maxVector);
+        }
+
+        freeRBTree(tree);
+    }
+
+    GIVEN("A tree of empty vectors") {
+        RBTree* tree = vectors_to_tree({args_to_vector({})});
+        REQUIRE(findMaxNormVectorInTree(tree) == NULL);
+        freeRBTree(tree);
+    }
+}
+
+SCENARIO("Bound and range queries on string and vector trees", "[bounds]")
+{
+    GIVEN("A string tree of apple, banana, cherry, date")
+    {
+        RBTree *tree = strings_to_tree({"date", "banana", "apple", "cherry"});
+
+        THEN("the bounds find the neighbours of a missing string")
+        {
+            REQUIRE(std::string((char*)lowerBoundRBTree(tree, "b")) == "banana");
+            REQUIRE(std::string((char*)upperBoundRBTree(tree, "banana")) == "cherry");
+            REQUIRE(std::string((char*)floorRBTree(tree, "c")) == "banana");
+            REQUIRE(std::string((char*)ceilRBTree(tree, "cherry")) == "cherry");
+            REQUIRE(floorRBTree(tree, "a") == NULL);
+            REQUIRE(upperBoundRBTree(tree, "date") == NULL);
+        }
+
+        THEN("a range visits [lo, hi) in order")
+        {
+            char buf[64] = "";
+            REQUIRE(forEachRBTreeRange(tree, "b", "date", [](const void* word, void* out) {
+                strcat((char*)out, (const char*)word);
+                strcat((char*)out, ",");
+                return 1;
+            }, buf));
+            REQUIRE(std::string(buf) == "banana,cherry,");
+        }
+
+        freeRBTree(tree);
+    }
+
+    GIVEN("A vector tree")
+    {
+        RBTree *tree = vectors_to_tree({args_to_vector({1, 2}), args_to_vector({1, 2, 3}), args_to_vector({2, 0})});
+        Vector *probe = args_to_vector({1, 2, 0});
+
+        THEN("the bounds follow vectorCompare1By1")
+        {
+            Vector *ceil = (Vector*)ceilRBTree(tree, probe);
+            Vector *floor = (Vector*)floorRBTree(tree, probe);
+            REQUIRE(ceil != NULL);
+            REQUIRE(floor != NULL);
+            REQUIRE(ceil->len == 3);
+            REQUIRE(ceil->vector[2] == 3);
+            REQUIRE(floor->len == 2);
+            REQUIRE(floor->vector[0] == 1);
+        }
+
+        freeVector(probe);
+        freeRBTree(tree);
+    }
+}
+
+SCENARIO("Structs work unchanged on a B+ engine tree", "[bplus]")
+{
+    GIVEN("Some vectors in a B+ engine tree")
+    {
+        RBTreeOptions options = {};
+        options.engine = BPLUS_ENGINE;
+        RBTree *tree = newRBTreeWithOptions(vectorCompare1By1, freeVector, &options);
+        Vector *expectedMaxVector = args_to_vector({0, 4, 4, 200});
+        addToRBTree(tree, args_to_vector({7, 3, 3, 1}));
+        addToRBTree(tree, expectedMaxVector);
+        addToRBTree(tree, args_to_vector({200, 0, 0, 0}));
+
+        THEN("findMaxNormVectorInTree finds the vector with the largest norm")
+        {
+            Vector *maxVector = findMaxNormVectorInTree(tree);
+            REQUIRE(maxVector != NULL);
+            CHECK(std::equal(maxVector->vector, maxVector->vector + 4, expectedMaxVector->vector));
+            freeVector(maxVector);
+        }
+
+        freeRBTree(tree);
+    }
+}
+
+SCENARIO("Prefixes of strings and vectors order like their CompFuncs", "[prefix]")
+{
+    GIVEN("Strings that share their first 8 characters, and short ones")
+    {
+        std::vector<std::string> words = {"abcdefgh", "abcdefghz", "abcdefgha", "abcdefg", "abc", "", "b", "\xff",
+                                          "abcdefgh\x01", "zzzzzzzzzz", "a", "abcdefgi"};
+        RBTreeOptions options = {};
+        options.prefixFunc = stringPrefix;
+        options.orderStatistics = 1;
+        RBTree *tree = newRBTreeWithOptions(stringCompare, freeString, &options);
+        for (const auto &word : words)
+        {
+            REQUIRE(addToRBTree(tree, strdup(word.c_str())));
+        }
+
+        THEN("prefixes never contradict stringCompare")
+        {
+            for (const auto &a : words)
+            {
+                for (const auto &b : words)
+                {
+                    int comp = stringCompare(a.c_str(), b.c_str());
+                    if (stringPrefix(a.c_str()) < stringPrefix(b.c_str()))
+                    {
+                        REQUIRE(comp < 0);
+                    }
+                    if (comp == 0)
+                    {
+                        REQUIRE(stringPrefix(a.c_str()) == stringPrefix(b.c_str()));
+                    }
+                }
+            }
+        }
+
+        THEN("the tree orders and finds the strings like a tree without prefixes")
+        {
+            std::vector<std::string> sorted(words);
+            std::sort(sorted.begin(), sorted.end(), [](const std::string &a, const std::string &b) {
+                return strcmp(a.c_str(), b.c_str()) < 0;
+            });
+            for (size_t i = 0; i < sorted.size(); ++i)
+            {
+                REQUIRE(containsRBTree(tree, (void*)sorted[i].c_str()));
+                REQUIRE(rankRBTree(tree, sorted[i].c_str()) == (int)i);
+                REQUIRE(std::string((char*)selectRBTree(tree, (int)i)) == sorted[i]);
+            }
+            REQUIRE(!containsRBTree(tree, (void*)"abcdefgb"));
+            REQUIRE(!addToRBTree(tree, (void*)"abcdefgha"));
+            REQUIRE(std::string((char*)lowerBoundRBTree(tree, "abcdefgh\x02")) == "abcdefgha");
+            REQUIRE(std::string((char*)floorRBTree(tree, "abcdefgb")) == "abcdefg");
+            REQUIRE(removeFromRBTree(tree, "abcdefgh"));
+            REQUIRE(!containsRBTree(tree, (void*)"abcdefgh"));
+            REQUIRE(containsRBTree(tree, (void*)"abcdefgh\x01"));
+        }
+
+        freeRBTree(tree);
+    }
+
+    GIVEN("Vectors with negative, zero and equal first elements")
+    {
+        std::vector<Vector*> vectors = {args_to_vector({-0.0, 1}), args_to_vector({0.0, -1}), args_to_vector({-2.5}),
+                                        args_to_vector({-2.5, 3}), args_to_vector({1e300}), args_to_vector({}),
+                                        args_to_vector({-1e-300}), args_to_vector({1e-300, 2})};
+        RBTreeOptions options = {};
+        options.prefixFunc = vectorPrefix;
+        RBTree *tree = newRBTreeWithOptions(vectorCompare1By1, freeVector, &options);
+        for (Vector *vector : vectors)
+        {
+            REQUIRE(addToRBTree(tree, vector));
+        }
+
+        THEN("prefixes never contradict vectorCompare1By1")
+        {
+            for (Vector *a : vectors)
+            {
+                for (Vector *b : vectors)
+                {
+                    if (vectorPrefix(a) < vectorPrefix(b))
+                    {
+                        REQUIRE(vectorCompare1By1(a, b) < 0);
+                    }
+                }
+            }
+        }
+
+        THEN("the tree finds every vector, and -0 as 0")
+        {
+            for (Vector *vector : vectors)
+            {
+                REQUIRE(containsRBTree(tree, vector));
+            }
+            Vector *probe = args_to_vector({0.0, 1});
+            REQUIRE(containsRBTree(tree, probe));
+            REQUIRE(!addToRBTree(tree, probe));
+            freeVector(probe);
+        }
+
+        freeRBTree(tree);
+    }
+}
+
+static int appendString(const void *object, void *args)
+{
+    static_cast<std::vector<std::string>*>(args)->push_back((const char*)object);
+    return 1;
+}
+
+SCENARIO("Snapshots are mapped back as read only trees", "[mapped]")
+{
+    const char *path = "rbtree_test.snapshot";
+    GIVEN("A saved string tree")
+    {
+        std::vector<std::string> words;
+        for (int i = 0; i < 500; ++i)
+        {
+            words.push_back(std::string(i % 40, 'a' + i % 26) + std::to_string(i * 7919 % 500));
+        }
+        RBTree *tree = newRBTree(stringCompare, freeString);
+        for (const auto &word : words)
+        {
+            addToRBTree(tree, strdup(word.c_str()));
+        }
+        REQUIRE(saveRBTree(tree, path, serializeString));
+        std::vector<std::string> expected;
+        forEachRBTree(tree, appendString, &expected);
+        freeRBTree(tree);
+
+        RBTree *mapped = mapRBTree(path, stringCompare);
+        REQUIRE(mapped != nullptr);
+
+        THEN("the mapped tree answers the queries of the saved one")
+        {
+            REQUIRE(mapped->size == (int)expected.size());
+            std::vector<std::string> walked;
+            REQUIRE(forEachRBTree(mapped, appendString, &walked));
+            REQUIRE(walked == expected);
+            for (const auto &word : expected)
+            {
+                REQUIRE(containsRBTree(mapped, (void*)word.c_str()));
+                REQUIRE(std::string((char*)findRBTree(mapped, word.c_str())) == word);
+            }
+            REQUIRE(!containsRBTree(mapped, (void*)"zzzzzz"));
+            REQUIRE(std::string((char*)lowerBoundRBTree(mapped, "b")) ==
+                    *std::lower_bound(expected.begin(), expected.end(), std::string("b")));
+            REQUIRE(lowerBoundRBTree(mapped, "{") == nullptr);
+            std::vector<std::string> probes(expected);
+            for (const auto &word : expected)
+            {
+                probes.push_back(word + "!");
+            }
+            probes.push_back("");
+            probes.push_back("{");
+            for (const auto &probe : probes)
+            {
+                auto upper = std::upper_bound(expected.begin(), expected.end(), probe);
+                char *gotten = (char*)upperBoundRBTree(mapped, probe.c_str());
+                REQUIRE((upper == expected.end() ? gotten == nullptr : gotten != nullptr && *upper == gotten));
+                gotten = (char*)floorRBTree(mapped, probe.c_str());
+                REQUIRE((upper == expected.begin() ? gotten == nullptr : gotten != nullptr && *(upper - 1) == gotten));
+                auto lower = std::lower_bound(expected.begin(), expected.end(), probe);
+                gotten = (char*)ceilRBTree(mapped, probe.c_str());
+                REQUIRE((lower == expected.end() ? gotten == nullptr : gotten != nullptr && *lower == gotten));
+            }
+
+            std::vector<std::string> range;
+            REQUIRE(forEachRBTreeRange(mapped, "c", "f", appendString, &range));
+            std::vector<std::string> expectedRange;
+            std::copy_if(expected.begin(), expected.end(), std::back_inserter(expectedRange),
+                         [](const std::string &word) { return word >= "c" && word < "f"; });
+            REQUIRE(!expectedRange.empty());
+            REQUIRE(range == expectedRange);
+        }
+
+        THEN("the mapped tree is read only")
+        {
+            char *word = strdup("new word");
+            REQUIRE(!addToRBTree(mapped, word));
+            REQUIRE(insertOrGetRBTree(mapped, word) == nullptr);
+            REQUIRE(!removeFromRBTree(mapped, expected[0].c_str()));
+            REQUIRE(freezeRBTree(mapped) == nullptr);
+            free(word);
+        }
+
+        freeRBTree(mapped);
+        std::remove(path);
+    }
+
+    GIVEN("An empty tree and files that aren't snapshots")
+    {
+        RBTree *tree = newRBTree(stringCompare, freeString);
+        REQUIRE(saveRBTree(tree, path, serializeString));
+        freeRBTree(tree);
+        RBTree *mapped = mapRBTree(path, stringCompare);
+        REQUIRE(mapped != nullptr);
+        REQUIRE(mapped->size == 0);
+        REQUIRE(!containsRBTree(mapped, (void*)"a"));
+        REQUIRE(forEachRBTreeRange(mapped, "a", "b", appendString, nullptr));
+        freeRBTree(mapped);
+
+        FILE *file = std::fopen(path, "wb");
+        std::fputs("not a snapshot, but long enough to hold a header", file);
+        std::fclose(file);
+        REQUIRE(mapRBTree(path, stringCompare) == nullptr);
+        std::remove(path);
+        REQUIRE(mapRBTree(path, stringCompare) == nullptr);
+    }
+
+    GIVEN("Snapshots whose index points outside the payloads")
+    {
+        RBTree *tree = strings_to_tree({"apple", "banana", "cherry"});
+        REQUIRE(saveRBTree(tree, path, serializeString));
+        freeRBTree(tree);
+        uint64_t fileSize = 0;
+        FILE *file = std::fopen(path, "r+b");
+        REQUIRE(std::fseek(file, (long) offsetof(MappedHeader, fileSize), SEEK_SET) == 0);
+        REQUIRE(std::fread(&fileSize, sizeof(fileSize), 1, file) == 1);
+
+        for (uint64_t offset : {fileSize, fileSize + 4096, (uint64_t) 1, fileSize - 3})
+        {
+            // index[2] holds the offset of the smallest of the 3 items.
+            REQUIRE(std::fseek(file, (long) (sizeof(MappedHeader) + 2 * sizeof(uint64_t)), SEEK_SET) == 0);
+            REQUIRE(std::fwrite(&offset, sizeof(offset), 1, file) == 1);
+            REQUIRE(std::fflush(file) == 0);
+            REQUIRE(mapRBTree(path, stringCompare) == nullptr);
+        }
+        std::fclose(file);
+        std::remove(path);
+    }
+}
+
+SCENARIO("Vector trees keep the largest norm of every subtree", "[aggregate]")
+{
+    GIVEN("Some vectors in a tree with maxNormAggregate")
+    {
+        RBTreeOptions options = {};
+        options.aggregate = &maxNormAggregate;
+        RBTree *tree = newRBTreeWithOptions(vectorCompare1By1, freeVector, &options);
+        REQUIRE(tree != nullptr);
+        Vector *expectedMaxVector = args_to_vector({0, 4, 4, 200});
+        Vector *secondMaxVector = args_to_vector({200, 0, 0, 0});
+        for (Vector *vector : {args_to_vector({7, 3, 3, 1}), args_to_vector({1, 5, 5, 7}), expectedMaxVector,
+                               args_to_vector({20, 0, 0, 1}), args_to_vector({0, 0, 0, 0}), secondMaxVector})
+        {
+            REQUIRE(addToRBTree(tree, vector));
+        }
+
+        THEN("findMaxNormVectorInTree reads the largest norm at the root")
+        {
+            MaxNorm max;
+            REQUIRE(aggregateRBTree(tree, &max));
+            REQUIRE(max.vector == expectedMaxVector);
+            Vector *maxVector = findMaxNormVectorInTree(tree);
+            REQUIRE(maxVector != NULL);
+            REQUIRE(maxVector != expectedMaxVector);
+            CHECK(std::equal(maxVector->vector, maxVector->vector + 4, expectedMaxVector->vector));
+            freeVector(maxVector);
+        }
+
+        THEN("the largest norm follows removes, and is found in a range")
+        {
+            REQUIRE(removeFromRBTree(tree, expectedMaxVector));
+            MaxNorm max;
+            REQUIRE(aggregateRBTree(tree, &max));
+            REQUIRE(max.vector == secondMaxVector);
+            Vector *lo = args_to_vector({1});
+            Vector *hi = args_to_vector({20});
+            REQUIRE(aggregateRangeRBTree(tree, lo, hi, &max));
+            REQUIRE(max.norm == 1 + 5 * 5 + 5 * 5 + 7 * 7);
+            REQUIRE(!aggregateRangeRBTree(tree, hi, lo, &max));
+            freeVector(lo);
+            freeVector(hi);
+        }
+
+        freeRBTree(tree);
+    }
+
+    GIVEN("A tree of empty vectors")
+    {
+        RBTreeOptions options = {};
+        options.aggregate = &maxNormAggregate;
+        RBTree *tree = newRBTreeWithOptions(vectorCompare1By1, freeVector, &options);
+        REQUIRE(findMaxNormVectorInTree(tree) == NULL);
+        addToRBTree(tree, args_to_vector({}));
+        REQUIRE(findMaxNormVectorInTree(tree) == NULL);
+        freeRBTree(tree);
+    }
+}
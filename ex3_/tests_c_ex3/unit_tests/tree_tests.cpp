@@ -1,10 +1,22 @@
 #define CATCH_CONFIG_MAIN
 #include "catch.hpp"
 #include "RBTree.h"
+#include "TypedRBTree.h"
+#include "IntrusiveRBTree.h"
+#include "CompactRBTree.h"
+#include "ConcurrentRBTree.h"
+#include "PersistentRBTree.h"
+#include "FrozenRBTree.h"
+#include "BloomFilter.h"
 #include <iostream>
 #include <algorithm>
 #include <random>
+#include <set>
+#include <map>
+#include <iterator>
 #include <cstdlib>
+#include <thread>
+#include <atomic>
 #include "tree_visualizer/util.hpp"
 
 int intCmp(const void* aa, const void* bb)
@@ -28,6 +40,88 @@ int foreachIntSum(const void* object, void *args)
     return 1;
 }
 
+// set while validating a tree that keeps subtree sizes (order statistics or an aggregate)
+static bool checkCounts = false;
+
+// returns the black height of the subtree, or -1 if one of the red-black/BST invariants is broken
+int checkSubtree(const Node* node, const Node* parent, CompareFunc cmp, int &count)
+{
+    if (node == nullptr) {
+        return 1;
+    }
+    ++count;
+    if (node->parent != parent) {
+        return -1;
+    }
+    if (node->color == RED && parent != nullptr && parent->color == RED) {
+        return -1;
+    }
+    if ((node->left != nullptr && cmp(node->left->data, node->data) >= 0) ||
+        (node->right != nullptr && cmp(node->right->data, node->data) <= 0)) {
+        return -1;
+    }
+    int before = count;
+    int left = checkSubtree(node->left, node, cmp, count);
+    int right = checkSubtree(node->right, node, cmp, count);
+    if (left == -1 || right == -1 || left != right) {
+        return -1;
+    }
+    if (checkCounts && node->count != count - before + 1) {
+        return -1;
+    }
+    return left + (node->color == BLACK ? 1 : 0);
+}
+
+bool isValidRBTree(const RBTree* tree)
+{
+    int count = 0;
+    if (tree->root != nullptr && tree->root->color != BLACK) {
+        return false;
+    }
+    checkCounts = tree->orderStatistics || tree->aggregate.size != 0;
+    return checkSubtree(tree->root, nullptr, tree->compFunc, count) != -1 && count == tree->size;
+}
+
+// how blackHeightOf reads the nodes of a tree that isn't made of Nodes: the handle of a missing child, the children,
+// whether a child is linked back to its parent (and holds whatever else the layout keeps per node), the color and the
+// key.
+template <typename N, typename Left, typename Right, typename Linked, typename IsRed, typename Key>
+struct NodeLayout {
+    using Handle = N;
+    N nil;
+    Left left;
+    Right right;
+    Linked linked;
+    IsRed isRed;
+    Key key;
+};
+
+template <typename N, typename Left, typename Right, typename Linked, typename IsRed, typename Key>
+static NodeLayout<N, Left, Right, Linked, IsRed, Key> nodeLayout(N nil, Left left, Right right, Linked linked,
+                                                                 IsRed isRed, Key key) {
+    return {nil, left, right, linked, isRed, key};
+}
+
+// returns the black height of a subtree of any layout, or -1 if one of the red-black/BST invariants is broken (the
+// checks of checkSubtree)
+template <typename Layout>
+static int blackHeightOf(typename Layout::Handle node, const Layout& layout) {
+    if (node == layout.nil) {
+        return 1;
+    }
+    typename Layout::Handle children[2] = {layout.left(node), layout.right(node)};
+    for (int side = 0; side < 2; ++side) {
+        typename Layout::Handle child = children[side];
+        if (child != layout.nil &&
+            (!layout.linked(child, node) || (layout.isRed(node) && layout.isRed(child)) ||
+             (side == 0 ? layout.key(child) >= layout.key(node) : layout.key(child) <= layout.key(node)))) {
+            return -1;
+        }
+    }
+    int left = blackHeightOf(children[0], layout), right = blackHeightOf(children[1], layout);
+    return left == -1 || left != right ? -1 : left + (layout.isRed(node) ? 0 : 1);
+}
+
 
 TEST_CASE("Sanity check - ensure you've set up everything correctly", "[sanity check]") {
     REQUIRE(2 + 2 == 4);
@@ -143,4 +237,1786 @@ SCENARIO("Creates RB trees of proper structure", "[structure]") {
 
         freeRBTree(tree);
     }
-}
\ No newline at end of file
+}
+
+SCENARIO("A pool allocated RB tree behaves like a regular one", "[pool]") {
+    GIVEN("A tree whose nodes come from a node pool") {
+        RBTreeOptions options = {};
+        options.usePool = 1;
+        RBTree *tree = newRBTreeWithOptions(intCmp, intFree, &options);
+        REQUIRE(tree != NULL);
+        REQUIRE(tree->pool != NULL);
+
+        std::vector<int> elements(5000);
+        for (int i = 0; i < (int)elements.size(); ++i) {
+            elements[i] = (i * 7919) % (int)elements.size();
+        }
+        for (auto &element : elements) {
+            REQUIRE(addToRBTree(tree, &element));
+        }
+
+        THEN("it keeps the red-black invariants and rejects duplicates") {
+            REQUIRE(isValidRBTree(tree));
+            REQUIRE(tree->size == (int)elements.size());
+            REQUIRE(!addToRBTree(tree, &elements[42]));
+            int missing = -1;
+            REQUIRE(!containsRBTree(tree, &missing));
+            REQUIRE(containsRBTree(tree, &elements[4999]));
+        }
+
+        freeRBTree(tree);
+    }
+}
+
+SCENARIO("Builds RB trees from sorted input", "[build]") {
+    GIVEN("Sorted arrays of every size up to 300 and a large one") {
+        std::vector<int> sizes;
+        for (int n = 0; n <= 300; ++n) {
+            sizes.push_back(n);
+        }
+        sizes.push_back(100000);
+
+        for (int n : sizes) {
+            std::vector<int> elements(n);
+            std::vector<void*> data(n);
+            for (int i = 0; i < n; ++i) {
+                elements[i] = 2 * i;
+                data[i] = &elements[i];
+            }
+
+            RBTree *serial = buildRBTreeFromSorted(data.data(), n, intCmp, intFree);
+            RBTree *parallel = buildRBTreeFromSortedParallel(data.data(), n, intCmp, intFree, 4);
+            REQUIRE(serial != NULL);
+            REQUIRE(parallel != NULL);
+            REQUIRE(isValidRBTree(serial));
+            REQUIRE(isValidRBTree(parallel));
+
+            int next = 0;
+            forEachRBTree(parallel, [](const void* object, void* args) {
+                int *next = (int*)args;
+                if (*(const int*)object != *next) {
+                    return 0;
+                }
+                *next += 2;
+                return 1;
+            }, &next);
+            REQUIRE(next == 2 * n);
+
+            // the trees stay valid when more items are inserted
+            int odd = 1, before = -1;
+            REQUIRE(addToRBTree(serial, &odd));
+            REQUIRE(addToRBTree(serial, &before));
+            REQUIRE(isValidRBTree(serial));
+            REQUIRE(serial->size == n + 2);
+            if (n > 0) {
+                REQUIRE(!addToRBTree(parallel, &elements[n / 2]));
+                REQUIRE(containsRBTree(parallel, &elements[n - 1]));
+            }
+
+            freeRBTree(serial);
+            freeRBTree(parallel);
+        }
+    }
+}
+
+SCENARIO("Adds batches of items to RB trees", "[batch]") {
+    for (int orderStatistics = 0; orderStatistics <= 1; ++orderStatistics) {
+        GIVEN("A tree of the even numbers 0..1998, order statistics: " + std::to_string(orderStatistics)) {
+            RBTreeOptions options = {};
+            options.usePool = orderStatistics;
+            options.orderStatistics = orderStatistics;
+            RBTree *tree = newRBTreeWithOptions(intCmp, intFree, &options);
+            std::vector<int> elements(1000);
+            for (int i = 0; i < 1000; ++i) {
+                elements[i] = (i * 7919) % 1000 * 2;
+                REQUIRE(addToRBTree(tree, &elements[i]));
+            }
+
+            WHEN("A large batch of odd numbers, tree items, repeats and NULL is added") {
+                // 1999..1 descending, then 0..98 (already in the tree), then 1..99 again, then NULL.
+                std::vector<int> batch;
+                for (int i = 1999; i > 0; i -= 2) {
+                    batch.push_back(i);
+                }
+                for (int i = 0; i < 100; ++i) {
+                    batch.push_back(i);
+                }
+                std::vector<void*> items;
+                for (int& item : batch) {
+                    items.push_back(&item);
+                }
+                items.push_back(nullptr);
+                std::vector<int> results(items.size(), -1);
+
+                int added = addBatchToRBTree(tree, items.data(), (int)items.size(), results.data());
+
+                THEN("exactly the first copy of each new item is added") {
+                    REQUIRE(added == 1000);
+                    REQUIRE(tree->size == 2000);
+                    REQUIRE(isValidRBTree(tree));
+                    for (size_t i = 0; i < items.size(); ++i) {
+                        REQUIRE(bool(results[i]) == (i < 1000));
+                    }
+                    for (int i = -1; i <= 2000; ++i) {
+                        REQUIRE(bool(containsRBTree(tree, &i)) == (i >= 0 && i < 2000));
+                    }
+                    if (orderStatistics) {
+                        for (int i = 0; i < 2000; i += 37) {
+                            REQUIRE(*(int*)selectRBTree(tree, i) == i);
+                        }
+                    }
+                }
+
+                THEN("the tree keeps working after the rebuild") {
+                    int extra = 5000;
+                    REQUIRE(addToRBTree(tree, &extra));
+                    REQUIRE(removeFromRBTree(tree, &batch[0]));
+                    REQUIRE(isValidRBTree(tree));
+                    REQUIRE(tree->size == 2000);
+                }
+            }
+
+            WHEN("A small batch is added") {
+                int small[] = {7, 8, 3, 7};
+                void *items[] = {&small[0], &small[1], &small[2], &small[3]};
+                int results[4];
+                REQUIRE(addBatchToRBTree(tree, items, 4, results) == 2);
+
+                THEN("it is added like single items") {
+                    REQUIRE(results[0]);
+                    REQUIRE(!results[1]);
+                    REQUIRE(results[2]);
+                    REQUIRE(!results[3]);
+                    REQUIRE(tree->size == 1002);
+                    REQUIRE(isValidRBTree(tree));
+                }
+            }
+
+            freeRBTree(tree);
+        }
+    }
+
+    GIVEN("An empty tree") {
+        RBTree *tree = newRBTree(intCmp, intFree);
+        std::vector<int> batch(5000);
+        std::vector<void*> items(5000);
+        for (int i = 0; i < 5000; ++i) {
+            batch[i] = (i * 7919) % 5000;
+            items[i] = &batch[i];
+        }
+        REQUIRE(addBatchToRBTree(tree, items.data(), 5000, nullptr) == 5000);
+        REQUIRE(isValidRBTree(tree));
+        REQUIRE(addBatchToRBTree(tree, items.data(), 0, nullptr) == 0);
+        REQUIRE(addBatchToRBTree(tree, items.data(), 5000, nullptr) == 0);
+        REQUIRE(tree->size == 5000);
+        freeRBTree(tree);
+
+        // an ascending batch skips the sort
+        std::sort(batch.begin(), batch.end());
+        tree = newRBTree(intCmp, intFree);
+        REQUIRE(addBatchToRBTree(tree, items.data(), 5000, nullptr) == 5000);
+        REQUIRE(isValidRBTree(tree));
+        REQUIRE(*(int*)rbFirst(tree)->data == 0);
+        freeRBTree(tree);
+    }
+}
+
+struct KeyValue {
+    int key;
+    int value;
+};
+
+static int keyValueCmp(const void* a, const void* b) {
+    int x = ((const KeyValue*)a)->key, y = ((const KeyValue*)b)->key;
+    return (x > y) - (x < y);
+}
+
+static int keyValueFrees = 0;
+
+static void keyValueFree(void* data) {
+    keyValueFrees++;
+    delete (KeyValue*)data;
+}
+
+SCENARIO("Finds, inserts or gets and replaces items in one descent", "[find]") {
+    GIVEN("A tree of key-value items with keys 0..99") {
+        keyValueFrees = 0;
+        RBTree *tree = newRBTree(keyValueCmp, keyValueFree);
+        for (int i = 0; i < 100; ++i) {
+            REQUIRE(addToRBTree(tree, new KeyValue{(i * 37) % 100, i}));
+        }
+
+        THEN("findRBTree returns the stored item") {
+            KeyValue probe = {42, -1};
+            KeyValue *found = (KeyValue*)findRBTree(tree, &probe);
+            REQUIRE(found != NULL);
+            REQUIRE(found != &probe);
+            REQUIRE(found->key == 42);
+            probe.key = 100;
+            REQUIRE(findRBTree(tree, &probe) == NULL);
+            REQUIRE(findRBTree(tree, NULL) == NULL);
+        }
+
+        THEN("insertOrGetRBTree returns the existing item or adds the new one") {
+            KeyValue existing = {7, -1};
+            KeyValue *got = (KeyValue*)insertOrGetRBTree(tree, &existing);
+            REQUIRE(got != &existing);
+            REQUIRE(got->key == 7);
+            REQUIRE(tree->size == 100);
+
+            KeyValue *fresh = new KeyValue{500, 1};
+            REQUIRE(insertOrGetRBTree(tree, fresh) == fresh);
+            REQUIRE(tree->size == 101);
+            REQUIRE(isValidRBTree(tree));
+        }
+
+        THEN("replaceRBTree swaps an equal item and frees the old one, or adds a new one") {
+            KeyValue *replacement = new KeyValue{13, 1313};
+            REQUIRE(replaceRBTree(tree, replacement));
+            REQUIRE(keyValueFrees == 1);
+            REQUIRE(tree->size == 100);
+            REQUIRE(findRBTree(tree, replacement) == replacement);
+            REQUIRE(replaceRBTree(tree, replacement));
+            REQUIRE(keyValueFrees == 1);
+
+            REQUIRE(replaceRBTree(tree, new KeyValue{-3, 0}));
+            REQUIRE(tree->size == 101);
+            REQUIRE(isValidRBTree(tree));
+        }
+
+        freeRBTree(tree);
+    }
+
+    GIVEN("Trees of the other engines") {
+        for (RBTreeEngine engine : {BPLUS_ENGINE, COMPACT_ENGINE}) {
+            RBTreeOptions options = {};
+            options.engine = engine;
+            RBTree *tree = newRBTreeWithOptions(intCmp, intFree, &options);
+            std::vector<int> elements(1000);
+            for (int i = 0; i < 1000; ++i) {
+                elements[i] = i;
+                REQUIRE(addToRBTree(tree, &elements[i]));
+            }
+            for (int i = -1; i <= 1000; ++i) {
+                REQUIRE(findRBTree(tree, &i) == (i >= 0 && i < 1000 ? &elements[i] : NULL));
+            }
+            REQUIRE(insertOrGetRBTree(tree, &elements[3]) == NULL);
+            REQUIRE(!replaceRBTree(tree, &elements[3]));
+            freeRBTree(tree);
+        }
+    }
+}
+
+static int intKeyCmp(const void* key, const void* data) {
+    int x = *(const int*)key, y = ((const KeyValue*)data)->key;
+    return (x > y) - (x < y);
+}
+
+SCENARIO("Looks items up by a key instead of a whole item", "[key]") {
+    GIVEN("A tree of key-value items with even keys 0..198 and an int KeyCompareFunc") {
+        RBTreeOptions options = {};
+        options.keyCompFunc = intKeyCmp;
+        RBTree *tree = newRBTreeWithOptions(keyValueCmp, keyValueFree, &options);
+        for (int i = 0; i < 100; ++i) {
+            REQUIRE(addToRBTree(tree, new KeyValue{(i * 37) % 100 * 2, i}));
+        }
+
+        THEN("a raw int finds exactly the items with that key") {
+            for (int key = -1; key <= 200; ++key) {
+                KeyValue *found = (KeyValue*)findKeyRBTree(tree, &key);
+                REQUIRE(bool(containsKeyRBTree(tree, &key)) == (key >= 0 && key < 200 && key % 2 == 0));
+                REQUIRE((found != NULL) == bool(containsKeyRBTree(tree, &key)));
+                if (found != NULL) {
+                    REQUIRE(found->key == key);
+                    REQUIRE(found == findRBTree(tree, found));
+                }
+            }
+        }
+
+        freeRBTree(tree);
+    }
+
+    GIVEN("A tree without a KeyCompareFunc") {
+        RBTree *tree = newRBTree(intCmp, intFree);
+        int item = 1;
+        REQUIRE(addToRBTree(tree, &item));
+        REQUIRE(!containsKeyRBTree(tree, &item));
+        REQUIRE(findKeyRBTree(tree, &item) == NULL);
+        freeRBTree(tree);
+    }
+}
+
+SCENARIO("Counts the work done inside RB trees", "[stats]") {
+    GIVEN("A tree of 1024 items inserted in an ascending order") {
+        std::vector<int> elements(1024);
+        RBTree *tree = newRBTree(intCmp, intFree);
+        for (int i = 0; i < 1024; ++i) {
+            elements[i] = i;
+            REQUIRE(addToRBTree(tree, &elements[i]));
+        }
+        RBTreeStats stats = getRBTreeStats(tree);
+
+        THEN("every insert is counted") {
+            REQUIRE(stats.enabled);
+            REQUIRE(stats.descents == 1024);
+            REQUIRE(stats.allocations == 1024);
+            REQUIRE(stats.rotations > 0);
+            REQUIRE(stats.doubleRotations == 0);
+            REQUIRE(stats.recolorings > 0);
+            long descents = 0, comparisons = 0;
+            for (int depth = 0; depth < RBTREE_STATS_DEPTHS; ++depth) {
+                descents += stats.depthHistogram[depth];
+                comparisons += depth * stats.depthHistogram[depth];
+            }
+            REQUIRE(descents == stats.descents);
+            REQUIRE(comparisons == stats.comparisons);
+            REQUIRE(stats.depthHistogram[0] == 1);
+        }
+
+        THEN("the black height is the one of every path") {
+            int count = 0;
+            REQUIRE(stats.blackHeight + 1 == checkSubtree(tree->root, nullptr, intCmp, count));
+        }
+
+        THEN("duplicates, removes and reused nodes are told apart") {
+            resetRBTreeStats(tree);
+            REQUIRE(getRBTreeStats(tree).descents == 0);
+            REQUIRE(!addToRBTree(tree, &elements[0]));
+            REQUIRE(removeFromRBTree(tree, &elements[5]));
+            REQUIRE(addToRBTree(tree, &elements[5]));
+            stats = getRBTreeStats(tree);
+            REQUIRE(stats.descents == 2);
+            REQUIRE(stats.allocations == 0);
+        }
+
+        freeRBTree(tree);
+    }
+
+    GIVEN("Items that need double rotations") {
+        int items[] = {10, 5, 7};
+        RBTree *tree = newRBTree(intCmp, intFree);
+        for (int &item : items) {
+            REQUIRE(addToRBTree(tree, &item));
+        }
+        RBTreeStats stats = getRBTreeStats(tree);
+        REQUIRE(stats.doubleRotations == 1);
+        REQUIRE(stats.rotations == 1);
+        REQUIRE(stats.blackHeight == 1);
+        REQUIRE(getRBTreeStats(nullptr).blackHeight == 0);
+        freeRBTree(tree);
+    }
+}
+
+SCENARIO("Walks and reduces RB trees on several threads", "[parallel]") {
+    GIVEN("A tree of the numbers 1..5000 inserted in a scrambled order") {
+        std::vector<int> elements(5000);
+        RBTree *tree = newRBTree(intCmp, intFree);
+        for (int i = 0; i < 5000; ++i) {
+            elements[i] = (i * 2003) % 5000 + 1;
+            REQUIRE(addToRBTree(tree, &elements[i]));
+        }
+
+        THEN("every item is visited exactly once on 1 to 4 threads") {
+            for (int threads = 1; threads <= 4; ++threads) {
+                std::atomic<long> sum(0);
+                std::atomic<int> visits(0);
+                std::pair<std::atomic<long>*, std::atomic<int>*> args(&sum, &visits);
+                REQUIRE(parallelForEachRBTree(tree, [](const void* object, void* args) {
+                    auto *counters = (std::pair<std::atomic<long>*, std::atomic<int>*>*)args;
+                    *counters->first += *(const int*)object;
+                    ++*counters->second;
+                    return 1;
+                }, &args, threads));
+                REQUIRE(sum == 5000L * 5001 / 2);
+                REQUIRE(visits == 5000);
+            }
+        }
+
+        THEN("reductions into per-thread accumulators are combined") {
+            for (int threads = 1; threads <= 4; ++threads) {
+                int sums[4] = {0, 0, 0, 0};
+                void *accumulators[4] = {&sums[0], &sums[1], &sums[2], &sums[3]};
+                REQUIRE(parallelReduceRBTree(tree, foreachIntSum, accumulators, [](void* into, const void* from) {
+                    *(int*)into += *(const int*)from;
+                    return 1;
+                }, threads));
+                REQUIRE(sums[0] == 5000 * 5001 / 2);
+
+                int maxima[4] = {0, 0, 0, 0};
+                void *maxAccumulators[4] = {&maxima[0], &maxima[1], &maxima[2], &maxima[3]};
+                REQUIRE(parallelReduceRBTree(tree, [](const void* object, void* args) {
+                    *(int*)args = std::max(*(int*)args, *(const int*)object);
+                    return 1;
+                }, maxAccumulators, [](void* into, const void* from) {
+                    *(int*)into = std::max(*(int*)into, *(const int*)from);
+                    return 1;
+                }, threads));
+                REQUIRE(maxima[0] == 5000);
+            }
+        }
+
+        THEN("the walk stops once the function fails") {
+            std::atomic<int> visits(0);
+            REQUIRE(!parallelForEachRBTree(tree, [](const void* object, void* args) {
+                ++*(std::atomic<int>*)args;
+                return *(const int*)object == 2500 ? 0 : 1;
+            }, &visits, 4));
+            REQUIRE(visits <= 5000);
+
+            int sums[2] = {0, 0};
+            void *accumulators[2] = {&sums[0], &sums[1]};
+            REQUIRE(!parallelReduceRBTree(tree, foreachIntSum, accumulators, [](void*, const void*) {
+                return 0;
+            }, 2));
+        }
+
+        freeRBTree(tree);
+    }
+
+    GIVEN("An empty tree") {
+        RBTree *tree = newRBTree(intCmp, intFree);
+        int sum = 0;
+        void *accumulators[1] = {&sum};
+        REQUIRE(!parallelForEachRBTree(tree, foreachIntSum, &sum, 4));
+        REQUIRE(!parallelReduceRBTree(tree, foreachIntSum, accumulators, nullptr, 4));
+        REQUIRE(sum == 0);
+        freeRBTree(tree);
+    }
+}
+
+static long countedComparisons = 0;
+
+static int countingIntCmp(const void* a, const void* b) {
+    ++countedComparisons;
+    return intCmp(a, b);
+}
+
+SCENARIO("Sorted inserts skip the descent", "[hint]") {
+    GIVEN("Ascending and descending streams") {
+        std::vector<int> elements(2000);
+        for (int i = 0; i < 2000; ++i) {
+            elements[i] = i;
+        }
+        RBTreeOptions options = {};
+        options.orderStatistics = 1;
+        RBTree *tree = newRBTreeWithOptions(countingIntCmp, intFree, &options);
+        countedComparisons = 0;
+        for (int i = 1000; i < 2000; ++i) {
+            REQUIRE(addToRBTree(tree, &elements[i]));
+        }
+        for (int i = 999; i >= 0; --i) {
+            REQUIRE(addToRBTree(tree, &elements[i]));
+        }
+
+        THEN("each insert compares at most twice and the ends are cached") {
+            REQUIRE(countedComparisons <= 2 * 2000);
+            REQUIRE(isValidRBTree(tree));
+            REQUIRE(rbFirst(tree)->data == &elements[0]);
+            REQUIRE(rbLast(tree)->data == &elements[1999]);
+            REQUIRE(!addToRBTree(tree, &elements[1999]));
+            REQUIRE(!addToRBTree(tree, &elements[0]));
+        }
+
+        THEN("removing the ends moves them") {
+            REQUIRE(removeFromRBTree(tree, &elements[0]));
+            REQUIRE(removeFromRBTree(tree, &elements[1999]));
+            REQUIRE(removeRangeFromRBTree(tree, &elements[1990], &elements[1999]) == 9);
+            REQUIRE(rbFirst(tree)->data == &elements[1]);
+            REQUIRE(rbLast(tree)->data == &elements[1989]);
+            REQUIRE(isValidRBTree(tree));
+        }
+
+        freeRBTree(tree);
+    }
+
+    GIVEN("A tree of the even numbers and hints next to the odd ones") {
+        std::vector<int> elements(2000);
+        RBTree *tree = newRBTree(countingIntCmp, intFree);
+        for (int i = 0; i < 2000; ++i) {
+            elements[i] = i;
+        }
+        std::vector<Node*> nodes(2000, nullptr);
+        for (int i = 0; i < 2000; i += 2) {
+            nodes[i] = addToRBTreeHint(tree, &elements[i], i > 0 ? nodes[i - 2] : nullptr);
+            REQUIRE(nodes[i] != nullptr);
+            REQUIRE(nodes[i]->data == &elements[i]);
+        }
+
+        THEN("items between the hint and its neighbour are linked next to it") {
+            countedComparisons = 0;
+            for (int i = 1; i < 2000; i += 2) {
+                // alternate hints from below and from above
+                Node *hint = i % 4 == 1 || i == 1999 ? nodes[i - 1] : nodes[i + 1];
+                REQUIRE(addToRBTreeHint(tree, &elements[i], hint) != nullptr);
+            }
+            REQUIRE(countedComparisons <= 2 * 1000);
+            REQUIRE(isValidRBTree(tree));
+            REQUIRE(rbLast(tree)->data == &elements[1999]);
+            int next = 0;
+            REQUIRE(forEachRBTree(tree, [](const void* object, void* args) {
+                return *(const int*)object == (*(int*)args)++ ? 1 : 0;
+            }, &next));
+            REQUIRE(next == 2000);
+        }
+
+        THEN("wrong hints fall back to a descent and duplicates are rejected") {
+            int one = 1, big = 5000, minus = -1;
+            REQUIRE(addToRBTreeHint(tree, &one, nodes[1000]) != nullptr);
+            REQUIRE(addToRBTreeHint(tree, &big, nodes[0]) != nullptr);
+            REQUIRE(addToRBTreeHint(tree, &minus, nullptr) != nullptr);
+            REQUIRE(addToRBTreeHint(tree, &elements[500], nodes[500]) == nullptr);
+            REQUIRE(addToRBTreeHint(tree, &elements[502], nodes[500]) == nullptr);
+            REQUIRE(rbFirst(tree)->data == &minus);
+            REQUIRE(rbLast(tree)->data == &big);
+            REQUIRE(isValidRBTree(tree));
+            REQUIRE(tree->size == 1003);
+        }
+
+        freeRBTree(tree);
+    }
+
+    GIVEN("Trees that were built or merged in bulk") {
+        std::vector<int> elements(300);
+        std::vector<void*> data(300);
+        for (int i = 0; i < 300; ++i) {
+            elements[i] = i;
+            data[i] = &elements[i];
+        }
+        RBTree *tree = buildRBTreeFromSorted(data.data(), 100, intCmp, intFree);
+        REQUIRE(rbFirst(tree)->data == &elements[0]);
+        REQUIRE(rbLast(tree)->data == &elements[99]);
+        REQUIRE(addBatchToRBTree(tree, data.data() + 100, 200, nullptr) == 200);
+        REQUIRE(rbLast(tree)->data == &elements[299]);
+        REQUIRE(isValidRBTree(tree));
+        freeRBTree(tree);
+    }
+}
+
+static uint64_t intHash(const void* data) {
+    return (uint64_t) *(const int*) data;
+}
+
+SCENARIO("Bloom filters answer misses without a descent", "[bloom]") {
+    RBTreeEngine engine = GENERATE(RED_BLACK_ENGINE, BPLUS_ENGINE, COMPACT_ENGINE);
+    GIVEN("A tree of even numbers that outgrows the size its filter was made for") {
+        std::vector<int> elements(4000);
+        for (int i = 0; i < 4000; ++i) {
+            elements[i] = i;
+        }
+        RBTreeOptions options = {};
+        options.engine = engine;
+        options.hashFunc = intHash;
+        options.expectedSize = 100;
+        RBTree *tree = newRBTreeWithOptions(countingIntCmp, intFree, &options);
+        REQUIRE(tree != nullptr);
+        for (int i = 0; i < 1000; i += 2) {
+            REQUIRE(addToRBTree(tree, &elements[i]));
+        }
+        std::vector<void*> batch;
+        for (int i = 1000; i < 4000; i += 2) {
+            batch.push_back(&elements[i]);
+        }
+        REQUIRE(addBatchToRBTree(tree, batch.data(), (int) batch.size(), nullptr) == 1500);
+
+        THEN("every item is found and most misses never compare") {
+            for (int i = 0; i < 4000; i += 2) {
+                REQUIRE(containsRBTree(tree, &elements[i]));
+            }
+            countedComparisons = 0;
+            for (int i = 1; i < 4000; i += 2) {
+                REQUIRE(!containsRBTree(tree, &elements[i]));
+            }
+            RBTreeBloomStats stats = getRBTreeBloomStats(tree);
+            REQUIRE(stats.queries == 4000);
+            REQUIRE(stats.filtered + stats.falsePositives == 2000);
+            REQUIRE(stats.falsePositiveRate < 0.05);
+            REQUIRE(stats.bits >= 2000L * 12);
+            REQUIRE(countedComparisons <= stats.falsePositives * 40);
+            resetRBTreeStats(tree);
+            REQUIRE(getRBTreeBloomStats(tree).queries == 0);
+        }
+
+        THEN("the filter counts every item once") {
+            REQUIRE(tree->bloom->items == tree->size);
+        }
+
+        THEN("removed items are misses") {
+            if (engine == RED_BLACK_ENGINE) {
+                REQUIRE(removeFromRBTree(tree, &elements[10]));
+                REQUIRE(!containsRBTree(tree, &elements[10]));
+                REQUIRE(containsRBTree(tree, &elements[12]));
+                REQUIRE(addToRBTree(tree, &elements[10]));
+                REQUIRE(containsRBTree(tree, &elements[10]));
+            }
+        }
+
+        freeRBTree(tree);
+    }
+
+    GIVEN("A tree without a filter") {
+        RBTree *tree = newRBTree(countingIntCmp, intFree);
+        int one = 1;
+        REQUIRE(addToRBTree(tree, &one));
+        REQUIRE(containsRBTree(tree, &one));
+        REQUIRE(getRBTreeBloomStats(tree).queries == 0);
+        freeRBTree(tree);
+    }
+}
+
+static std::vector<int> treeItems(RBTree* tree) {
+    std::vector<int> items;
+    for (Node *node = rbFirst(tree); node != nullptr; node = rbNext(node)) {
+        items.push_back(*(int*) node->data);
+    }
+    return items;
+}
+
+static bool hasEnds(const RBTree* tree) {
+    if (tree->root == nullptr) {
+        return tree->first == nullptr && tree->last == nullptr;
+    }
+    const Node *first = tree->root, *last = tree->root;
+    while (first->left != nullptr) {
+        first = first->left;
+    }
+    while (last->right != nullptr) {
+        last = last->right;
+    }
+    return tree->first == first && tree->last == last;
+}
+
+SCENARIO("Splits and joins RB trees", "[split]") {
+    int orderStatistics = GENERATE(0, 1);
+    GIVEN("A tree of shuffled even numbers") {
+        std::vector<int> elements(2002);
+        for (int i = 0; i < 2002; ++i) {
+            elements[i] = i;
+        }
+        std::vector<int> order;
+        for (int i = 0; i < 2000; i += 2) {
+            order.push_back(i);
+        }
+        std::shuffle(order.begin(), order.end(), std::mt19937(7));
+        RBTreeOptions options = {};
+        options.orderStatistics = orderStatistics;
+        RBTree *tree = newRBTreeWithOptions(intCmp, intFree, &options);
+        for (int i : order) {
+            REQUIRE(addToRBTree(tree, &elements[i]));
+        }
+        int key = GENERATE(0, 1, 2, 501, 1000, 1998, 1999, 2001);
+
+        if (!orderStatistics) {
+            THEN("it isn't split, since the sizes of the halves aren't known in O(log n)") {
+                RBTree *left = nullptr, *right = nullptr;
+                REQUIRE(!splitRBTree(tree, &elements[key], &left, &right));
+                REQUIRE(left == nullptr);
+                REQUIRE(isValidRBTree(tree));
+                REQUIRE(tree->size == 1000);
+            }
+            freeRBTree(tree);
+        } else {
+            WHEN("it is split at a key") {
+                RBTree *left = nullptr, *right = nullptr;
+                REQUIRE(splitRBTree(tree, &elements[key], &left, &right));
+
+                THEN("the items lower than the key are in one valid tree, the others in another") {
+                    REQUIRE(isValidRBTree(left));
+                    REQUIRE(isValidRBTree(right));
+                    REQUIRE(hasEnds(left));
+                    REQUIRE(hasEnds(right));
+                    REQUIRE(left->size == std::min((key + 1) / 2, 1000));
+                    REQUIRE(left->size + right->size == 1000);
+                    std::vector<int> items = treeItems(left);
+                    std::vector<int> rightItems = treeItems(right);
+                    items.insert(items.end(), rightItems.begin(), rightItems.end());
+                    REQUIRE(items.size() == 1000);
+                    for (int i = 0; i < 1000; ++i) {
+                        REQUIRE(items[i] == 2 * i);
+                    }
+                }
+
+                THEN("joining them again restores the tree") {
+                    RBTree *joined = joinRBTree(left, nullptr, right);
+                    REQUIRE(joined == left);
+                    REQUIRE(isValidRBTree(joined));
+                    REQUIRE(hasEnds(joined));
+                    REQUIRE(joined->size == 1000);
+                    REQUIRE(addToRBTree(joined, &elements[1001]));
+                    REQUIRE(isValidRBTree(joined));
+                    tree = joined;
+                    right = nullptr;
+                    left = nullptr;
+                }
+
+                THEN("an odd key joins them as a pivot") {
+                    if (key % 2 == 1) {
+                        RBTree *joined = joinRBTree(left, &elements[key], right);
+                        REQUIRE(joined != nullptr);
+                        REQUIRE(isValidRBTree(joined));
+                        REQUIRE(hasEnds(joined));
+                        REQUIRE(joined->size == 1001);
+                        REQUIRE(containsRBTree(joined, &elements[key]));
+                        if (orderStatistics) {
+                            REQUIRE(rankRBTree(joined, &elements[key]) == std::min((key + 1) / 2, 1000));
+                        }
+                        tree = joined;
+                        right = nullptr;
+                        left = nullptr;
+                    }
+                }
+
+                THEN("trees out of order aren't joined") {
+                    if (left->size > 0 && right->size > 0) {
+                        REQUIRE(joinRBTree(right, nullptr, left) == nullptr);
+                        REQUIRE(joinRBTree(left, &elements[2001], right) == nullptr);
+                    }
+                }
+
+                if (left != nullptr) {
+                    freeRBTree(left);
+                    freeRBTree(right);
+                } else {
+                    freeRBTree(tree);
+                }
+            }
+        }
+    }
+
+    GIVEN("Trees of very different heights and removed nodes") {
+        std::vector<int> elements(5000);
+        for (int i = 0; i < 5000; ++i) {
+            elements[i] = i;
+        }
+        RBTreeOptions options = {};
+        options.orderStatistics = orderStatistics;
+        RBTree *small = newRBTreeWithOptions(intCmp, intFree, &options);
+        RBTree *large = newRBTreeWithOptions(intCmp, intFree, &options);
+        for (int i = 0; i < 3; ++i) {
+            REQUIRE(addToRBTree(small, &elements[i]));
+        }
+        for (int i = 10; i < 5000; ++i) {
+            REQUIRE(addToRBTree(large, &elements[i]));
+        }
+        REQUIRE(removeFromRBTree(large, &elements[4999]));
+        RBTree *joined = joinRBTree(small, &elements[5], large);
+        REQUIRE(joined == small);
+        REQUIRE(isValidRBTree(joined));
+        REQUIRE(hasEnds(joined));
+        REQUIRE(joined->size == 3 + 1 + 4989);
+        REQUIRE(addToRBTree(joined, &elements[4999]));
+
+        RBTree *empty = newRBTreeWithOptions(intCmp, intFree, &options);
+        joined = joinRBTree(joined, nullptr, empty);
+        REQUIRE(isValidRBTree(joined));
+        REQUIRE(joined->size == 4994);
+        RBTree *other = newRBTreeWithOptions(intCmp, intFree, nullptr);
+        REQUIRE((orderStatistics ? joinRBTree(joined, nullptr, other) == nullptr : true));
+        freeRBTree(other);
+        freeRBTree(joined);
+    }
+}
+
+SCENARIO("Unions, intersections and differences of RB trees", "[set]") {
+    int threads = GENERATE(1, 4);
+    int smallSize = GENERATE(0, 5, 300, 3000);
+    GIVEN("Trees of random numbers that share some of them") {
+        std::mt19937 random(smallSize + threads);
+        std::vector<int> elements(20000);
+        for (int i = 0; i < 20000; ++i) {
+            elements[i] = i;
+        }
+        std::set<int> largeSet, smallSet;
+        while ((int) largeSet.size() < 5000) {
+            largeSet.insert((int) (random() % 20000));
+        }
+        while ((int) smallSet.size() < smallSize) {
+            smallSet.insert((int) (random() % 20000));
+        }
+        RBTree *large = newRBTree(intCmp, intFree);
+        RBTree *small = newRBTree(intCmp, intFree);
+        for (int i : largeSet) {
+            REQUIRE(addToRBTree(large, &elements[i]));
+        }
+        for (int i : smallSet) {
+            REQUIRE(addToRBTree(small, &elements[i]));
+        }
+
+        THEN("the results hold the items of std::set_union/intersection/difference") {
+            std::vector<int> expected;
+            std::set_union(largeSet.begin(), largeSet.end(), smallSet.begin(), smallSet.end(),
+                           std::back_inserter(expected));
+            RBTree *result = unionRBTree(small, large, intFree, threads);
+            REQUIRE(isValidRBTree(result));
+            REQUIRE(treeItems(result) == expected);
+            freeRBTree(result);
+
+            expected.clear();
+            std::set_intersection(largeSet.begin(), largeSet.end(), smallSet.begin(), smallSet.end(),
+                                  std::back_inserter(expected));
+            result = intersectRBTree(large, small, intFree, threads);
+            REQUIRE(isValidRBTree(result));
+            REQUIRE(treeItems(result) == expected);
+            freeRBTree(result);
+
+            expected.clear();
+            std::set_difference(largeSet.begin(), largeSet.end(), smallSet.begin(), smallSet.end(),
+                                std::back_inserter(expected));
+            result = differenceRBTree(large, small, intFree, threads);
+            REQUIRE(isValidRBTree(result));
+            REQUIRE(treeItems(result) == expected);
+            freeRBTree(result);
+
+            expected.clear();
+            std::set_difference(smallSet.begin(), smallSet.end(), largeSet.begin(), largeSet.end(),
+                                std::back_inserter(expected));
+            result = differenceRBTree(small, large, intFree, threads);
+            REQUIRE(isValidRBTree(result));
+            REQUIRE(treeItems(result) == expected);
+            freeRBTree(result);
+
+            REQUIRE(treeItems(large) == std::vector<int>(largeSet.begin(), largeSet.end()));
+            REQUIRE(isValidRBTree(small));
+        }
+
+        THEN("a sparse intersection skips most of the larger tree") {
+            if (smallSize == 5) {
+                RBTree *counted = newRBTree(countingIntCmp, intFree);
+                for (int i : largeSet) {
+                    REQUIRE(addToRBTree(counted, &elements[i]));
+                }
+                RBTree *sparse = newRBTree(countingIntCmp, intFree);
+                for (int i : smallSet) {
+                    REQUIRE(addToRBTree(sparse, &elements[i]));
+                }
+                countedComparisons = 0;
+                RBTree *result = intersectRBTree(counted, sparse, intFree, 1);
+                REQUIRE(result != nullptr);
+                REQUIRE(countedComparisons < 500);
+                freeRBTree(result);
+                freeRBTree(sparse);
+                freeRBTree(counted);
+            }
+        }
+
+        THEN("a union keeps the item of its first tree when both have equal ones") {
+            std::vector<int> copies(elements);
+            RBTree *copied = newRBTree(intCmp, intFree);
+            for (int i : largeSet) {
+                REQUIRE(addToRBTree(copied, &copies[i]));
+            }
+            RBTree *result = unionRBTree(small, copied, intFree, threads);
+            REQUIRE(isValidRBTree(result));
+            for (Node *node = rbFirst(result); node != nullptr; node = rbNext(node)) {
+                int i = *(int *) node->data;
+                REQUIRE(node->data == (smallSet.count(i) > 0 ? &elements[i] : &copies[i]));
+            }
+            freeRBTree(result);
+            result = unionRBTree(copied, small, intFree, threads);
+            REQUIRE(isValidRBTree(result));
+            for (Node *node = rbFirst(result); node != nullptr; node = rbNext(node)) {
+                int i = *(int *) node->data;
+                REQUIRE(node->data == (largeSet.count(i) > 0 ? &copies[i] : &elements[i]));
+            }
+            freeRBTree(result);
+            freeRBTree(copied);
+        }
+
+        THEN("trees of other engines are rejected") {
+            RBTreeOptions options = {};
+            options.engine = BPLUS_ENGINE;
+            RBTree *bplus = newRBTreeWithOptions(intCmp, intFree, &options);
+            REQUIRE(unionRBTree(large, bplus, intFree, threads) == nullptr);
+            freeRBTree(bplus);
+        }
+
+        freeRBTree(large);
+        freeRBTree(small);
+    }
+}
+
+// an item sorted by its key, whose aggregate value depends on its weight too, so replacing it changes the aggregate.
+struct Weighted {
+    int key;
+    int weight;
+};
+
+static int weightedCmp(const void* a, const void* b) {
+    return ((const Weighted*) a)->key - ((const Weighted*) b)->key;
+}
+
+// a polynomial hash of the weights in an ascending order: combining it isn't commutative, so it checks the order too.
+struct WeightSequence {
+    uint64_t hash;
+    uint64_t power;
+};
+
+static void weightValue(const void* data, void* value) {
+    auto sequence = (WeightSequence*) value;
+    sequence->hash = (uint64_t) ((const Weighted*) data)->weight;
+    sequence->power = 1000003;
+}
+
+static void combineWeights(void* into, const void* from) {
+    auto sequence = (WeightSequence*) into;
+    auto other = (const WeightSequence*) from;
+    sequence->hash = sequence->hash * other->power + other->hash;
+    sequence->power *= other->power;
+}
+
+static const RBTreeAggregate weightAggregate = {sizeof(WeightSequence), weightValue, combineWeights};
+
+static bool sameSequence(const WeightSequence& a, const WeightSequence& b) {
+    return a.hash == b.hash && a.power == b.power;
+}
+
+// the aggregate of the items of a map in [lo, hi), the slow way
+static bool foldWeights(const std::map<int, int>& items, int lo, int hi, WeightSequence& result) {
+    bool empty = true;
+    for (auto it = items.lower_bound(lo); it != items.end() && it->first < hi; ++it) {
+        Weighted item = {it->first, it->second};
+        WeightSequence value;
+        weightValue(&item, &value);
+        if (empty) {
+            result = value;
+        } else {
+            combineWeights(&result, &value);
+        }
+        empty = false;
+    }
+    return !empty;
+}
+
+// checks the aggregate of every node against its subtree, and returns the fold of the subtree
+static bool hasValidAggregates(const RBTree* tree, const Node* node, WeightSequence& result) {
+    WeightSequence left, right;
+    weightValue(node->data, &result);
+    if (node->left != nullptr) {
+        if (!hasValidAggregates(tree, node->left, left)) {
+            return false;
+        }
+        combineWeights(&left, &result);
+        result = left;
+    }
+    if (node->right != nullptr) {
+        if (!hasValidAggregates(tree, node->right, right)) {
+            return false;
+        }
+        combineWeights(&result, &right);
+    }
+    return sameSequence(result, *(const WeightSequence*) ((const char*) node + tree->aggregateOffset));
+}
+
+static bool hasValidAggregates(const RBTree* tree) {
+    WeightSequence all;
+    return tree->root == nullptr || hasValidAggregates(tree, tree->root, all);
+}
+
+SCENARIO("Keeps the aggregates of subtrees", "[aggregate]") {
+    int usePool = GENERATE(0, 1);
+    GIVEN("A tree of weighted items inserted in a random order") {
+        std::mt19937 random(11);
+        std::vector<Weighted> elements(3000);
+        for (int i = 0; i < 3000; ++i) {
+            elements[i] = {i, (int) (random() % 1000)};
+        }
+        std::vector<int> order(3000);
+        for (int i = 0; i < 3000; ++i) {
+            order[i] = i;
+        }
+        std::shuffle(order.begin(), order.end(), random);
+        RBTreeOptions options = {};
+        options.usePool = usePool;
+        options.aggregate = &weightAggregate;
+        RBTree *tree = newRBTreeWithOptions(weightedCmp, intFree, &options);
+        REQUIRE(tree != nullptr);
+        std::map<int, int> items;
+        for (int i = 0; i < 1500; ++i) {
+            REQUIRE(addToRBTree(tree, &elements[order[i]]));
+            items[order[i]] = elements[order[i]].weight;
+        }
+
+        auto matchesItems = [&]() {
+            REQUIRE(isValidRBTree(tree));
+            REQUIRE(hasValidAggregates(tree));
+            WeightSequence expected, gotten;
+            REQUIRE(aggregateRBTree(tree, &gotten) == foldWeights(items, 0, 3000, expected));
+            REQUIRE(sameSequence(gotten, expected));
+            for (int i = 0; i < 300; ++i) {
+                Weighted lo = {(int) (random() % 3100) - 50, 0};
+                Weighted hi = {lo.key + (int) (random() % (i % 2 == 0 ? 30 : 3000)), 0};
+                bool found = foldWeights(items, lo.key, hi.key, expected);
+                REQUIRE(aggregateRangeRBTree(tree, &lo, &hi, &gotten) == found);
+                if (found) {
+                    REQUIRE(sameSequence(gotten, expected));
+                }
+            }
+        };
+
+        THEN("the aggregates follow inserts") {
+            matchesItems();
+        }
+
+        THEN("the aggregates follow removes and replaces") {
+            for (int i = 0; i < 700; ++i) {
+                REQUIRE(removeFromRBTree(tree, &elements[order[i]]));
+                items.erase(order[i]);
+            }
+            std::vector<Weighted> replacements(100);
+            for (int i = 0; i < 100; ++i) {
+                replacements[i] = {order[1000 + i], elements[order[1000 + i]].weight + 1};
+                REQUIRE(replaceRBTree(tree, &replacements[i]));
+                items[replacements[i].key] = replacements[i].weight;
+            }
+            matchesItems();
+        }
+
+        THEN("the aggregates and subtree sizes follow a large range removal") {
+            Weighted lo = {200, 0}, hi = {2800, 0};
+            int removed = 0;
+            for (auto it = items.lower_bound(lo.key); it != items.end() && it->first < hi.key; ++removed) {
+                it = items.erase(it);
+            }
+            REQUIRE(removeRangeFromRBTree(tree, &lo, &hi) == removed);
+            REQUIRE(tree->size == (int) items.size());
+            REQUIRE(((Weighted*) rbFirst(tree)->data)->key == items.begin()->first);
+            REQUIRE(((Weighted*) rbLast(tree)->data)->key == items.rbegin()->first);
+            matchesItems();
+            REQUIRE(removeRangeFromRBTree(tree, &lo, &hi) == 0);
+            REQUIRE(removeRangeFromRBTree(tree, &hi, &lo) == 0);
+            REQUIRE(addToRBTree(tree, &elements[1000]));
+            items[1000] = elements[1000].weight;
+            matchesItems();
+        }
+
+        THEN("the aggregates follow a batch that rebuilds the tree") {
+            std::vector<void*> batch;
+            for (int i = 1500; i < 3000; ++i) {
+                batch.push_back(&elements[order[i]]);
+                items[order[i]] = elements[order[i]].weight;
+            }
+            REQUIRE(addBatchToRBTree(tree, batch.data(), (int) batch.size(), nullptr) == 1500);
+            matchesItems();
+        }
+
+        THEN("the aggregates follow splits and joins") {
+            if (!usePool) {
+                Weighted key = {1234, 0};
+                RBTree *left = nullptr, *right = nullptr;
+                REQUIRE(splitRBTree(tree, &key, &left, &right));
+                REQUIRE(hasValidAggregates(left));
+                REQUIRE(hasValidAggregates(right));
+                WeightSequence expected, gotten;
+                REQUIRE(foldWeights(items, 0, 1234, expected));
+                REQUIRE(aggregateRBTree(left, &gotten));
+                REQUIRE(sameSequence(gotten, expected));
+                RBTree *other = newRBTreeWithOptions(weightedCmp, intFree, nullptr);
+                REQUIRE(joinRBTree(left, nullptr, other) == nullptr);
+                freeRBTree(other);
+                tree = joinRBTree(left, nullptr, right);
+                REQUIRE(tree == left);
+                matchesItems();
+            }
+        }
+
+        freeRBTree(tree);
+    }
+
+    GIVEN("Options an aggregate can't be kept with") {
+        RBTreeOptions options = {};
+        options.aggregate = &weightAggregate;
+        options.engine = BPLUS_ENGINE;
+        REQUIRE(newRBTreeWithOptions(weightedCmp, intFree, &options) == nullptr);
+        RBTreeAggregate large = {RBTREE_MAX_AGGREGATE_SIZE + 1, weightValue, combineWeights};
+        options.aggregate = &large;
+        options.engine = RED_BLACK_ENGINE;
+        REQUIRE(newRBTreeWithOptions(weightedCmp, intFree, &options) == nullptr);
+        RBTree *empty = newRBTreeWithOptions(intCmp, intFree, nullptr);
+        WeightSequence result;
+        REQUIRE(!aggregateRBTree(empty, &result));
+        freeRBTree(empty);
+    }
+}
+
+SCENARIO("Removes items from RB trees", "[remove]") {
+    for (int usePool = 0; usePool <= 1; ++usePool) {
+        GIVEN("A tree of 0..999 inserted in a scrambled order, pooled: " + std::to_string(usePool)) {
+            RBTreeOptions options = {};
+            options.usePool = usePool;
+            RBTree *tree = newRBTreeWithOptions(intCmp, intFree, &options);
+            std::vector<int> elements(1000);
+            for (int i = 0; i < 1000; ++i) {
+                elements[i] = (i * 389) % 1000;
+                REQUIRE(addToRBTree(tree, &elements[i]));
+            }
+
+            THEN("removing every other item keeps the tree valid") {
+                for (int i = 0; i < 1000; i += 2) {
+                    REQUIRE(removeFromRBTree(tree, &elements[i]));
+                    REQUIRE(!containsRBTree(tree, &elements[i]));
+                }
+                REQUIRE(isValidRBTree(tree));
+                REQUIRE(tree->size == 500);
+                REQUIRE(!removeFromRBTree(tree, &elements[0]));
+
+                AND_THEN("removed nodes are reused by the next inserts") {
+                    Node *recycled = tree->freeNodes;
+                    REQUIRE(recycled != nullptr);
+                    REQUIRE(addToRBTree(tree, &elements[998]));
+                    REQUIRE(tree->freeNodes != recycled);
+                    REQUIRE(isValidRBTree(tree));
+                }
+            }
+
+            THEN("removing a range removes exactly the items in [lo, hi)") {
+                int lo = 100, hi = 900;
+                REQUIRE(removeRangeFromRBTree(tree, &lo, &hi) == 800);
+                REQUIRE(isValidRBTree(tree));
+                REQUIRE(tree->size == 200);
+                int justBelow = 99, atHi = 900;
+                REQUIRE(containsRBTree(tree, &justBelow));
+                REQUIRE(containsRBTree(tree, &atHi));
+                REQUIRE(!containsRBTree(tree, &lo));
+                REQUIRE(removeRangeFromRBTree(tree, &lo, &hi) == 0);
+            }
+
+            THEN("the tree can be emptied and refilled") {
+                for (auto &element : elements) {
+                    REQUIRE(removeFromRBTree(tree, &element));
+                }
+                REQUIRE(tree->root == nullptr);
+                REQUIRE(tree->size == 0);
+                for (auto &element : elements) {
+                    REQUIRE(addToRBTree(tree, &element));
+                }
+                REQUIRE(isValidRBTree(tree));
+            }
+
+            freeRBTree(tree);
+        }
+    }
+}
+
+SCENARIO("Iterates RB trees with a cursor", "[cursor]") {
+    GIVEN("A tree of 0..99 inserted in a scrambled order") {
+        RBTree *tree = newRBTree(intCmp, intFree);
+        std::vector<int> elements(100);
+        for (int i = 0; i < 100; ++i) {
+            elements[i] = (i * 37) % 100;
+            REQUIRE(addToRBTree(tree, &elements[i]));
+        }
+
+        THEN("rbFirst/rbNext visit the items in an ascending order") {
+            int expected = 0;
+            for (Node *node = rbFirst(tree); node != nullptr; node = rbNext(node)) {
+                REQUIRE(*(int*)node->data == expected++);
+            }
+            REQUIRE(expected == 100);
+        }
+
+        THEN("rbLast/rbPrev visit the items in a descending order") {
+            int expected = 99;
+            for (Node *node = rbLast(tree); node != nullptr; node = rbPrev(node)) {
+                REQUIRE(*(int*)node->data == expected--);
+            }
+            REQUIRE(expected == -1);
+        }
+
+        THEN("forEachRBTree stops as soon as the function returns 0") {
+            int calls = 0;
+            REQUIRE(!forEachRBTree(tree, [](const void* object, void* args) {
+                ++*(int*)args;
+                return *(const int*)object < 10 ? 1 : 0;
+            }, &calls));
+            REQUIRE(calls == 11);
+        }
+
+        freeRBTree(tree);
+    }
+
+    GIVEN("An empty tree") {
+        RBTree *tree = newRBTree(intCmp, intFree);
+        REQUIRE(rbFirst(tree) == nullptr);
+        REQUIRE(rbLast(tree) == nullptr);
+        freeRBTree(tree);
+    }
+}
+
+SCENARIO("Bound queries and range iteration on an int tree", "[bounds]") {
+    GIVEN("A tree of the even numbers 0..98") {
+        RBTree *tree = newRBTree(intCmp, intFree);
+        std::vector<int> elements(50);
+        for (int i = 0; i < 50; ++i) {
+            elements[i] = 2 * ((i * 13) % 50);
+            REQUIRE(addToRBTree(tree, &elements[i]));
+        }
+
+        THEN("every bound matches a linear scan") {
+            for (int x = -2; x <= 100; ++x) {
+                int *lower = (int*)lowerBoundRBTree(tree, &x);
+                int *upper = (int*)upperBoundRBTree(tree, &x);
+                int *floor = (int*)floorRBTree(tree, &x);
+                int expectedLower = x <= 0 ? 0 : (x + 1) / 2 * 2;
+                int expectedUpper = x < 0 ? 0 : x / 2 * 2 + 2;
+                int expectedFloor = std::min(98, x / 2 * 2 - (x < 0 && x % 2 ? 2 : 0));
+                if (expectedLower > 98) { REQUIRE(lower == nullptr); } else { REQUIRE(*lower == expectedLower); }
+                if (expectedUpper > 98) { REQUIRE(upper == nullptr); } else { REQUIRE(*upper == expectedUpper); }
+                if (expectedFloor < 0) { REQUIRE(floor == nullptr); } else { REQUIRE(*floor == expectedFloor); }
+                REQUIRE(ceilRBTree(tree, &x) == (void*)lower);
+            }
+        }
+
+        THEN("forEachRBTreeRange visits exactly [lo, hi)") {
+            int lo = 11, hi = 20, sum = 0;
+            REQUIRE(forEachRBTreeRange(tree, &lo, &hi, foreachIntSum, &sum));
+            REQUIRE(sum == 12 + 14 + 16 + 18);
+            REQUIRE(forEachRBTreeRange(tree, &hi, &lo, foreachIntSum, &sum));
+            REQUIRE(sum == 12 + 14 + 16 + 18);
+        }
+
+        freeRBTree(tree);
+    }
+}
+
+SCENARIO("Order statistics on RB trees", "[order statistics]") {
+    GIVEN("A tree with order statistics of the even numbers 0..398") {
+        RBTreeOptions options = {};
+        options.orderStatistics = 1;
+        RBTree *tree = newRBTreeWithOptions(intCmp, intFree, &options);
+        std::vector<int> elements(200);
+        for (int i = 0; i < 200; ++i) {
+            elements[i] = 2 * ((i * 71) % 200);
+            REQUIRE(addToRBTree(tree, &elements[i]));
+        }
+        REQUIRE(isValidRBTree(tree));
+
+        THEN("rank and select agree with the sorted order") {
+            for (int k = 0; k < 200; ++k) {
+                int value = 2 * k, odd = 2 * k + 1;
+                REQUIRE(*(int*)selectRBTree(tree, k) == value);
+                REQUIRE(rankRBTree(tree, &value) == k);
+                REQUIRE(rankRBTree(tree, &odd) == k + 1);
+            }
+            REQUIRE(selectRBTree(tree, 200) == nullptr);
+            REQUIRE(selectRBTree(tree, -1) == nullptr);
+        }
+
+        THEN("range counts match") {
+            int lo = 11, hi = 101;
+            REQUIRE(countRangeRBTree(tree, &lo, &hi) == 45);
+            REQUIRE(countRangeRBTree(tree, &hi, &lo) == 0);
+        }
+
+        THEN("subtree sizes survive removals") {
+            int lo = 100, hi = 300;
+            REQUIRE(removeRangeFromRBTree(tree, &lo, &hi) == 100);
+            for (int i = 0; i < 200; i += 3) {
+                removeFromRBTree(tree, &elements[i]);
+            }
+            REQUIRE(isValidRBTree(tree));
+            for (int k = 0; k < tree->size; ++k) {
+                REQUIRE(rankRBTree(tree, selectRBTree(tree, k)) == k);
+            }
+        }
+
+        THEN("samples are items of the tree") {
+            for (int i = 0; i < 100; ++i) {
+                REQUIRE(containsRBTree(tree, sampleRBTree(tree)));
+            }
+        }
+
+        freeRBTree(tree);
+    }
+
+    GIVEN("A tree without order statistics") {
+        RBTree *tree = newRBTree(intCmp, intFree);
+        int value = 1;
+        addToRBTree(tree, &value);
+        REQUIRE(rankRBTree(tree, &value) == -1);
+        REQUIRE(selectRBTree(tree, 0) == nullptr);
+        freeRBTree(tree);
+    }
+}
+
+// a tree of the given engine holding 0..9999 (the items of elements) inserted in a scrambled order
+static RBTree* newScrambledEngineTree(RBTreeEngine engine, std::vector<int>& elements) {
+    RBTreeOptions options = {};
+    options.engine = engine;
+    RBTree *tree = newRBTreeWithOptions(intCmp, intFree, &options);
+    REQUIRE(tree != NULL);
+    elements.resize(10000);
+    for (int i = 0; i < 10000; ++i) {
+        elements[i] = (i * 7919) % 10000;
+        REQUIRE(addToRBTree(tree, &elements[i]));
+    }
+    return tree;
+}
+
+// the behaviour every engine tree of newScrambledEngineTree shares with a red-black one
+static void engineTreeBehavesLikeRedBlack(RBTree* tree, std::vector<int>& elements) {
+    THEN("it contains exactly the added items and rejects duplicates") {
+        REQUIRE(tree->size == 10000);
+        for (int i = -5; i < 10005; ++i) {
+            REQUIRE(bool(containsRBTree(tree, &i)) == (i >= 0 && i < 10000));
+        }
+        REQUIRE(!addToRBTree(tree, &elements[123]));
+        REQUIRE(tree->size == 10000);
+    }
+
+    THEN("forEachRBTree visits the items in an ascending order") {
+        int next = 0;
+        REQUIRE(forEachRBTree(tree, [](const void* object, void* args) {
+            int *next = (int*)args;
+            return *(const int*)object == (*next)++ ? 1 : 0;
+        }, &next));
+        REQUIRE(next == 10000);
+    }
+
+    THEN("bound and range queries fail instead of reporting an empty range") {
+        int lo = 100, hi = 200;
+        REQUIRE(lowerBoundRBTree(tree, &lo) == nullptr);
+        REQUIRE(upperBoundRBTree(tree, &lo) == nullptr);
+        REQUIRE(floorRBTree(tree, &lo) == nullptr);
+        REQUIRE(ceilRBTree(tree, &lo) == nullptr);
+        REQUIRE(!forEachRBTreeRange(tree, &lo, &hi, [](const void*, void*) { return 1; }, nullptr));
+        REQUIRE(removeRangeFromRBTree(tree, &lo, &hi) == -1);
+        REQUIRE(tree->size == 10000);
+    }
+}
+
+SCENARIO("The B+ tree engine behaves like the red-black one", "[bplus]") {
+    GIVEN("A B+ engine tree of 0..9999 inserted in a scrambled order") {
+        std::vector<int> elements;
+        RBTree *tree = newScrambledEngineTree(BPLUS_ENGINE, elements);
+
+        engineTreeBehavesLikeRedBlack(tree, elements);
+
+        freeRBTree(tree);
+    }
+
+    GIVEN("Options the B+ engine doesn't support") {
+        RBTreeOptions options = {};
+        options.engine = BPLUS_ENGINE;
+        options.orderStatistics = 1;
+        REQUIRE(newRBTreeWithOptions(intCmp, intFree, &options) == NULL);
+    }
+}
+
+// the layout of the index linked nodes of a compact engine tree
+static auto compactLayout(const CompactRBTree* tree) {
+    return nodeLayout(
+        (uint32_t) COMPACT_NIL,
+        [tree](uint32_t node) { return tree->nodes[node].left; },
+        [tree](uint32_t node) { return tree->nodes[node].right; },
+        [tree](uint32_t child, uint32_t node) { return (tree->nodes[child].parentAndColor >> 1) == node; },
+        [tree](uint32_t node) { return (tree->nodes[node].parentAndColor & 1) == RED; },
+        [tree](uint32_t node) { return *(const int*)tree->nodes[node].data; });
+}
+
+SCENARIO("The compact engine behaves like the red-black one", "[compact]") {
+    REQUIRE(sizeof(CompactNode) < sizeof(Node));
+
+    GIVEN("A compact engine tree of 0..9999 inserted in a scrambled order") {
+        std::vector<int> elements;
+        RBTree *tree = newScrambledEngineTree(COMPACT_ENGINE, elements);
+
+        THEN("it is a valid red-black tree") {
+            REQUIRE(tree->compact->size == 10000);
+            REQUIRE((tree->compact->nodes[tree->compact->root].parentAndColor & 1) == BLACK);
+            REQUIRE(blackHeightOf(tree->compact->root, compactLayout(tree->compact)) > 0);
+        }
+
+        engineTreeBehavesLikeRedBlack(tree, elements);
+
+        freeRBTree(tree);
+    }
+
+    GIVEN("Options the compact engine doesn't support") {
+        RBTreeOptions options = {};
+        options.engine = COMPACT_ENGINE;
+        options.usePool = 1;
+        REQUIRE(newRBTreeWithOptions(intCmp, intFree, &options) == NULL);
+    }
+}
+
+static const auto concurrentLayout = nodeLayout(
+    (const ConcurrentNode*) nullptr,
+    [](const ConcurrentNode* node) { return (const ConcurrentNode*) node->left; },
+    [](const ConcurrentNode* node) { return (const ConcurrentNode*) node->right; },
+    [](const ConcurrentNode*, const ConcurrentNode*) { return true; },
+    [](const ConcurrentNode* node) { return node->color == RED; },
+    [](const ConcurrentNode* node) { return *(const int*)node->data; });
+
+SCENARIO("Concurrent trees are read while one writer inserts", "[concurrent]") {
+    GIVEN("A concurrent tree of 0..4999, a writer adding 5000..19999 and three readers") {
+        ConcurrentRBTree *tree = newConcurrentRBTree(intCmp, intFree);
+        REQUIRE(tree != NULL);
+        std::vector<int> elements(20000);
+        for (int i = 0; i < 20000; ++i) {
+            elements[i] = i < 5000 ? (i * 7919) % 5000 : 5000 + (i * 7919) % 15000;
+        }
+        for (int i = 0; i < 5000; ++i) {
+            REQUIRE(addToConcurrentRBTree(tree, &elements[i]));
+        }
+
+        std::atomic<bool> done(false);
+        std::atomic<int> errors(0);
+        std::vector<std::thread> readers;
+        for (int r = 0; r < 3; ++r) {
+            readers.emplace_back([&]() {
+                int reader = registerConcurrentReader(tree);
+                if (reader < 0) {
+                    errors++;
+                    return;
+                }
+                do {
+                    for (int i = 0; i < 5000; i += 7) {
+                        errors += containsConcurrentRBTree(tree, reader, &i) ? 0 : 1;
+                    }
+                    // a snapshot is always a sorted set that contains the first 5000 items.
+                    int previous = -1;
+                    auto ascending = [](const void* object, void* args) {
+                        int *previous = (int*)args;
+                        int ok = *(const int*)object > *previous;
+                        *previous = *(const int*)object;
+                        return ok;
+                    };
+                    errors += forEachConcurrentRBTree(tree, reader, ascending, &previous) && previous >= 4999 ? 0 : 1;
+                } while (!done);
+                unregisterConcurrentReader(tree, reader);
+            });
+        }
+        for (int i = 5000; i < 20000; ++i) {
+            if (!addToConcurrentRBTree(tree, &elements[i])) {
+                errors++;
+            }
+        }
+        done = true;
+        for (auto& reader : readers) {
+            reader.join();
+        }
+
+        THEN("no reader saw a broken snapshot and the final tree is complete") {
+            REQUIRE(errors == 0);
+            REQUIRE(tree->size == 20000);
+            REQUIRE(tree->root->color == BLACK);
+            REQUIRE(blackHeightOf(tree->root, concurrentLayout) > 0);
+            int reader = registerConcurrentReader(tree);
+            for (int i = -5; i < 20005; ++i) {
+                REQUIRE(bool(containsConcurrentRBTree(tree, reader, &i)) == (i >= 0 && i < 20000));
+            }
+            REQUIRE(!addToConcurrentRBTree(tree, &elements[123]));
+            unregisterConcurrentReader(tree, reader);
+        }
+
+        THEN("replaced nodes were reclaimed along the way") {
+            REQUIRE(tree->retiredCount < tree->size);
+        }
+
+        freeConcurrentRBTree(tree);
+    }
+
+    GIVEN("A tree with every reader slot taken") {
+        ConcurrentRBTree *tree = newConcurrentRBTree(intCmp, intFree);
+        for (int i = 0; i < CONCURRENT_MAX_READERS; ++i) {
+            REQUIRE(registerConcurrentReader(tree) == i);
+        }
+        REQUIRE(registerConcurrentReader(tree) == -1);
+        unregisterConcurrentReader(tree, 5);
+        REQUIRE(registerConcurrentReader(tree) == 5);
+        freeConcurrentRBTree(tree);
+    }
+}
+
+// every node of a version is referenced by at least one version
+static const auto persistentLayout = nodeLayout(
+    (const PersistentNode*) nullptr,
+    [](const PersistentNode* node) { return (const PersistentNode*) node->left; },
+    [](const PersistentNode* node) { return (const PersistentNode*) node->right; },
+    [](const PersistentNode* child, const PersistentNode*) { return child->refCount >= 1; },
+    [](const PersistentNode* node) { return node->color == RED; },
+    [](const PersistentNode* node) { return *(const int*)node->data; });
+
+// number of nodes of a persistent subtree that are shared with another version
+static int sharedNodes(const PersistentNode* node) {
+    return node == nullptr ? 0 : (node->refCount > 1) + sharedNodes(node->left) + sharedNodes(node->right);
+}
+
+SCENARIO("Persistent trees keep their snapshots unchanged", "[persistent]") {
+    GIVEN("A persistent tree of 0..999 and a snapshot of it") {
+        PersistentRBTree *tree = newPersistentRBTree(intCmp, intFree);
+        REQUIRE(tree != NULL);
+        std::vector<int> elements(3000);
+        for (int i = 0; i < 3000; ++i) {
+            elements[i] = (i * 7919) % 3000;
+        }
+        auto countItems = [](const void* object, void* args) {
+            (void)object;
+            (*(int*)args)++;
+            return 1;
+        };
+        for (int i = 0; i < 3000; ++i) {
+            if (elements[i] < 1000) {
+                REQUIRE(addToPersistentRBTree(tree, &elements[i]));
+            }
+        }
+        REQUIRE(sharedNodes(tree->root) == 0);
+        PersistentSnapshot snapshot = snapshotPersistentRBTree(tree);
+        REQUIRE(snapshot.root == tree->root);
+        REQUIRE(snapshot.size == 1000);
+
+        WHEN("1000..2999 are added to the tree") {
+            for (int i = 0; i < 3000; ++i) {
+                if (elements[i] >= 1000) {
+                    REQUIRE(addToPersistentRBTree(tree, &elements[i]));
+                }
+            }
+
+            THEN("the tree has everything and the snapshot only what it had") {
+                REQUIRE(tree->size == 3000);
+                REQUIRE(tree->root->refCount >= 1);
+                REQUIRE(blackHeightOf(tree->root, persistentLayout) > 0);
+                REQUIRE(snapshot.root->refCount >= 1);
+                REQUIRE(blackHeightOf(snapshot.root, persistentLayout) > 0);
+                for (int i = -5; i < 3005; ++i) {
+                    REQUIRE(bool(containsPersistentRBTree(tree, &i)) == (i >= 0 && i < 3000));
+                    REQUIRE(bool(containsPersistentSnapshot(&snapshot, &i)) == (i >= 0 && i < 1000));
+                }
+                int count = 0;
+                REQUIRE(forEachPersistentSnapshot(&snapshot, countItems, &count));
+                REQUIRE(count == 1000);
+                count = 0;
+                REQUIRE(forEachPersistentRBTree(tree, countItems, &count));
+                REQUIRE(count == 3000);
+            }
+
+            THEN("releasing the snapshot leaves no shared nodes") {
+                REQUIRE(sharedNodes(tree->root) > 0);
+                releasePersistentSnapshot(&snapshot);
+                REQUIRE(snapshot.root == nullptr);
+                REQUIRE(sharedNodes(tree->root) == 0);
+                REQUIRE(tree->root->refCount >= 1);
+                REQUIRE(blackHeightOf(tree->root, persistentLayout) > 0);
+            }
+
+            releasePersistentSnapshot(&snapshot);
+        }
+
+        WHEN("several snapshots are taken between inserts") {
+            std::vector<PersistentSnapshot> snapshots;
+            for (int i = 0; i < 3000; ++i) {
+                if (elements[i] >= 1000) {
+                    if (elements[i] % 500 == 0) {
+                        snapshots.push_back(snapshotPersistentRBTree(tree));
+                    }
+                    REQUIRE(addToPersistentRBTree(tree, &elements[i]));
+                }
+            }
+
+            THEN("each snapshot has the size it was taken at, and they can be released in any order") {
+                for (const PersistentSnapshot& s : snapshots) {
+                    int count = 0;
+                    forEachPersistentSnapshot(&s, countItems, &count);
+                    REQUIRE(count == s.size);
+                    REQUIRE(s.root->refCount >= 1);
+                    REQUIRE(blackHeightOf(s.root, persistentLayout) > 0);
+                }
+                for (size_t i = 0; i < snapshots.size(); i += 2) {
+                    releasePersistentSnapshot(&snapshots[i]);
+                }
+                for (size_t i = 1; i < snapshots.size(); i += 2) {
+                    releasePersistentSnapshot(&snapshots[i]);
+                }
+                releasePersistentSnapshot(&snapshot);
+                REQUIRE(sharedNodes(tree->root) == 0);
+            }
+
+            for (PersistentSnapshot& s : snapshots) {
+                releasePersistentSnapshot(&s);
+            }
+            releasePersistentSnapshot(&snapshot);
+        }
+
+        freePersistentRBTree(tree);
+    }
+}
+
+RBTREE_DEFINE(TestIntTree, int, RBTREE_NUMBER_COMPARE)
+
+static const auto typedLayout = nodeLayout(
+    (const TestIntTreeNode*) nullptr,
+    [](const TestIntTreeNode* node) { return node->left; },
+    [](const TestIntTreeNode* node) { return node->right; },
+    [](const TestIntTreeNode* child, const TestIntTreeNode* node) { return child->parent == node; },
+    [](const TestIntTreeNode* node) { return node->color == RED; },
+    [](const TestIntTreeNode* node) { return node->key; });
+
+SCENARIO("Typed trees generated with RBTREE_DEFINE", "[typed]") {
+    GIVEN("An int tree of 0..4999 inserted in a scrambled order") {
+        TestIntTree *tree = newTestIntTree();
+        for (int i = 0; i < 5000; ++i) {
+            REQUIRE(addToTestIntTree(tree, (i * 7919) % 5000));
+        }
+
+        THEN("it is a valid red-black tree with the same semantics as RBTree") {
+            REQUIRE(tree->root->color == BLACK);
+            REQUIRE(blackHeightOf(tree->root, typedLayout) != -1);
+            REQUIRE(tree->size == 5000);
+            REQUIRE(!addToTestIntTree(tree, 42));
+            REQUIRE(containsTestIntTree(tree, 4999));
+            REQUIRE(!containsTestIntTree(tree, 5000));
+        }
+
+        THEN("forEach visits the keys in an ascending order") {
+            int next = 0;
+            REQUIRE(forEachTestIntTree(tree, [](int key, void* args) {
+                return key == (*(int*)args)++ ? 1 : 0;
+            }, &next));
+            REQUIRE(next == 5000);
+        }
+
+        freeTestIntTree(tree);
+    }
+}
+
+SCENARIO("Frozen trees answer the queries of the trees they were frozen from", "[frozen]") {
+    GIVEN("Trees of every size up to 70 of the even numbers, of both node engines") {
+        for (int n = 0; n <= 70; ++n) {
+            for (RBTreeEngine engine : {RED_BLACK_ENGINE, COMPACT_ENGINE}) {
+                std::vector<int> elements(n);
+                RBTreeOptions options = {};
+                options.engine = engine;
+                RBTree *tree = newRBTreeWithOptions(intCmp, intFree, &options);
+                for (int i = 0; i < n; ++i) {
+                    elements[i] = 2 * ((i * 71) % n);
+                    REQUIRE(addToRBTree(tree, &elements[i]));
+                }
+                FrozenRBTree *frozen = freezeRBTree(tree);
+                REQUIRE(frozen != NULL);
+                REQUIRE(frozen->size == n);
+                REQUIRE((uintptr_t)frozen->items % FROZEN_CACHE_LINE == 0);
+
+                for (int i = -1; i <= 2 * n; ++i) {
+                    bool even = i >= 0 && i % 2 == 0 && i < 2 * n;
+                    REQUIRE(containsFrozenRBTree(frozen, &i) == even);
+                    void *bound = lowerBoundFrozenRBTree(frozen, &i);
+                    int expected = i < 0 ? 0 : i + i % 2;
+                    REQUIRE((bound == NULL ? -1 : *(int*)bound) == (expected < 2 * n ? expected : -1));
+                }
+                if (n > 0) {
+                    REQUIRE(findFrozenRBTree(frozen, &elements[0]) == &elements[0]);
+                }
+
+                int next = 0;
+                REQUIRE(forEachFrozenRBTree(frozen, [](const void* object, void* args) {
+                    int *next = (int*)args;
+                    if (*(const int*)object != *next) {
+                        return 0;
+                    }
+                    *next += 2;
+                    return 1;
+                }, &next) == (n > 0));
+                REQUIRE(next == 2 * n);
+
+                int lo = 9, hi = 21, sum = 0;
+                REQUIRE(forEachFrozenRBTreeRange(frozen, &lo, &hi, foreachIntSum, &sum));
+                int expectedSum = 0;
+                for (int value = 10; value < 21 && value < 2 * n; value += 2) {
+                    expectedSum += value;
+                }
+                REQUIRE(sum == expectedSum);
+
+                RBTree *thawed = thawRBTree(frozen);
+                REQUIRE(thawed != NULL);
+                REQUIRE(isValidRBTree(thawed));
+                REQUIRE(thawed->size == n);
+                for (int i = 0; i < n; ++i) {
+                    REQUIRE(containsRBTree(thawed, &elements[i]));
+                }
+                int odd = 1;
+                REQUIRE(addToRBTree(thawed, &odd));
+                REQUIRE(isValidRBTree(thawed));
+                freeRBTree(thawed);
+            }
+        }
+    }
+
+    GIVEN("A typed tree of 0..4999") {
+        TestIntTree *tree = newTestIntTree();
+        for (int i = 0; i < 5000; ++i) {
+            REQUIRE(addToTestIntTree(tree, (i * 7919) % 5000));
+        }
+        TestIntTreeFrozen *frozen = freezeTestIntTree(tree);
+        REQUIRE(frozen != NULL);
+        REQUIRE(frozen->size == 5000);
+        for (int i = -10; i < 5010; ++i) {
+            REQUIRE(containsFrozenTestIntTree(frozen, i) == (i >= 0 && i < 5000));
+        }
+
+        tree = thawTestIntTree(frozen);
+        REQUIRE(tree != NULL);
+        REQUIRE(tree->size == 5000);
+        REQUIRE(blackHeightOf(tree->root, typedLayout) != -1);
+        REQUIRE(containsTestIntTree(tree, 4999));
+        freeTestIntTree(tree);
+    }
+}
+
+struct IntItem {
+    int value;
+    RBLink link;
+};
+
+int intItemCmp(const void* a, const void* b)
+{
+    return ((const IntItem*)a)->value - ((const IntItem*)b)->value;
+}
+
+static const auto linkLayout = nodeLayout(
+    (const RBLink*) nullptr,
+    [](const RBLink* link) { return (const RBLink*) link->left; },
+    [](const RBLink* link) { return (const RBLink*) link->right; },
+    [](const RBLink* child, const RBLink* link) { return child->parent == link; },
+    [](const RBLink* link) { return link->color == RED; },
+    [](const RBLink* link) { return RB_CONTAINER_OF(link, const IntItem, link)->value; });
+
+SCENARIO("Intrusive trees link the objects themselves", "[intrusive]") {
+    GIVEN("1000 items linked in a scrambled order") {
+        std::vector<IntItem> items(1000);
+        IntrusiveRBTree tree;
+        initIntrusiveRBTree(&tree, offsetof(IntItem, link), intItemCmp);
+        for (int i = 0; i < 1000; ++i) {
+            items[i].value = (i * 389) % 1000;
+            REQUIRE(addToIntrusiveRBTree(&tree, &items[i]));
+        }
+
+        THEN("lookups return the linked objects") {
+            REQUIRE(tree.size == 1000);
+            REQUIRE(blackHeightOf(tree.root, linkLayout) != -1);
+            IntItem probe = {389, {}};
+            REQUIRE(findIntrusiveRBTree(&tree, &probe) == &items[1]);
+            REQUIRE(RB_CONTAINER_OF(&items[1].link, IntItem, link) == &items[1]);
+            REQUIRE(!addToIntrusiveRBTree(&tree, &probe));
+        }
+
+        THEN("objects can be unlinked directly and the order is kept") {
+            for (int i = 0; i < 1000; i += 2) {
+                removeFromIntrusiveRBTree(&tree, &items[i]);
+            }
+            REQUIRE(tree.size == 500);
+            REQUIRE(blackHeightOf(tree.root, linkLayout) != -1);
+            int previous = -1;
+            REQUIRE(forEachIntrusiveRBTree(&tree, [](const void* object, void* args) {
+                int *previous = (int*)args;
+                int value = ((const IntItem*)object)->value;
+                bool ascending = value > *previous;
+                *previous = value;
+                return ascending ? 1 : 0;
+            }, &previous));
+            REQUIRE(!containsIntrusiveRBTree(&tree, &items[0]));
+            REQUIRE(containsIntrusiveRBTree(&tree, &items[1]));
+        }
+
+        clearIntrusiveRBTree(&tree, nullptr);
+        REQUIRE(tree.root == nullptr);
+    }
+}